@@ -0,0 +1,154 @@
+/**************************************************
+ *                                                *
+ *   Benchmark: force accumulation modes, speed   *
+ *        and accuracy vs. a double reference     *
+ *                                                *
+ *               Written by:                      *
+ *            Amir Zuabi - 212606222              *
+ *             Nir Schif - 212980395              *
+ *                                                *
+ **************************************************/
+
+#include "nbody_parallel.hpp"
+#include "nbody_cli.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+// Forces of the current mode, one entry per particle
+vector<float> benchFx, benchFy, benchFz;
+
+// Forces of a chunk into benchF* (no velocity update, so every repetition does the same work)
+void ForceOnlyChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+        ComputeForceDirect(ps, i, &benchFx[i], &benchFy[i], &benchFz[i]);
+}
+
+// Double-precision direct sum on particle i, the accuracy reference
+void ReferenceForce(const ParticleSystem &ps, unsigned int i, double *F)
+{
+    F[0] = F[1] = F[2] = 0;
+    for (unsigned int j = 0; j < ps.n; ++j)
+    {
+        double dx = (double)ps.x[j] - ps.x[i];
+        double dy = (double)ps.y[j] - ps.y[i];
+        double dz = (double)ps.z[j] - ps.z[i];
+        double invDist = 1.0 / sqrt(dx * dx + dy * dy + dz * dz + softening);
+        double invDist3 = invDist * invDist * invDist;
+        F[0] += dx * invDist3;
+        F[1] += dy * invDist3;
+        F[2] += dz * invDist3;
+    }
+}
+
+/**
+ * @brief Times the force phase of the active mode on a pool, best of `reps` runs.
+ *
+ * @return double Milliseconds of the fastest run.
+ */
+double TimeForces(ParticleSystem &ps, ThreadPool &pool, int reps)
+{
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r)
+    {
+        auto start = chrono::high_resolution_clock::now();
+        StartThreads(ps, ForceOnlyChunk, pool);
+        auto end = chrono::high_resolution_clock::now();
+        double ms = chrono::duration<double, milli>(end - start).count();
+        if (ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+/**
+ * @brief Compares the float, Kahan and double accumulation modes of the direct-sum kernel.
+ *
+ * For every N, each mode is timed on the worker pool and its forces are compared against a double
+ * reference on `samples` evenly spaced particles. The error of particle i is |F_i - Fref_i| / rms|Fref|:
+ * normalizing by the RMS force keeps near-zero forces (symmetric lattice positions) from dominating.
+ *
+ * Usage: ./bench_accumulate.exe [--n 4096,32768] [--reps 3] [--samples 512] [--precision exact|fast]
+ *                               [--backend name]
+ */
+int main(int argc, char **argv)
+{
+    if (!ParseSimdBackend(GetFlag(argc, argv, "--backend", "auto"), &activeBackend))
+    {
+        cerr << "❌ Error: --backend expects auto, sse, avx, avx2 or avx512 (supported by this CPU)" << endl;
+        return 1;
+    }
+    if (!ParseForcePrecision(GetFlag(argc, argv, "--precision", "exact"), &forcePrecision))
+    {
+        cerr << "❌ Error: --precision expects exact or fast" << endl;
+        return 1;
+    }
+    vector<int> sizes = GetFlagIntList(argc, argv, "--n", "4096,32768");
+    int reps = GetFlagInt(argc, argv, "--reps", 3);
+    unsigned int samples = (unsigned int)GetFlagInt(argc, argv, "--samples", 512);
+    ThreadPool &pool = WorkerPool();
+
+    cout << "\n---  Force accumulation modes, " << forceBackends[activeBackend].name << " backend, "
+         << (forcePrecision == PRECISION_FAST ? "fast" : "exact") << " precision, "
+         << pool.Size() << " threads, best of " << reps << " ---\n\n";
+    cout << left << setw(8) << "N" << setw(9) << "mode" << right << setw(12) << "force ms" << setw(14) << "Ginteract/s"
+         << setw(10) << "vs float" << setw(14) << "median err" << setw(14) << "max err" << endl;
+
+    for (int n : sizes)
+    {
+        ParticleSystem ps((unsigned int)n);
+        InitChunk(ps, 0, ps.n);
+        benchFx.assign(ps.n, 0);
+        benchFy.assign(ps.n, 0);
+        benchFz.assign(ps.n, 0);
+
+        // Reference forces of the sampled particles
+        unsigned int count = min(samples, ps.n);
+        vector<unsigned int> sampled(count);
+        vector<double> reference(3 * (size_t)count);
+        double sumSqr = 0;
+        for (unsigned int s = 0; s < count; ++s)
+        {
+            sampled[s] = (unsigned int)((unsigned long long)s * ps.n / count);
+            ReferenceForce(ps, sampled[s], &reference[3 * s]);
+            sumSqr += reference[3 * s] * reference[3 * s] + reference[3 * s + 1] * reference[3 * s + 1] +
+                      reference[3 * s + 2] * reference[3 * s + 2];
+        }
+        double rms = sqrt(sumSqr / count);
+
+        double floatMs = 0;
+        for (int a = 0; a < ACCUM_COUNT; ++a)
+        {
+            forceAccumulation = (ForceAccumulation)a;
+            TimeForces(ps, pool, 1); // warm up
+            double ms = TimeForces(ps, pool, reps);
+            if (a == ACCUM_FLOAT)
+                floatMs = ms;
+
+            vector<double> errors(count);
+            for (unsigned int s = 0; s < count; ++s)
+            {
+                unsigned int i = sampled[s];
+                double ex = benchFx[i] - reference[3 * s];
+                double ey = benchFy[i] - reference[3 * s + 1];
+                double ez = benchFz[i] - reference[3 * s + 2];
+                errors[s] = (rms > 0) ? sqrt(ex * ex + ey * ey + ez * ez) / rms : 0;
+            }
+            sort(errors.begin(), errors.end());
+
+            cout << left << setw(8) << n << setw(9) << accumulationNames[a] << right << fixed << setprecision(2)
+                 << setw(12) << ms << setw(14) << (double)ps.n * ps.n / (ms * 1e6)
+                 << setw(9) << ms / floatMs << "x" << scientific << setprecision(2)
+                 << setw(14) << errors[count / 2] << setw(14) << errors.back() << endl;
+        }
+    }
+    forceAccumulation = ACCUM_FLOAT;
+
+    cout << "\nBenchmark complete." << endl;
+    return 0;
+}
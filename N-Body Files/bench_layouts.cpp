@@ -0,0 +1,186 @@
+/**************************************************
+ *                                                *
+ *   Benchmark: force kernel specializations      *
+ *        by layout, width and softening          *
+ *                                                *
+ *               Written by:                      *
+ *            Amir Zuabi - 212606222              *
+ *             Nir Schif - 212980395              *
+ *                                                *
+ **************************************************/
+
+#include "nbody_simd.hpp"
+#include "nbody_ic.hpp"
+#include "nbody_perf.hpp"
+#include "nbody_cli.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// Force of all particles of a layout at a point: one compile-time specialization of ComputeForceLayout
+template <class Layout>
+using LayoutForce = void (*)(const typename Layout::Source &, float, float, float, float *, float *, float *);
+
+// One kernel width: the scalar specialization or a dispatch backend
+template <class Layout>
+struct LayoutVariant
+{
+    const char *name;
+    unsigned int width;
+    bool supported;
+    LayoutForce<Layout> force[2]; // indexed by softened
+};
+
+template <class Layout>
+vector<LayoutVariant<Layout>> LayoutVariants()
+{
+    return {
+        {"scalar", 1, true, {simd_scalar::ComputeForceLayout<Layout, false>, simd_scalar::ComputeForceLayout<Layout, true>}},
+        {"sse", 4, BackendSupported(SIMD_SSE), {simd_sse::ComputeForceLayout<Layout, false>, simd_sse::ComputeForceLayout<Layout, true>}},
+        {"avx", 8, BackendSupported(SIMD_AVX), {simd_avx::ComputeForceLayout<Layout, false>, simd_avx::ComputeForceLayout<Layout, true>}},
+        {"avx2", 8, BackendSupported(SIMD_AVX2), {simd_avx2::ComputeForceLayout<Layout, false>, simd_avx2::ComputeForceLayout<Layout, true>}},
+        {"avx512", 16, BackendSupported(SIMD_AVX512), {simd_avx512::ComputeForceLayout<Layout, false>, simd_avx512::ComputeForceLayout<Layout, true>}},
+    };
+}
+
+struct LayoutResult
+{
+    double seconds = 1e30; // best time of all forces
+    double l1Misses = 0;   // last repetition
+    double llcMisses = 0;
+};
+
+/**
+ * @brief Forces on every particle with one kernel, single-threaded, best of `reps`, with the L1D and LLC
+ *        misses of the last repetition. Writes the forces to F (3 floats per particle).
+ */
+template <class Layout>
+LayoutResult TimeForces(LayoutForce<Layout> force, const typename Layout::Source &src, const vector<OneParticle> &particles,
+                        int reps, vector<float> &F)
+{
+    LayoutResult result;
+    for (int r = 0; r < reps; ++r)
+    {
+        double l1Before = PerfPhaseTotal(PHASE_FORCE, PERF_L1D_MISSES), llcBefore = PerfPhaseTotal(PHASE_FORCE, PERF_LLC_MISSES);
+        auto start = chrono::high_resolution_clock::now();
+        PerfRunPhase(PHASE_FORCE, [&] {
+            for (size_t i = 0; i < particles.size(); ++i)
+                force(src, particles[i].x, particles[i].y, particles[i].z, &F[3 * i], &F[3 * i + 1], &F[3 * i + 2]);
+        });
+        auto end = chrono::high_resolution_clock::now();
+        result.seconds = min(result.seconds, chrono::duration<double>(end - start).count());
+        result.l1Misses = PerfPhaseTotal(PHASE_FORCE, PERF_L1D_MISSES) - l1Before;
+        result.llcMisses = PerfPhaseTotal(PHASE_FORCE, PERF_LLC_MISSES) - llcBefore;
+    }
+    return result;
+}
+
+// Largest |F - Fref| / |Fref| over the particles
+double MaxRelativeError(const vector<float> &F, const vector<float> &Fref)
+{
+    double worst = 0;
+    for (size_t i = 0; i < F.size(); i += 3)
+    {
+        double d = 0, r = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            d += ((double)F[i + k] - Fref[i + k]) * ((double)F[i + k] - Fref[i + k]);
+            r += (double)Fref[i + k] * Fref[i + k];
+        }
+        if (r > 0)
+            worst = max(worst, sqrt(d / r));
+    }
+    return worst;
+}
+
+/**
+ * @brief Prints one row per (width, softening) of the layout. The reference of the error column is the
+ *        scalar SoA kernel with the same softening.
+ */
+template <class Layout>
+void RunLayout(const char *layout, const typename Layout::Source &src, const vector<OneParticle> &particles, int reps,
+               const vector<float> *reference, double baseline)
+{
+    const double interactions = (double)particles.size() * particles.size();
+    vector<float> F(3 * particles.size());
+    for (int softened = 1; softened >= 0; --softened)
+    {
+        for (const LayoutVariant<Layout> &variant : LayoutVariants<Layout>())
+        {
+            cout << left << setw(8) << layout << setw(9) << variant.name << setw(7) << variant.width
+                 << setw(11) << (softened ? "on" : "off") << right;
+            if (!variant.supported)
+            {
+                cout << setw(12) << "-" << "   (not supported by this CPU)" << endl;
+                continue;
+            }
+            LayoutResult row = TimeForces<Layout>(variant.force[softened], src, particles, reps, F);
+            cout << fixed << setprecision(3) << setw(12) << row.seconds * 1e3 << setw(14) << interactions / row.seconds / 1e9
+                 << setw(9) << setprecision(2) << baseline / row.seconds << "x";
+            PrintPerfMillions(PERF_L1D_MISSES, row.l1Misses);
+            PrintPerfMillions(PERF_LLC_MISSES, row.llcMisses);
+            cout << setw(13) << scientific << setprecision(2) << MaxRelativeError(F, reference[softened]) << defaultfloat << endl;
+        }
+    }
+}
+
+/**
+ * @brief Times every compile-time specialization of the direct-sum kernel: layout (AoS ParticleType,
+ *        SoA ParticleSystem, AoSoA packets) x width (scalar, SSE, AVX, AVX2 + FMA, AVX-512) x softening on / off.
+ *
+ * Single-threaded on the uniform-cube initial conditions (no coincident particles, so the unsoftened
+ * kernels are finite). Reports throughput, the L1D and LLC misses of one force pass (millions, through
+ * perf_event_open when available) and the error against the scalar SoA kernel. Speedups are against the
+ * scalar AoS kernel with softening, the serial reference.
+ *
+ * Usage: ./bench_layouts.exe [--n count] [--reps r]   (default N = 8192, 3 repetitions)
+ */
+int main(int argc, char **argv)
+{
+    const unsigned int n = (unsigned int)GetFlagInt(argc, argv, "--n", 8192);
+    int reps = GetFlagInt(argc, argv, "--reps", 3);
+
+    icConfig.kind = IC_UNIFORM;
+    vector<OneParticle> particles(n);
+    SerialParticles aos(n);
+    ParticleSystem soa(n);
+    AosoaParticles aosoa(n);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        GenerateParticle(icConfig, i, n, &particles[i]);
+        const OneParticle &p = particles[i];
+        aos[i].x = soa.x[i] = p.x;
+        aos[i].y = soa.y[i] = p.y;
+        aos[i].z = soa.z[i] = p.z;
+        aos[i].vx = soa.vx[i] = p.vx;
+        aos[i].vy = soa.vy[i] = p.vy;
+        aos[i].vz = soa.vz[i] = p.vz;
+        aosoa.Set(i, p);
+    }
+
+    // Counters of the main thread only (a pool of one thread runs on the caller)
+    ThreadPool mainThread(1);
+    if (!PerfInit(mainThread))
+        cout << "Hardware counters unavailable (" << perfState.firstError << "), timing only" << endl;
+
+    vector<float> reference[2] = {vector<float>(3 * n), vector<float>(3 * n)};
+    TimeForces<SoaLayout>(simd_scalar::ComputeForceLayout<SoaLayout, false>, soa, particles, 1, reference[0]);
+    TimeForces<SoaLayout>(simd_scalar::ComputeForceLayout<SoaLayout, true>, soa, particles, 1, reference[1]);
+    vector<float> scratch(3 * n);
+    double baseline = TimeForces<AosLayout>(simd_scalar::ComputeForceLayout<AosLayout, true>, aos, particles, reps, scratch).seconds;
+
+    cout << "\n---  Force kernel specializations, N = " << n << ", 1 thread, best of " << reps << " ---\n\n";
+    cout << left << setw(8) << "layout" << setw(9) << "kernel" << setw(7) << "width" << setw(11) << "softening"
+         << right << setw(12) << "time ms" << setw(14) << "Ginteract/s" << setw(10) << "speedup" << setw(12) << "L1D-miss M" << setw(12) << "LLC-miss M" << setw(13) << "max rel err" << endl;
+    RunLayout<AosLayout>("aos", aos, particles, reps, reference, baseline);
+    RunLayout<SoaLayout>("soa", soa, particles, reps, reference, baseline);
+    RunLayout<AosoaLayout>("aosoa", aosoa, particles, reps, reference, baseline);
+    PerfShutdown();
+
+    cout << "\nBenchmark complete." << endl;
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**************************************************
+ *                                                *
+ *   Benchmark: Morton (Z-order) reordering,      *
+ *        cache misses and step time              *
+ *                                                *
+ *               Written by:                      *
+ *            Amir Zuabi - 212606222              *
+ *             Nir Schif - 212980395              *
+ *                                                *
+ **************************************************/
+
+#include "nbody_parallel.hpp"
+#include "nbody_barneshut.hpp"
+#include "nbody_cells.hpp"
+#include "nbody_morton.hpp"
+#include "nbody_ic.hpp"
+#include "nbody_perf.hpp"
+#include "nbody_cli.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+// Opening angle of the tree kernel and cutoff of the cell kernel (the generators keep about one particle
+// per unit volume, so the mean spacing is about 1)
+const float BENCH_THETA = 0.5f;
+const float BENCH_RC = 1.5f;
+
+struct OrderResult
+{
+    double stepMs = 1e30;  // best force + update step
+    double l1Misses = 0;   // force phase, per step (last repetition)
+    double llcMisses = 0;
+    double reorderMs = 0;  // ReorderMorton, last repetition
+};
+
+/**
+ * @brief Times one step of `kernel` ("barnes-hut" or "cells") on n particles of icConfig, in index order or
+ *        after a Morton reorder. Every repetition starts from the same freshly generated particles.
+ */
+OrderResult RunOrder(unsigned int n, const string &kernel, bool morton, int reps)
+{
+    OrderResult result;
+    ParticleSystem ps(n);
+    for (int r = 0; r < reps; ++r)
+    {
+        GenerateChunk(ps, 0, ps.n);
+        if (morton)
+        {
+            ResetMortonOrder(ps.n);
+            auto start = chrono::high_resolution_clock::now();
+            ReorderMorton(ps);
+            result.reorderMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+        }
+        double l1Before = PerfPhaseTotal(PHASE_FORCE, PERF_L1D_MISSES), llcBefore = PerfPhaseTotal(PHASE_FORCE, PERF_LLC_MISSES);
+        auto start = chrono::high_resolution_clock::now();
+        PerfRunPhase(PHASE_FORCE, [&] {
+            if (kernel == "cells")
+            {
+                BuildCellGrid(ps, BENCH_RC);
+                StartThreads(ps, MoveChunkCells);
+            }
+            else
+            {
+                BuildOctree(ps, BENCH_THETA);
+                StartThreads(ps, MoveChunkBH);
+            }
+        });
+        StartThreads(ps, UpdateChunkPosition);
+        auto end = chrono::high_resolution_clock::now();
+        result.stepMs = min(result.stepMs, chrono::duration<double, milli>(end - start).count());
+        result.l1Misses = PerfPhaseTotal(PHASE_FORCE, PERF_L1D_MISSES) - l1Before;
+        result.llcMisses = PerfPhaseTotal(PHASE_FORCE, PERF_LLC_MISSES) - llcBefore;
+    }
+    return result;
+}
+
+/**
+ * @brief Compares index order and Morton order for the tree and cell kernels.
+ *
+ * Runs on spatially extended initial conditions (uniform cube by default). The lattice has only 15
+ * distinct positions, so reordering it mostly groups coincident points and says little about locality.
+ *
+ * Reports the best step time, the L1D and LLC misses of the force phase (millions, through
+ * perf_event_open when available) and the cost of one reorder.
+ *
+ * Usage: ./bench_morton.exe [--n 16384,65536] [--ic uniform|plummer|...] [--seed s] [--reps r] [--threads T] [--backend b]
+ */
+int main(int argc, char **argv)
+{
+    if (!ParseSimdBackend(GetFlag(argc, argv, "--backend", "auto"), &activeBackend))
+    {
+        cerr << "❌ Error: --backend expects auto, sse, avx, avx2 or avx512 (supported by this CPU)" << endl;
+        return 1;
+    }
+    icConfig.kind = IC_UNIFORM;
+    if (!ParseInitialCondition(GetFlag(argc, argv, "--ic", "uniform"), &icConfig.kind))
+    {
+        cerr << "❌ Error: --ic expects lattice, plummer, uniform, cold or galaxies" << endl;
+        return 1;
+    }
+    icConfig.seed = stoull(GetFlag(argc, argv, "--seed", "1"));
+    poolThreads = (unsigned int)GetFlagInt(argc, argv, "--threads", NUM_THREADS);
+    vector<int> sizes = GetFlagIntList(argc, argv, "--n", "16384,65536");
+    int reps = GetFlagInt(argc, argv, "--reps", 3);
+    ThreadPool &pool = WorkerPool();
+    if (!PerfInit(pool))
+        cout << "Hardware counters unavailable (" << perfState.firstError << "), timing only" << endl;
+
+    cout << "\n---  Morton reordering, " << initialConditionNames[icConfig.kind] << ", " << pool.Size() << " threads, best of " << reps << " ---\n\n";
+    cout << left << setw(12) << "kernel" << setw(9) << "N" << setw(8) << "order" << right << setw(12) << "step ms"
+         << setw(12) << "L1D-miss M" << setw(12) << "LLC-miss M" << setw(12) << "reorder ms" << setw(10) << "speedup" << endl;
+
+    const string kernels[] = {"barnes-hut", "cells"};
+    for (const string &kernel : kernels)
+    {
+        for (int n : sizes)
+        {
+            OrderResult index = RunOrder((unsigned int)n, kernel, false, reps);
+            OrderResult morton = RunOrder((unsigned int)n, kernel, true, reps);
+            const OrderResult *rows[2] = {&index, &morton};
+            for (int k = 0; k < 2; ++k)
+            {
+                const OrderResult &row = *rows[k];
+                cout << left << setw(12) << kernel << setw(9) << n << setw(8) << (k ? "morton" : "index") << right
+                     << fixed << setprecision(2) << setw(12) << row.stepMs;
+                PrintPerfMillions(PERF_L1D_MISSES, row.l1Misses);
+                PrintPerfMillions(PERF_LLC_MISSES, row.llcMisses);
+                cout << setw(12);
+                if (k)
+                    cout << fixed << setprecision(2) << row.reorderMs;
+                else
+                    cout << "-";
+                cout << setw(9) << fixed << setprecision(2) << index.stepMs / row.stepMs << "x" << endl;
+            }
+        }
+    }
+    cout << defaultfloat;
+    PerfShutdown();
+    cout << "\nBenchmark complete." << endl;
+    return 0;
+}
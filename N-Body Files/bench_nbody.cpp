@@ -0,0 +1,225 @@
+/**************************************************
+ *                                                *
+ *    Benchmark driver: registered kernels over   *
+ *         a grid of N, threads and steps         *
+ *                                                *
+ *               Written by:                      *
+ *            Amir Zuabi - 212606222              *
+ *             Nir Schif - 212980395              *
+ *                                                *
+ **************************************************/
+
+#include "nbody_bench.hpp"
+#include "nbody_cli.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+// Timings and derived rates of one (kernel, N, threads, steps) configuration
+struct BenchResult
+{
+    string kernel;
+    unsigned int n, threads, steps;
+    vector<double> timesMs; // one entry per repetition, `steps` steps each
+    double medianMs, p95Ms, minMs, meanMs;
+    double interactionsPerSecond, gflops;
+};
+
+// Nearest-rank percentile of sorted values
+double Percentile(const vector<double> &sorted, double q)
+{
+    size_t rank = (size_t)ceil(q * sorted.size());
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+/**
+ * @brief Runs one configuration: `warmup` untimed runs, then `reps` timed runs of `steps` steps.
+ *
+ * The particles are re-initialized (untimed) before every run, so all repetitions do the same work.
+ */
+BenchResult RunConfiguration(const BenchKernel &kernel, unsigned int n, ThreadPool &pool,
+                             unsigned int steps, int warmup, int reps)
+{
+    BenchState state;
+    state.n = n;
+    state.pool = &pool;
+
+    BenchResult result;
+    result.kernel = kernel.name;
+    result.n = n;
+    result.threads = kernel.threaded ? pool.Size() : 1;
+    result.steps = steps;
+
+    for (int run = 0; run < warmup + reps; ++run)
+    {
+        kernel.init(state);
+        auto start = chrono::high_resolution_clock::now();
+        for (unsigned int step = 0; step < steps; ++step)
+            kernel.step(state);
+        auto end = chrono::high_resolution_clock::now();
+        if (run >= warmup)
+            result.timesMs.push_back(chrono::duration<double, milli>(end - start).count());
+    }
+
+    vector<double> sorted = result.timesMs;
+    sort(sorted.begin(), sorted.end());
+    result.medianMs = (sorted[(sorted.size() - 1) / 2] + sorted[sorted.size() / 2]) / 2;
+    result.p95Ms = Percentile(sorted, 0.95);
+    result.minMs = sorted.front();
+    double sum = 0;
+    for (double t : sorted)
+        sum += t;
+    result.meanMs = sum / sorted.size();
+
+    double interactions = (double)n * n * steps;
+    result.interactionsPerSecond = interactions / (result.medianMs * 1e-3);
+    result.gflops = result.interactionsPerSecond * FLOPS_PER_INTERACTION * 1e-9;
+    return result;
+}
+
+/**
+ * @brief Writes the run description and all results as JSON.
+ *
+ * @return false if the file cannot be written.
+ */
+bool WriteJson(const string &path, const vector<BenchResult> &results, int warmup, int reps)
+{
+    ofstream out(path);
+    if (!out.is_open())
+        return false;
+
+    char timestamp[32];
+    time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    out << setprecision(9);
+    out << "{\n";
+    out << "  \"benchmark\": \"nbody\",\n";
+    out << "  \"timestamp\": \"" << timestamp << "\",\n";
+    out << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+    out << "  \"hardware_threads\": " << NUM_THREADS << ",\n";
+    out << "  \"simd_backend\": \"" << forceBackends[activeBackend].name << "\",\n";
+    out << "  \"warmup\": " << warmup << ",\n";
+    out << "  \"repetitions\": " << reps << ",\n";
+    out << "  \"flops_per_interaction\": " << FLOPS_PER_INTERACTION << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t r = 0; r < results.size(); ++r)
+    {
+        const BenchResult &res = results[r];
+        out << "    {\"kernel\": \"" << res.kernel << "\", \"n\": " << res.n << ", \"threads\": " << res.threads
+            << ", \"steps\": " << res.steps << ",\n";
+        out << "     \"times_ms\": [";
+        for (size_t t = 0; t < res.timesMs.size(); ++t)
+            out << (t ? ", " : "") << res.timesMs[t];
+        out << "],\n";
+        out << "     \"median_ms\": " << res.medianMs << ", \"p95_ms\": " << res.p95Ms
+            << ", \"min_ms\": " << res.minMs << ", \"mean_ms\": " << res.meanMs << ",\n";
+        out << "     \"interactions_per_s\": " << res.interactionsPerSecond << ", \"gflops\": " << res.gflops << "}"
+            << (r + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    return (bool)out;
+}
+
+/**
+ * @brief Benchmarks registered kernels (nbody_bench.hpp) over a grid of configurations.
+ *
+ * Every (kernel, N, threads, steps) combination runs `warmup` untimed and `reps` timed repetitions;
+ * median, p95, interactions/s and GFLOP/s are printed and written to JSON. Single-threaded kernels
+ * (serial) run once per (N, steps), whatever the thread list.
+ *
+ * Usage: ./bench.exe [--kernels direct,tiled] [--n 1024,4096] [--threads 1,2,4] [--steps 1]
+ *                    [--warmup 1] [--reps 5] [--json bench_results.json] [--backend name]
+ *        --kernels all (default) runs every kernel the CPU supports.
+ */
+int main(int argc, char **argv)
+{
+    if (!ParseSimdBackend(GetFlag(argc, argv, "--backend", "auto"), &activeBackend))
+    {
+        cerr << "❌ Error: --backend expects auto, sse, avx, avx2 or avx512 (supported by this CPU)" << endl;
+        return 1;
+    }
+    vector<string> kernelNames = GetFlagList(argc, argv, "--kernels", "all");
+    vector<int> sizes = GetFlagIntList(argc, argv, "--n", "1024,4096");
+    vector<int> threadCounts = GetFlagIntList(argc, argv, "--threads", to_string(NUM_THREADS == 0 ? 1 : NUM_THREADS));
+    vector<int> stepCounts = GetFlagIntList(argc, argv, "--steps", "1");
+    int warmup = GetFlagInt(argc, argv, "--warmup", 1);
+    int reps = GetFlagInt(argc, argv, "--reps", 5);
+    string jsonPath = GetFlag(argc, argv, "--json", "bench_results.json");
+    if (reps < 1 || warmup < 0)
+    {
+        cerr << "❌ Error: --reps must be at least 1 and --warmup at least 0" << endl;
+        return 1;
+    }
+
+    // Resolve the kernel list against the registry
+    vector<const BenchKernel *> kernels;
+    if (kernelNames.size() == 1 && kernelNames[0] == "all")
+    {
+        for (const BenchKernel &kernel : benchKernels)
+        {
+            if (kernel.supported())
+                kernels.push_back(&kernel);
+        }
+    }
+    else
+    {
+        for (const string &name : kernelNames)
+        {
+            const BenchKernel *kernel = FindBenchKernel(name);
+            if (kernel == nullptr || !kernel->supported())
+            {
+                cerr << "❌ Error: unknown or unsupported kernel \"" << name << "\". Registered:";
+                for (const BenchKernel &k : benchKernels)
+                    cerr << ' ' << k.name;
+                cerr << endl;
+                return 1;
+            }
+            kernels.push_back(kernel);
+        }
+    }
+
+    cout << "\n---  N-body benchmark, " << forceBackends[activeBackend].name << " backend, "
+         << warmup << " warmup + " << reps << " reps ---\n\n";
+    cout << left << setw(13) << "kernel" << right << setw(8) << "N" << setw(9) << "threads" << setw(7) << "steps"
+         << setw(13) << "median ms" << setw(11) << "p95 ms" << setw(14) << "Ginteract/s" << setw(10) << "GFLOP/s" << endl;
+
+    vector<BenchResult> results;
+    for (int nThreads : threadCounts)
+    {
+        ThreadPool pool((unsigned int)nThreads);
+        for (const BenchKernel *kernel : kernels)
+        {
+            // Single-threaded kernels only run with the first thread count
+            if (!kernel->threaded && nThreads != threadCounts.front())
+                continue;
+            for (int n : sizes)
+            {
+                for (int steps : stepCounts)
+                {
+                    BenchResult r = RunConfiguration(*kernel, (unsigned int)n, pool, (unsigned int)steps, warmup, reps);
+                    cout << fixed << setprecision(3) << left << setw(13) << r.kernel << right << setw(8) << r.n
+                         << setw(9) << r.threads << setw(7) << r.steps << setw(13) << r.medianMs << setw(11) << r.p95Ms
+                         << setw(14) << r.interactionsPerSecond * 1e-9 << setw(10) << r.gflops << endl;
+                    results.push_back(r);
+                }
+            }
+        }
+    }
+
+    if (!WriteJson(jsonPath, results, warmup, reps))
+    {
+        cerr << "❌ Error: cannot write " << jsonPath << endl;
+        return 1;
+    }
+    cout << "\nResults written to " << jsonPath << endl;
+    cout << "Benchmark complete." << endl;
+    return 0;
+}
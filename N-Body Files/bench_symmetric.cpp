@@ -0,0 +1,107 @@
+/**************************************************
+ *                                                *
+ *    Benchmark: symmetric pairs vs. MoveChunk    *
+ *                                                *
+ *               Written by:                      *
+ *            Amir Zuabi - 212606222              *
+ *             Nir Schif - 212980395              *
+ *                                                *
+ **************************************************/
+
+#include "nbody_parallel.hpp"
+#include "nbody_symmetric.hpp"
+#include "nbody_cli.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+using namespace std;
+
+/**
+ * @brief Times the force phase of MoveChunk on a pool, best of `reps` runs.
+ *
+ * @return double Milliseconds of the fastest run.
+ */
+double TimeMoveChunk(ParticleSystem &ps, ThreadPool &pool, int reps)
+{
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r)
+    {
+        auto start = chrono::high_resolution_clock::now();
+        StartThreads(ps, MoveChunk, pool);
+        auto end = chrono::high_resolution_clock::now();
+        double ms = chrono::duration<double, milli>(end - start).count();
+        if (ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+/**
+ * @brief Same as TimeMoveChunk for the symmetric kernel (pair phase + reduction).
+ *
+ * @return double Milliseconds of the fastest run.
+ */
+double TimeSymmetric(ParticleSystem &ps, ThreadPool &pool, int reps)
+{
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r)
+    {
+        auto start = chrono::high_resolution_clock::now();
+        MoveSymmetric(ps, pool);
+        auto end = chrono::high_resolution_clock::now();
+        double ms = chrono::duration<double, milli>(end - start).count();
+        if (ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+/**
+ * @brief Compares the symmetric pair kernel against MoveChunk for 1, 2, 4 ... 2*NUM_THREADS threads.
+ *
+ * Both run the avx backend with exact precision. "pairs/s" counts physical pairs, N*(N-1)/2 per step,
+ * so the two columns are directly comparable even though MoveChunk evaluates every pair twice.
+ *
+ * Usage: ./bench_symmetric.exe [--n count] [--reps count]   (default N = 8192, 5 reps)
+ */
+int main(int argc, char **argv)
+{
+    if (!SymmetricKernelSupported())
+    {
+        cerr << "❌ Error: the symmetric kernel needs AVX, not supported on this CPU" << endl;
+        return 1;
+    }
+    activeBackend = SIMD_AVX;
+    ParticleSystem ps((unsigned int)GetFlagInt(argc, argv, "--n", 8192));
+    int reps = GetFlagInt(argc, argv, "--reps", 5);
+    InitChunk(ps, 0, ps.n);
+    double pairs = 0.5 * (double)ps.n * (ps.n - 1);
+
+    cout << "\n---  Symmetric pairs vs. MoveChunk, N = " << ps.n << ", best of " << reps << " ---\n\n";
+    cout << left << setw(9) << "threads"
+         << right << setw(14) << "MoveChunk ms" << setw(14) << "Gpairs/s"
+         << setw(14) << "symmetric ms" << setw(14) << "Gpairs/s" << setw(10) << "speedup" << endl;
+
+    unsigned int maxThreads = 2 * (NUM_THREADS == 0 ? 1 : NUM_THREADS);
+    for (unsigned int nThreads = 1; nThreads <= maxThreads; nThreads *= 2)
+    {
+        ThreadPool pool(nThreads);
+
+        // Warm up both kernels (also allocates the symmetric force buffers)
+        TimeMoveChunk(ps, pool, 1);
+        TimeSymmetric(ps, pool, 1);
+
+        double directMs = TimeMoveChunk(ps, pool, reps);
+        double symmetricMs = TimeSymmetric(ps, pool, reps);
+
+        cout << fixed << setprecision(2);
+        cout << left << setw(9) << nThreads
+             << right << setw(14) << directMs << setw(14) << pairs / directMs * 1e-6
+             << setw(14) << symmetricMs << setw(14) << pairs / symmetricMs * 1e-6
+             << setw(9) << directMs / symmetricMs << "x" << endl;
+    }
+
+    cout << "\nBenchmark complete." << endl;
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**************************************************
+ *                                                *
+ *    Benchmark: thread pool vs. spawn/join       *
+ *                                                *
+ *               Written by:                      *
+ *            Amir Zuabi - 212606222              *
+ *             Nir Schif - 212980395              *
+ *                                                *
+ **************************************************/
+
+#include "nbody_parallel.hpp"
+#include "nbody_cli.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+using namespace std;
+
+// Empty phase: measures pure dispatch cost (thread creation / wakeup + join / barrier)
+void EmptyChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    (void)ps;
+    (void)start;
+    (void)end;
+}
+
+/**
+ * @brief Runs `steps` simulated steps of two phases each with the spawn/join model.
+ *
+ * @return double Average microseconds per step.
+ */
+double TimeSpawnModel(ParticleSystem &ps, ChunkFunction phase1, ChunkFunction phase2,
+                      unsigned int nThreads, int steps)
+{
+    auto start = chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; ++step)
+    {
+        StartThreadsSpawn(ps, phase1, nThreads);
+        StartThreadsSpawn(ps, phase2, nThreads);
+    }
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double, micro>(end - start).count() / steps;
+}
+
+/**
+ * @brief Same as TimeSpawnModel, but dispatches both phases to a persistent pool.
+ *
+ * @return double Average microseconds per step.
+ */
+double TimePoolModel(ParticleSystem &ps, ChunkFunction phase1, ChunkFunction phase2,
+                     ThreadPool &pool, int steps)
+{
+    auto start = chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; ++step)
+    {
+        StartThreads(ps, phase1, pool);
+        StartThreads(ps, phase2, pool);
+    }
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double, micro>(end - start).count() / steps;
+}
+
+/**
+ * @brief Compares per-step overhead of the spawn/join model against the thread pool.
+ *
+ * Two workloads are measured for 1, 2, 4 ... 2*NUM_THREADS threads:
+ *  - empty phases, which isolates the dispatch overhead,
+ *  - UpdateChunkPosition twice, an O(N) phase where the overhead is still visible.
+ *
+ * Usage: ./bench_pool.exe [steps] [--n count]   (default 2000 steps, DEFAULT_PARTICLES)
+ */
+int main(int argc, char **argv)
+{
+    int steps = (argc > 1 && argv[1][0] != '-') ? stoi(argv[1]) : 2000;
+    ParticleSystem ps((unsigned int)GetFlagInt(argc, argv, "--n", DEFAULT_PARTICLES));
+    InitChunk(ps, 0, ps.n);
+
+    cout << "\n---  Thread pool vs. spawn/join, " << steps << " steps, N = " << ps.n << " ---\n\n";
+    cout << left << setw(9) << "threads" << setw(12) << "workload"
+         << right << setw(14) << "spawn us/step" << setw(14) << "pool us/step" << setw(10) << "speedup" << endl;
+
+    unsigned int maxThreads = 2 * (NUM_THREADS == 0 ? 1 : NUM_THREADS);
+    for (unsigned int nThreads = 1; nThreads <= maxThreads; nThreads *= 2)
+    {
+        ThreadPool pool(nThreads);
+
+        // Warm up both models once
+        TimeSpawnModel(ps, EmptyChunk, EmptyChunk, nThreads, 10);
+        TimePoolModel(ps, EmptyChunk, EmptyChunk, pool, 10);
+
+        double spawnEmpty = TimeSpawnModel(ps, EmptyChunk, EmptyChunk, nThreads, steps);
+        double poolEmpty = TimePoolModel(ps, EmptyChunk, EmptyChunk, pool, steps);
+        double spawnUpdate = TimeSpawnModel(ps, UpdateChunkPosition, UpdateChunkPosition, nThreads, steps);
+        double poolUpdate = TimePoolModel(ps, UpdateChunkPosition, UpdateChunkPosition, pool, steps);
+
+        cout << fixed << setprecision(2);
+        cout << left << setw(9) << nThreads << setw(12) << "empty"
+             << right << setw(14) << spawnEmpty << setw(14) << poolEmpty << setw(9) << spawnEmpty / poolEmpty << "x" << endl;
+        cout << left << setw(9) << nThreads << setw(12) << "update"
+             << right << setw(14) << spawnUpdate << setw(14) << poolUpdate << setw(9) << spawnUpdate / poolUpdate << "x" << endl;
+    }
+
+    cout << "\nBenchmark complete." << endl;
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**************************************************
+ *                                                *
+ *    Benchmark: tile size sweep for the          *
+ *               cache-blocked AVX kernel         *
+ *                                                *
+ *               Written by:                      *
+ *            Amir Zuabi - 212606222              *
+ *             Nir Schif - 212980395              *
+ *                                                *
+ **************************************************/
+
+#include "nbody_parallel.hpp"
+#include "nbody_tiled.hpp"
+#include "nbody_cli.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+using namespace std;
+
+/**
+ * @brief Runs one force phase `reps` times and returns the best time in seconds.
+ *
+ * Velocities are reset before each repetition so every run does identical work.
+ */
+double TimeForcePhase(ParticleSystem &ps, ChunkFunction kernel, int reps)
+{
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r)
+    {
+        InitChunk(ps, 0, ps.n);
+        auto start = chrono::high_resolution_clock::now();
+        StartThreads(ps, kernel);
+        auto end = chrono::high_resolution_clock::now();
+        best = min(best, chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+/**
+ * @brief Sweeps jTile x iBlock for MoveChunkTiled and reports interactions per second.
+ *
+ * MoveChunk on the avx backend is measured first as the untiled baseline.
+ *
+ * Usage: ./bench_tiles.exe [--n count] [--reps r]   (default N = 8192, 3 repetitions)
+ */
+int main(int argc, char **argv)
+{
+    ParticleSystem ps((unsigned int)GetFlagInt(argc, argv, "--n", 8192));
+    int reps = GetFlagInt(argc, argv, "--reps", 3);
+    if (!TiledKernelSupported())
+    {
+        cerr << "The tiled kernel needs AVX, not supported on this CPU." << endl;
+        return 1;
+    }
+    // Baseline on the same ISA as the tiled kernel
+    activeBackend = SIMD_AVX;
+    WorkerPool();
+
+    const double interactions = (double)ps.n * ps.n;
+    cout << "\n---  Tiled kernel sweep, N = " << ps.n << ", " << WorkerPool().Size() << " threads, best of " << reps << " ---\n\n";
+    cout << left << setw(10) << "jTile" << setw(8) << "iBlock"
+         << right << setw(12) << "time ms" << setw(16) << "Ginteract/s" << setw(10) << "speedup" << endl;
+
+    double baseline = TimeForcePhase(ps, MoveChunk, reps);
+    cout << fixed << setprecision(3);
+    cout << left << setw(10) << "MoveChunk" << setw(8) << "-"
+         << right << setw(12) << baseline * 1e3 << setw(16) << interactions / baseline / 1e9 << setw(9) << 1.0 << "x" << endl;
+
+    const unsigned int jTiles[] = {64, 128, 256, 512, 1024, 2048, 4096};
+    const unsigned int iBlocks[] = {1, 2, 4, 8};
+    for (unsigned int jTile : jTiles)
+    {
+        for (unsigned int iBlock : iBlocks)
+        {
+            tileConfig.jTile = jTile;
+            tileConfig.iBlock = iBlock;
+            double seconds = TimeForcePhase(ps, MoveChunkTiled, reps);
+            cout << left << setw(10) << jTile << setw(8) << iBlock
+                 << right << setw(12) << seconds * 1e3 << setw(16) << interactions / seconds / 1e9
+                 << setw(9) << baseline / seconds << "x" << endl;
+        }
+    }
+
+    cout << "\nBenchmark complete." << endl;
+    return 0;
+}
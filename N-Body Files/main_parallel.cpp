@@ -9,6 +9,22 @@
  **************************************************/
 
 #include "nbody_parallel.hpp"
+#include "nbody_barneshut.hpp"
+#include "nbody_tiled.hpp"
+#include "nbody_symmetric.hpp"
+#include "nbody_scheduler.hpp"
+#include "nbody_snapshot.hpp"
+#include "nbody_output.hpp"
+#include "nbody_perf.hpp"
+#include "nbody_numa.hpp"
+#include "nbody_integrator.hpp"
+#include "nbody_fused.hpp"
+#include "nbody_cells.hpp"
+#include "nbody_fmm.hpp"
+#include "nbody_morton.hpp"
+#include "nbody_aosoa.hpp"
+#include "nbody_ic.hpp"
+#include "nbody_cli.hpp"
 #include <iostream>
 #include <fstream>
 #include <cmath>
@@ -16,24 +32,22 @@
 #include <chrono>
 using namespace std;
 
-extern const int nParticles;
-extern float global_X[], global_Y[], global_Z[], global_Vx[], global_Vy[], global_Vz[];
-
 /**
  * @brief Writes the final state of particles to a text file.
  * 
+ * @param ps Particle system to save.
  * @param filename Name of the output file (e.g., "parallel_result.txt")
  */
-void SaveParticlesToFile(const string& filename)
+void SaveParticlesToFile(const ParticleSystem& ps, const string& filename)
 {
     ofstream out(filename);
-    for (int i = 0; i < nParticles; i++) {
-        out << global_X[i] << ' '
-            << global_Y[i] << ' '
-            << global_Z[i] << ' '
-            << global_Vx[i] << ' '
-            << global_Vy[i] << ' '
-            << global_Vz[i] << '\n';
+    for (unsigned int i = 0; i < ps.n; i++) {
+        out << ps.x[i] << ' '
+            << ps.y[i] << ' '
+            << ps.z[i] << ' '
+            << ps.vx[i] << ' '
+            << ps.vy[i] << ' '
+            << ps.vz[i] << '\n';
     }
     out.close();
 }
@@ -42,8 +56,62 @@ void SaveParticlesToFile(const string& filename)
  * @brief Main entry point for the parallel N-body simulation.
  * 
  * The number of simulation steps must be provided as a command-line argument.
- * This function initializes particle states, performs the parallel simulation,
- * and saves the final result to an output file.
+ * This function initializes particle states (or restores them from a snapshot), performs the
+ * parallel simulation, and saves the final result to an output file.
+ *
+ * Options:
+ *   --n <count>    Number of particles (default DEFAULT_PARTICLES).
+ *   --ic lattice|plummer|uniform|cold|galaxies
+ *                  Initial conditions (default lattice), see nbody_ic.hpp.
+ *   --seed <s>     Random seed of the generated initial conditions (default 1).
+ *   --bh <theta>   Use the Barnes-Hut tree force with opening angle theta instead of MoveChunk.
+ *   --fmm <p>      Use the Fast Multipole Method with expansion order p (1 - 8) instead of MoveChunk.
+ *   --fmm-leaf <count>
+ *                  FMM leaf size: cells holding more particles are split (default 128).
+ *   --tile <J>x<I> Use the cache-blocked kernel with J-particle j-tiles and I i-particles per block.
+ *   --precision exact|fast
+ *                  MoveChunk inverse distance: sqrt + div (default) or rsqrt + Newton-Raphson.
+ *   --accumulate float|kahan|double
+ *                  MoveChunk force sums: float (default), Kahan-compensated float, or double.
+ *   --backend auto|sse|avx|avx2|avx512
+ *                  SIMD backend of MoveChunk (default auto: widest supported by the CPU).
+ *   --integrator euler|leapfrog|rk4|block
+ *                  Time integrator (default euler: MoveChunk + UpdateChunkPosition). The others use the
+ *                  direct-sum force and combine with --backend, --precision and --accumulate only.
+ *   --max-level <L>, --eta <eta>
+ *                  Block timesteps: finest step dt / 2^L (default 4) and step criterion (default 0.02).
+ *   --fused        One parallel phase per step: the position update is fused into the force pass,
+ *                  with double-buffered positions (direct, tiled, cutoff and Barnes-Hut kernels).
+ *   --cutoff <rc>  Short-range mode: each particle only sees the 27 grid cells (edge >= rc) around its own.
+ *   --morton <K>   Sort the particles by Morton (Z-order) key every K steps (default 10) for memory locality.
+ *                  Result files, snapshots and trajectories keep the original particle order.
+ *   --layout soa|aosoa
+ *                  Particle storage of the direct-sum step: six arrays (default) or 8-particle AoSoA packets.
+ *   --symmetric    Compute each pair once (Newton's third law) with per-thread force buffers.
+ *   --threads <T>  Worker pool size (default: hardware threads).
+ *   --sched static|steal
+ *                  Force phase schedule: one chunk per thread (default) or work stealing.
+ *   --grain <G>    Particles per work-stealing task (default 64).
+ *   --checkpoint <K>
+ *                  Write a binary snapshot every K steps (to --snapshot, default checkpoint.nbs).
+ *   --restart <file>
+ *                  Resume from a binary snapshot, mapped straight into the particle buffers.
+ *                  The step count is the total, so "parallel.exe 100 --restart f" runs up to step 100.
+ *   --dump-every <K>
+ *                  Append the positions every K steps to a trajectory (--dump-file, default
+ *                  trajectory.nbt), written by a background thread while the next steps run.
+ *   --binary       Also save the final state as the binary snapshot parallel_result.nbs.
+ *   --perf         Read hardware counters (perf_event_open) per phase and per thread.
+ *   --pin none|compact|scatter
+ *                  Pin worker threads to CPUs: not at all (default), filling one NUMA node first,
+ *                  or round-robin over nodes.
+ *   --replicate    Give every NUMA node its own copy of the positions for the direct / tiled
+ *                  force phase (static schedule), refreshed after each position update.
+ *   --huge-pages off|thp|hugetlb
+ *                  Back the particle block with 2 MB pages: transparent huge pages (madvise) or hugetlbfs
+ *                  (MAP_HUGETLB, falls back to THP). The summary reports the backing used and, with
+ *                  --perf, the dTLB misses of the force phase.
+ *   --numa-report  Print thread placement and the NUMA node of the particle pages.
  * 
  * @param argc Number of command-line arguments.
  * @param argv Command-line arguments.
@@ -60,28 +128,428 @@ int main(int argc, char** argv) {
     }
 
     int maxSteps = std::stoi(argv[1]);
+    unsigned int nParticles = (unsigned int)GetFlagInt(argc, argv, "--n", DEFAULT_PARTICLES);
+    int checkpointEvery = GetFlagInt(argc, argv, "--checkpoint", 0);
+    string snapshotPath = GetFlag(argc, argv, "--snapshot", "checkpoint.nbs");
+    if (!ParseInitialCondition(GetFlag(argc, argv, "--ic", "lattice"), &icConfig.kind)) {
+        cerr << "❌ Error: --ic expects lattice, plummer, uniform, cold or galaxies" << endl;
+        return 1;
+    }
+    icConfig.seed = stoull(GetFlag(argc, argv, "--seed", "1"));
+    if (!ParsePageBacking(GetFlag(argc, argv, "--huge-pages", "off"), &pageConfig.requested)) {
+        cerr << "❌ Error: --huge-pages expects off, thp or hugetlb" << endl;
+        return 1;
+    }
+
+    // Fresh particles, or a snapshot mapped copy-on-write
+    unique_ptr<ParticleSystem> particles;
+    int firstStep = 1;
+    if (HasFlag(argc, argv, "--restart")) {
+        string restartPath = GetFlag(argc, argv, "--restart", "");
+        SnapshotHeader header;
+        string error;
+        particles = MapSnapshot(restartPath, &header, &error);
+        if (!particles) {
+            cerr << "❌ Error: cannot restart from " << restartPath << ": " << error << endl;
+            return 1;
+        }
+        firstStep = (int)header.step + 1;
+        cout << "Restarting from " << restartPath << " after step " << header.step << endl;
+    } else {
+        particles.reset(new ParticleSystem(nParticles, false)); // pages are first touched by the workers
+    }
+    ParticleSystem &ps = *particles;
+    cout << "Particles: " << ps.n << endl;
+    if (!ps.IsMapped() && icConfig.kind != IC_LATTICE)
+        cout << "Initial conditions: " << initialConditionNames[icConfig.kind] << ", seed " << icConfig.seed << endl;
+    bool useBarnesHut = HasFlag(argc, argv, "--bh");
+    float theta = GetFlagFloat(argc, argv, "--bh", 0.5f);
+    bool useTiled = HasFlag(argc, argv, "--tile");
+    if (useTiled && !ParseTileConfig(GetFlag(argc, argv, "--tile", ""), &tileConfig)) {
+        cerr << "❌ Error: --tile expects <jTile>x<iBlock>, jTile a multiple of 8 and iBlock 1, 2, 4 or 8, e.g. --tile 1024x4" << endl;
+        return 1;
+    }
+    if (useTiled && !TiledKernelSupported()) {
+        cerr << "❌ Error: --tile needs AVX, not supported on this CPU" << endl;
+        return 1;
+    }
+    bool useCells = HasFlag(argc, argv, "--cutoff");
+    float cutoff = 0;
+    if (useCells && !ParseCutoff(GetFlag(argc, argv, "--cutoff", ""), &cutoff)) {
+        cerr << "❌ Error: --cutoff expects a positive radius, e.g. --cutoff 2.5" << endl;
+        return 1;
+    }
+    bool useFmm = HasFlag(argc, argv, "--fmm");
+    if (useFmm && !ParseFmmOrder(GetFlag(argc, argv, "--fmm", ""), &fmmConfig.order)) {
+        cerr << "❌ Error: --fmm expects an expansion order from 1 to " << FMM_MAX_ORDER << ", e.g. --fmm 4" << endl;
+        return 1;
+    }
+    fmmConfig.leafSize = (unsigned int)GetFlagInt(argc, argv, "--fmm-leaf", (int)fmmConfig.leafSize);
+    if (fmmConfig.leafSize == 0) {
+        cerr << "❌ Error: --fmm-leaf must be at least 1" << endl;
+        return 1;
+    }
+    bool useSymmetric = HasFlag(argc, argv, "--symmetric");
+    if (useSymmetric && !SymmetricKernelSupported()) {
+        cerr << "❌ Error: --symmetric needs AVX, not supported on this CPU" << endl;
+        return 1;
+    }
+    poolThreads = (unsigned int)GetFlagInt(argc, argv, "--threads", NUM_THREADS);
+    if (!ParseSchedulePolicy(GetFlag(argc, argv, "--sched", "static"), &scheduleConfig.policy)) {
+        cerr << "❌ Error: --sched expects static or steal" << endl;
+        return 1;
+    }
+    scheduleConfig.grain = (unsigned int)GetFlagInt(argc, argv, "--grain", scheduleConfig.grain);
+    if (scheduleConfig.grain == 0) {
+        cerr << "❌ Error: --grain must be at least 1" << endl;
+        return 1;
+    }
+    if (!ParseForcePrecision(GetFlag(argc, argv, "--precision", "exact"), &forcePrecision)) {
+        cerr << "❌ Error: --precision expects exact or fast" << endl;
+        return 1;
+    }
+    if (!ParseForceAccumulation(GetFlag(argc, argv, "--accumulate", "float"), &forceAccumulation)) {
+        cerr << "❌ Error: --accumulate expects float, kahan or double" << endl;
+        return 1;
+    }
+    if (!ParseSimdBackend(GetFlag(argc, argv, "--backend", "auto"), &activeBackend)) {
+        cerr << "❌ Error: --backend expects auto, sse, avx, avx2 or avx512 (supported by this CPU)" << endl;
+        return 1;
+    }
+    PinPolicy pinPolicy = PIN_NONE;
+    if (!ParsePinPolicy(GetFlag(argc, argv, "--pin", "none"), &pinPolicy)) {
+        cerr << "❌ Error: --pin expects none, compact or scatter" << endl;
+        return 1;
+    }
+    IntegratorKind integrator = INTEGRATOR_EULER;
+    if (!ParseIntegrator(GetFlag(argc, argv, "--integrator", "euler"), &integrator)) {
+        cerr << "❌ Error: --integrator expects euler, leapfrog, rk4 or block" << endl;
+        return 1;
+    }
+    blockConfig.maxLevel = (unsigned int)GetFlagInt(argc, argv, "--max-level", (int)blockConfig.maxLevel);
+    blockConfig.eta = GetFlagFloat(argc, argv, "--eta", blockConfig.eta);
+    if (blockConfig.maxLevel > 16 || blockConfig.eta <= 0) {
+        cerr << "❌ Error: --max-level must be at most 16 and --eta positive" << endl;
+        return 1;
+    }
+    bool useReplicas = HasFlag(argc, argv, "--replicate");
+    bool useFused = HasFlag(argc, argv, "--fused");
+    if (useFused && (useSymmetric || useReplicas || integrator != INTEGRATOR_EULER)) {
+        cerr << "❌ Error: --fused applies to the direct, tiled, cutoff, Barnes-Hut and FMM kernels with the euler integrator" << endl;
+        return 1;
+    }
+    if (integrator != INTEGRATOR_EULER && (useBarnesHut || useSymmetric || useTiled || useReplicas)) {
+        cerr << "❌ Error: --integrator " << integratorNames[integrator] << " runs the direct-sum force only"
+             << " (no --bh, --symmetric, --tile or --replicate)" << endl;
+        return 1;
+    }
+    if (useReplicas && (useBarnesHut || useSymmetric || scheduleConfig.policy == SCHED_STEAL)) {
+        cerr << "❌ Error: --replicate applies to the direct and tiled kernels with the static schedule only"
+             << " (no --bh, --symmetric or --sched steal)" << endl;
+        return 1;
+    }
+    if (useFmm && (useCells || useBarnesHut || useSymmetric || useTiled || useReplicas || integrator != INTEGRATOR_EULER)) {
+        cerr << "❌ Error: --fmm has its own force kernel (no --cutoff, --bh, --symmetric, --tile, --replicate or --integrator)" << endl;
+        return 1;
+    }
+    if (useCells && (useBarnesHut || useSymmetric || useTiled || useReplicas || integrator != INTEGRATOR_EULER)) {
+        cerr << "❌ Error: --cutoff has its own force kernel (no --bh, --symmetric, --tile, --replicate or --integrator)" << endl;
+        return 1;
+    }
+    bool useMorton = HasFlag(argc, argv, "--morton");
+    int mortonEvery = GetFlagInt(argc, argv, "--morton", 10);
+    if (useMorton && mortonEvery < 1) {
+        cerr << "❌ Error: --morton expects a reorder period of at least 1 step" << endl;
+        return 1;
+    }
+    if (useMorton && (useFused || useReplicas || integrator != INTEGRATOR_EULER)) {
+        cerr << "❌ Error: --morton cannot reorder the fused buffers, replicas or integrator state"
+             << " (no --fused, --replicate or --integrator)" << endl;
+        return 1;
+    }
+    string layout = GetFlag(argc, argv, "--layout", "soa");
+    if (layout != "soa" && layout != "aosoa") {
+        cerr << "❌ Error: --layout expects soa or aosoa" << endl;
+        return 1;
+    }
+    bool usePacked = (layout == "aosoa");
+    if (usePacked && (useFmm || useCells || useBarnesHut || useSymmetric || useTiled || useReplicas || useFused || useMorton ||
+                      integrator != INTEGRATOR_EULER || scheduleConfig.policy != SCHED_STATIC)) {
+        cerr << "❌ Error: --layout aosoa runs the direct-sum step with static chunks only (no --fmm, --cutoff, --bh,"
+             << " --symmetric, --tile, --replicate, --fused, --morton, --integrator or --sched steal)" << endl;
+        return 1;
+    }
+    if (integrator != INTEGRATOR_EULER) {
+        cout << "Integrator: " << integratorNames[integrator];
+        if (integrator == INTEGRATOR_BLOCK)
+            cout << ", levels 0.." << blockConfig.maxLevel << ", eta = " << blockConfig.eta;
+        cout << endl;
+    }
+    if (useFmm) {
+        cout << "Force engine: FMM, order " << fmmConfig.order << ", adaptive octree, at most " << fmmConfig.leafSize << " particles per leaf"
+             << ", near field on the " << forceBackends[activeBackend].name << " backend" << endl;
+    } else if (useCells) {
+        cout << "Force engine: cutoff cell list, rc = " << cutoff << ", " << forceBackends[activeBackend].name << " backend" << endl;
+    } else if (useBarnesHut) {
+        cout << "Force engine: Barnes-Hut, theta = " << theta << endl;
+    } else if (useSymmetric) {
+        cout << "Force engine: symmetric pair direct sum, " << WorkerPool().Size() << " force buffers" << endl;
+    } else if (useTiled) {
+        cout << "Force engine: tiled direct sum, " << tileConfig.jTile << " x " << tileConfig.iBlock << endl;
+    } else {
+        cout << "Force engine: direct sum (" << (usePacked ? "AoSoA packets" : "MoveChunk") << "), "
+             << forceBackends[activeBackend].name << " backend, "
+             << (forcePrecision == PRECISION_FAST ? "fast rsqrt" : "exact") << " precision, "
+             << accumulationNames[forceAccumulation] << " accumulation" << endl;
+    }
+
+    if (useMorton)
+        cout << "Morton reordering: every " << mortonEvery << " steps" << endl;
+
+    cout << "Threads: " << WorkerPool().Size() << ", schedule: ";
+    if (scheduleConfig.policy == SCHED_STEAL)
+        cout << "work stealing, grain " << scheduleConfig.grain << endl;
+    else
+        cout << "static chunks" << endl;
 
-    // Initialize particle positions and velocities in parallel
-    InitChunk(0, nParticles);
+    // Create the worker threads once, every step reuses them, and place them before touching any page
+    WorkerPool();
+    PinThreads(pinPolicy);
+
+    // Initialize particle positions and velocities in parallel, each thread touching its own chunk
+    if (!ps.IsMapped())
+        FirstTouchInit(ps, GenerateChunk);
+    unique_ptr<AosoaParticles> packed;
+    if (usePacked) {
+        packed.reset(new AosoaParticles(ps.n));
+        PackParticles(ps, *packed);
+        cout << "Layout: AoSoA, " << packed->Packets() << " packets of " << PACKET_LANES << " particles" << endl;
+    }
+    if (useReplicas) {
+        CreateReplicas(ps);
+        cout << "Position replicas: " << numaState.topology.nodeCpus.size() << " NUMA node(s)" << endl;
+    }
+
+    // In-process hardware counters, opened on every pool thread
+    bool usePerf = HasFlag(argc, argv, "--perf");
+    if (usePerf && !PerfInit(WorkerPool()))
+        cout << "Hardware counters unavailable (" << perfState.firstError << "), running without them" << endl;
+
+    PrepareIntegrator(integrator, ps);
+    if (useFused) {
+        PrepareFused(ps, useFmm ? MoveChunkFMM : useCells ? MoveChunkCells : (useBarnesHut ? MoveChunkBH : (useTiled ? MoveChunkTiled : MoveChunk)));
+        cout << "Fused force + position update, double-buffered positions" << endl;
+    }
+
+    // Background trajectory writer
+    int dumpEvery = GetFlagInt(argc, argv, "--dump-every", 0);
+    string dumpPath = GetFlag(argc, argv, "--dump-file", "trajectory.nbt");
+    unique_ptr<AsyncTrajectoryWriter> trajectory;
+    if (dumpEvery > 0) {
+        trajectory.reset(new AsyncTrajectoryWriter(dumpPath, ps.n));
+        if (trajectory->Failed()) {
+            cerr << "❌ Error: " << trajectory->Error() << endl;
+            return 1;
+        }
+        cout << "Trajectory: every " << dumpEvery << " steps to " << dumpPath << endl;
+    }
 
     // Perform simulation steps in parallel
-    for (int step = 1; step <= maxSteps; ++step) {
+    for (int step = firstStep; step <= maxSteps; ++step) {
         cout << "\n--- Parallel Step " << step << " ---\n";
         auto start = std::chrono::high_resolution_clock::now();
-        StartThreads(MoveChunk);
-        StartThreads(UpdateChunkPosition);
+        if (useMorton && (step - firstStep) % mortonEvery == 0)
+            PerfRunPhase(PHASE_FORCE, [&] { ReorderMorton(ps); });
+        if (integrator != INTEGRATOR_EULER) {
+            // Force evaluations and updates interleave, the whole step counts as force phase
+            PerfRunPhase(PHASE_FORCE, [&] { IntegratorStep(ps); });
+        } else if (useFused) {
+            // Force, velocity and position update in one pass, from the current into the other buffer
+            PerfRunPhase(PHASE_FORCE, [&] {
+                if (useBarnesHut)
+                    BuildOctree(FusedCurrent(), theta);
+                else if (useCells)
+                    BuildCellGrid(FusedCurrent(), cutoff);
+                else if (useFmm)
+                    BuildFmm(FusedCurrent());
+                StartThreadsScheduled(FusedCurrent(), MoveChunkFused);
+                SwapFusedBuffers();
+            });
+        } else {
+            PerfRunPhase(PHASE_FORCE, [&] {
+                if (useFmm) {
+                    BuildFmm(ps);
+                    StartThreadsScheduled(ps, MoveChunkFMM);
+                } else if (useCells) {
+                    BuildCellGrid(ps, cutoff);
+                    StartThreadsScheduled(ps, MoveChunkCells);
+                } else if (useBarnesHut) {
+                    BuildOctree(ps, theta);
+                    StartThreadsScheduled(ps, MoveChunkBH);
+                } else if (useSymmetric) {
+                    MoveSymmetric(ps);
+                } else if (useReplicas) {
+                    StartThreadsReplicated(useTiled ? MoveChunkTiled : MoveChunk);
+                } else if (useTiled) {
+                    StartThreadsScheduled(ps, MoveChunkTiled);
+                } else if (packed) {
+                    StartPacketThreads(*packed, MovePacketChunk);
+                } else {
+                    StartThreadsScheduled(ps, MoveChunk);
+                }
+            });
+            PerfRunPhase(PHASE_UPDATE, [&] {
+                if (packed)
+                    StartPacketThreads(*packed, UpdatePacketPositions);
+                else
+                    StartThreads(ps, UpdateChunkPosition);
+                if (useReplicas)
+                    RefreshReplicas(ps);
+            });
+        }
+        bool submitted = true;
+        if (trajectory && step % dumpEvery == 0)
+            PerfRunPhase(PHASE_OUTPUT, [&] {
+                if (packed)
+                    UnpackParticles(*packed, ps);
+                submitted = trajectory->Submit(useFused ? FusedCurrent() : MortonOriginalOrder(ps), (uint64_t)step);
+            });
+        if (!submitted) {
+            cerr << "❌ Error: " << trajectory->Error() << endl;
+            return 1;
+        }
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         cout << "Parallel step time: " << duration << " ms" << endl;
+
+        if (checkpointEvery > 0 && step % checkpointEvery == 0) {
+            string error;
+            bool saved = true;
+            PerfRunPhase(PHASE_OUTPUT, [&] {
+                if (useFused)
+                    SyncFusedPositions();
+                if (packed)
+                    UnpackParticles(*packed, ps);
+                saved = SaveSnapshot(MortonOriginalOrder(ps), (uint64_t)step, snapshotPath, &error);
+            });
+            if (!saved) {
+                cerr << "❌ Error: checkpoint failed: " << error << endl;
+                return 1;
+            }
+            cout << "Checkpoint written to " << snapshotPath << endl;
+        }
+    }
+
+    // The owner's block must hold the final positions for the reports and result files
+    if (useFused)
+        SyncFusedPositions();
+    if (packed)
+        UnpackParticles(*packed, ps);
+
+    // Flush the trajectory and report how much of its I/O ran behind compute
+    if (trajectory) {
+        trajectory->Finish();
+        if (trajectory->Failed()) {
+            cerr << "❌ Error: " << trajectory->Error() << endl;
+            return 1;
+        }
+        const OutputStats &io = trajectory->Stats();
+        cout << "\n--- Trajectory output ---\n";
+        cout << "Frames: " << io.frames << " (" << io.bytes / (1024.0 * 1024.0) << " MB) to " << dumpPath << endl;
+        cout << "Writer thread time:      " << io.writeMs << " ms" << endl;
+        cout << "Main thread copy time:   " << io.copyMs << " ms" << endl;
+        cout << "Main thread stall time:  " << io.blockedMs + io.drainMs << " ms (buffers full "
+             << io.blockedMs << " ms, final drain " << io.drainMs << " ms)" << endl;
+        cout << "I/O hidden behind compute: " << trajectory->HiddenMs() << " ms ("
+             << (io.writeMs > 0 ? 100.0 * trajectory->HiddenMs() / io.writeMs : 100.0) << " %)" << endl;
+    }
+
+    if (HasFlag(argc, argv, "--numa-report")) {
+        cout << "\n--- NUMA placement ---\n";
+        PrintNumaReport(ps);
+    }
+
+    if (useFmm) {
+        int steps = max(maxSteps - firstStep + 1, 1);
+        cout << "\n--- FMM ---\n";
+        cout << "Tree depth " << fmmTree.depth << ", " << fmmTree.leafCount << " leaves (largest " << fmmTree.maxLeafCount << " particles), "
+             << fmmTables.terms << " terms per expansion" << endl;
+        cout << "Last step: " << fmmTree.m2lCount << " M2L (V), " << fmmTree.wCount << " M2P (W) and as many P2L (X) cell pairs" << endl;
+        cout << "Per step: tree " << fmmTree.buildMs / steps << " ms, upward pass " << fmmTree.upwardMs / steps
+             << " ms, downward pass " << fmmTree.downwardMs / steps << " ms (L2P + P2P in the force phase)" << endl;
+    }
+
+    if (useMorton) {
+        cout << "\n--- Morton reordering ---\n";
+        cout << "Reorders: " << mortonState.reorders << ", keys + radix sort " << mortonState.sortMs
+             << " ms, permutation " << mortonState.permuteMs << " ms" << endl;
+    }
+
+    cout << "\n--- Memory pages ---\n";
+    if (pageConfig.requested != PAGES_SMALL)
+        cout << "Requested: --huge-pages " << pageBackingNames[pageConfig.requested] << " (blocks of 2 MB or more)" << endl;
+    PrintPageReport("Particle block", ps);
+    if (mortonState.scratch)
+        PrintPageReport("Morton scratch", *mortonState.scratch);
+    if (cellGrid.sorted)
+        PrintPageReport("Cell-sorted copy", *cellGrid.sorted);
+    if (integratorState.accel)
+        PrintPageReport("Integrator accelerations", *integratorState.accel);
+    if (integratorState.stage)
+        PrintPageReport("Integrator RK4 stage", *integratorState.stage);
+    if (integratorState.sum)
+        PrintPageReport("Integrator RK4 sums", *integratorState.sum);
+    if (usePerf && perfState.available[PERF_DTLB_MISSES]) {
+        int steps = max(maxSteps - firstStep + 1, 1);
+        cout << "dTLB load misses, force phase: " << fixed << setprecision(0)
+             << PerfPhaseTotal(PHASE_FORCE, PERF_DTLB_MISSES) / steps << " per step" << defaultfloat << endl;
+    } else {
+        cout << "dTLB load misses: n/a (" << (usePerf ? "counter unavailable" : "run with --perf") << ")" << endl;
     }
 
-    // Save final simulation state to file
+    if (integrator != INTEGRATOR_EULER) {
+        cout << "\n--- Integrator ---\n";
+        PrintIntegratorReport(ps);
+    } else {
+        // Per-thread load balance of the force phase
+        cout << "\n--- Force phase thread statistics ---\n";
+        PrintThreadStats();
+    }
+
+    // Save final simulation state to file, in the original particle order
     auto start = std::chrono::high_resolution_clock::now();
-    SaveParticlesToFile("parallel_result.txt");
+    const ParticleSystem *output = &ps;
+    PerfRunPhase(PHASE_OUTPUT, [&] {
+        output = &MortonOriginalOrder(ps);
+        SaveParticlesToFile(*output, "parallel_result.txt");
+    });
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
     cout << "\n === Parallel saving time time: " << duration << " ms ===\n" << endl;
+    if (HasFlag(argc, argv, "--binary")) {
+        string error;
+        int lastStep = (maxSteps > firstStep - 1) ? maxSteps : firstStep - 1;
+        bool saved = true;
+        start = std::chrono::high_resolution_clock::now();
+        PerfRunPhase(PHASE_OUTPUT, [&] { saved = SaveSnapshot(*output, (uint64_t)lastStep, "parallel_result.nbs", &error); });
+        if (!saved) {
+            cerr << "❌ Error: " << error << endl;
+            return 1;
+        }
+        end = std::chrono::high_resolution_clock::now();
+        duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        cout << " === Binary snapshot saving time: " << duration << " ms (parallel_result.nbs) ===\n" << endl;
+    }
+
+    if (usePerf) {
+        cout << "--- Hardware counters per phase and thread ---\n";
+        PrintPerfReport();
+        PerfShutdown();
+        cout << endl;
+    }
+    FreeReplicas();
+    FreeFused();
     cout << "Parallel simulation complete. Results saved to parallel_result.txt" << endl;
     return 0;
 }
@@ -0,0 +1,161 @@
+/**************************************************
+ *                                                *
+ *     main() for the multi-process ring run      *
+ *                                                *
+ *               Written by:                      *
+ *            Amir Zuabi - 212606222              *
+ *             Nir Schif - 212980395              *
+ *                                                *
+ **************************************************/
+
+#include "nbody_ring.hpp"
+#include "nbody_cli.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cmath>
+using namespace std;
+
+/**
+ * @brief Writes the final state of particles to a text file.
+ *
+ * @param ps Particle system to save.
+ * @param filename Name of the output file (e.g., "ring_result.txt")
+ */
+void SaveParticlesToFile(const ParticleSystem &ps, const string &filename)
+{
+    ofstream out(filename);
+    for (unsigned int i = 0; i < ps.n; i++) {
+        out << ps.x[i] << ' '
+            << ps.y[i] << ' '
+            << ps.z[i] << ' '
+            << ps.vx[i] << ' '
+            << ps.vy[i] << ' '
+            << ps.vz[i] << '\n';
+    }
+    out.close();
+}
+
+/**
+ * @brief Runs `steps` ring steps of n lattice particles over config.ranks processes.
+ *
+ * @return false (error printed) if the ring failed. *wallMs receives the slowest rank's time.
+ */
+bool RunLattice(const RingConfig &config, unsigned int n, vector<RankStats> *stats, double *wallMs,
+                unique_ptr<ParticleSystem> *result = nullptr)
+{
+    unique_ptr<ParticleSystem> particles = CreateSharedParticles(n);
+    if (!particles) {
+        cerr << "❌ Error: cannot map " << n << " shared particles" << endl;
+        return false;
+    }
+    InitChunk(*particles, 0, n);
+    string error;
+    if (!RunRing(config, *particles, stats, &error)) {
+        cerr << "❌ Error: ring run with " << config.ranks << " ranks failed: " << error << endl;
+        return false;
+    }
+    *wallMs = RingWallMs(*stats);
+    if (result)
+        *result = move(particles);
+    return true;
+}
+
+/**
+ * @brief Strong and weak scaling over 1, 2, 4 ... maxRanks ranks.
+ *
+ * Strong scaling keeps N fixed: efficiency = T(1) / (R * T(R)). Direct-sum work grows as N^2, so weak
+ * scaling keeps the work per rank fixed with N(R) = N * sqrt(R): efficiency = T(1) / T(R).
+ */
+bool RunScaling(RingConfig config, unsigned int n, unsigned int maxRanks)
+{
+    cout << "\n--- Scaling, " << config.steps << " steps, " << config.threadsPerRank << " thread(s) per rank ---\n";
+    cout << left << setw(7) << "ranks" << right << setw(10) << "N" << setw(12) << "strong ms" << setw(10) << "speedup"
+         << setw(12) << "efficiency" << setw(10) << "N" << setw(12) << "weak ms" << setw(12) << "efficiency" << endl;
+    double strongBase = 0, weakBase = 0;
+    for (unsigned int ranks = 1; ranks <= maxRanks; ranks *= 2) {
+        config.ranks = ranks;
+        unsigned int weakN = (unsigned int)lround(n * sqrt((double)ranks));
+        vector<RankStats> stats;
+        double strongMs, weakMs;
+        if (!RunLattice(config, n, &stats, &strongMs) || !RunLattice(config, weakN, &stats, &weakMs))
+            return false;
+        if (ranks == 1) {
+            strongBase = strongMs;
+            weakBase = weakMs;
+        }
+        cout << fixed << setprecision(2) << left << setw(7) << ranks << right << setw(10) << n << setw(12) << strongMs
+             << setw(9) << strongBase / strongMs << "x" << setw(11) << 100.0 * strongBase / (ranks * strongMs) << "%"
+             << setw(10) << weakN << setw(12) << weakMs << setw(11) << 100.0 * weakBase / weakMs << "%" << endl;
+    }
+    cout << defaultfloat;
+    return true;
+}
+
+/**
+ * @brief Main entry point for the multi-process (ring exchange) N-body simulation.
+ *
+ * Runs the direct sum over several processes on this host, each owning a slice of the particles,
+ * and saves the final state to ring_result.txt (compare it with validate.exe against parallel_result.txt).
+ *
+ * Options:
+ *   --ranks <R>      Number of processes (default 2).
+ *   --n <count>      Number of particles (default DEFAULT_PARTICLES).
+ *   --threads <T>    Worker threads per rank (default 1).
+ *   --backend auto|sse|avx|avx2|avx512
+ *                    SIMD backend of the force kernel.
+ *   --scaling <maxR> Instead of one run, report strong and weak scaling for 1, 2, 4 ... maxR ranks.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Command-line arguments.
+ * @return int Exit code (0 on success, 1 on failure).
+ */
+int main(int argc, char **argv) {
+    cout << "\n---  Starting Ring Run ---\n";
+    if (argc < 2) {
+        cerr << "❌ Error: Please provide the number of steps, e.g., ./ring.exe 10 --ranks 4" << endl;
+        return 1;
+    }
+
+    RingConfig config;
+    config.steps = std::stoi(argv[1]);
+    config.ranks = (unsigned int)GetFlagInt(argc, argv, "--ranks", (int)config.ranks);
+    config.threadsPerRank = (unsigned int)GetFlagInt(argc, argv, "--threads", (int)config.threadsPerRank);
+    unsigned int nParticles = (unsigned int)GetFlagInt(argc, argv, "--n", DEFAULT_PARTICLES);
+    if (!ParseSimdBackend(GetFlag(argc, argv, "--backend", "auto"), &activeBackend)) {
+        cerr << "❌ Error: --backend expects auto, sse, avx, avx2 or avx512 (supported by this CPU)" << endl;
+        return 1;
+    }
+    if (config.ranks == 0 || config.threadsPerRank == 0 || config.ranks > nParticles) {
+        cerr << "❌ Error: --ranks and --threads must be at least 1, and --ranks at most --n" << endl;
+        return 1;
+    }
+    cout << "Force engine: direct sum, " << forceBackends[activeBackend].name << " backend" << endl;
+
+    if (HasFlag(argc, argv, "--scaling"))
+        return RunScaling(config, nParticles, (unsigned int)GetFlagInt(argc, argv, "--scaling", 4)) ? 0 : 1;
+
+    cout << "Ranks: " << config.ranks << " x " << config.threadsPerRank << " thread(s), particles: " << nParticles << endl;
+    vector<RankStats> stats;
+    double wallMs;
+    unique_ptr<ParticleSystem> result;
+    if (!RunLattice(config, nParticles, &stats, &wallMs, &result))
+        return 1;
+
+    // Per-rank compute / communication overlap: hidden = share of the exchange time the force kernel ran alongside
+    cout << "\n--- Rank statistics (" << config.steps << " steps) ---\n";
+    cout << left << setw(6) << "rank" << right << setw(12) << "total ms" << setw(12) << "compute ms" << setw(10) << "comm ms"
+         << setw(12) << "overlap ms" << setw(10) << "wait ms" << setw(10) << "hidden" << setw(10) << "MB sent" << endl;
+    for (unsigned int r = 0; r < stats.size(); ++r) {
+        const RankStats &s = stats[r];
+        double hidden = (s.commMs > 0) ? 100.0 * s.overlapMs / s.commMs : 100.0;
+        cout << fixed << setprecision(2) << left << setw(6) << r << right << setw(12) << s.stepMs << setw(12) << s.computeMs
+             << setw(10) << s.commMs << setw(12) << s.overlapMs << setw(10) << s.waitMs << setw(9) << hidden << "%" << setw(10) << s.bytes / (1024.0 * 1024.0) << endl;
+    }
+    cout << defaultfloat << setprecision(6);
+    cout << "Wall time (slowest rank): " << wallMs << " ms, " << wallMs / config.steps << " ms per step" << endl;
+
+    SaveParticlesToFile(*result, "ring_result.txt");
+    cout << "\nRing simulation complete. Results saved to ring_result.txt" << endl;
+    return 0;
+}
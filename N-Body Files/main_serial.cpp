@@ -9,24 +9,27 @@
  **************************************************/
 
 #include "nbody_serial.hpp"
+#include "nbody_snapshot.hpp"
+#include "nbody_perf.hpp"
+#include "nbody_ic.hpp"
+#include "nbody_cli.hpp"
 #include <iostream>
 #include <fstream>
 #include <cmath>
 #include <chrono>
+#include <memory>
 using namespace std;
 
-extern const int nParticles;
-extern ParticleType serialParticles[];
-
 /**
  * @brief Writes particle data to a text file in human-readable format.
  * 
+ * @param serialParticles Particles to save.
  * @param filename The name of the output file (e.g., "serial_result.txt")
  */
-void SaveParticlesToFile(const string& filename)
+void SaveParticlesToFile(const SerialParticles& serialParticles, const string& filename)
 {
     ofstream out(filename);
-    for (int i = 0; i < nParticles; i++) {
+    for (unsigned int i = 0; i < serialParticles.Size(); i++) {
         out << serialParticles[i].x << ' '
             << serialParticles[i].y << ' '
             << serialParticles[i].z << ' '
@@ -42,6 +45,17 @@ void SaveParticlesToFile(const string& filename)
  * 
  * The number of steps must be passed as a command-line argument. This function
  * initializes the particles, performs the simulation, and saves the results to a file.
+ *
+ * Options:
+ *   --n <count>    Number of particles (default DEFAULT_PARTICLES).
+ *   --ic lattice|plummer|uniform|cold|galaxies
+ *                  Initial conditions (default lattice), identical to parallel.exe for the same --seed.
+ *   --seed <s>     Random seed of the generated initial conditions (default 1).
+ *   --layout aos|aosoa
+ *                  Particle storage of the steps: 32-byte ParticleType structs (default) or 8-particle
+ *                  AoSoA packets. Same kernel and operation order, so both give identical results.
+ *   --binary       Also save the final state as the binary snapshot serial_result.nbs.
+ *   --perf         Read hardware counters (perf_event_open) for the step and output phases.
  * 
  * @param argc Number of command-line arguments.
  * @param argv Command-line arguments.
@@ -58,28 +72,117 @@ int main(int argc, char** argv) {
     }
 
     int maxSteps = std::stoi(argv[1]);
+    unsigned int nParticles = (unsigned int)GetFlagInt(argc, argv, "--n", DEFAULT_PARTICLES);
+    if (!ParseInitialCondition(GetFlag(argc, argv, "--ic", "lattice"), &icConfig.kind)) {
+        cerr << "❌ Error: --ic expects lattice, plummer, uniform, cold or galaxies" << endl;
+        return 1;
+    }
+    icConfig.seed = stoull(GetFlag(argc, argv, "--seed", "1"));
+    string layout = GetFlag(argc, argv, "--layout", "aos");
+    if (layout != "aos" && layout != "aosoa") {
+        cerr << "❌ Error: --layout expects aos or aosoa" << endl;
+        return 1;
+    }
+    SerialParticles serialParticles(nParticles);
+    cout << "Particles: " << nParticles << endl;
 
     // Initialize all particle positions and velocities
-    InitParticleSerial();
+    if (icConfig.kind == IC_LATTICE) {
+        InitParticleSerial(serialParticles);
+    } else {
+        cout << "Initial conditions: " << initialConditionNames[icConfig.kind] << ", seed " << icConfig.seed << endl;
+        for (unsigned int i = 0; i < nParticles; i++) {
+            OneParticle p;
+            GenerateParticle(icConfig, i, nParticles, &p);
+            serialParticles[i].x = p.x;
+            serialParticles[i].y = p.y;
+            serialParticles[i].z = p.z;
+            serialParticles[i].vx = p.vx;
+            serialParticles[i].vy = p.vy;
+            serialParticles[i].vz = p.vz;
+        }
+    }
+
+    // Packed copy for --layout aosoa: initialized from the AoS particles, copied back before saving
+    unique_ptr<AosoaParticles> packed;
+    if (layout == "aosoa") {
+        packed.reset(new AosoaParticles(nParticles));
+        for (unsigned int i = 0; i < nParticles; i++) {
+            OneParticle p;
+            GetParticleSerial(serialParticles, i, &p);
+            packed->Set(i, p);
+        }
+        cout << "Layout: AoSoA, " << packed->Packets() << " packets of " << PACKET_LANES << " particles" << endl;
+    }
+
+    // Counters of the main thread only (a pool of one thread runs on the caller)
+    ThreadPool mainThread(1);
+    bool usePerf = HasFlag(argc, argv, "--perf");
+    if (usePerf && !PerfInit(mainThread))
+        cout << "Hardware counters unavailable (" << perfState.firstError << "), running without them" << endl;
 
     // Run simulation for the given number of steps
     for (int step = 1; step <= maxSteps; ++step) {
         cout << "\n--- Serial Step " << step << " ---\n";
 
         auto start = std::chrono::high_resolution_clock::now();
-        MoveParticlesSerial();
+        PerfRunPhase(PHASE_FORCE, [&] {
+            if (packed)
+                MoveParticlesSerialPacked(*packed);
+            else
+                MoveParticlesSerial(serialParticles);
+        });
         auto end = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         cout << "Serial step time: " << duration << " ms" << endl;
     }
 
+    if (packed) {
+        for (unsigned int i = 0; i < nParticles; i++) {
+            OneParticle p;
+            packed->Get(i, &p);
+            serialParticles[i].x = p.x;
+            serialParticles[i].y = p.y;
+            serialParticles[i].z = p.z;
+            serialParticles[i].vx = p.vx;
+            serialParticles[i].vy = p.vy;
+            serialParticles[i].vz = p.vz;
+        }
+    }
+
     // Save final particle state to output file
     auto start = std::chrono::high_resolution_clock::now();
-    SaveParticlesToFile("serial_result.txt");
+    PerfRunPhase(PHASE_OUTPUT, [&] { SaveParticlesToFile(serialParticles, "serial_result.txt"); });
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
     cout << "\n === Serial saving time time: " << duration << " ms ===\n" << endl;
+    if (HasFlag(argc, argv, "--binary")) {
+        // Snapshots are SoA: convert the AoS reference first
+        ParticleSystem snapshot(nParticles);
+        for (unsigned int i = 0; i < nParticles; i++) {
+            snapshot.x[i] = serialParticles[i].x;
+            snapshot.y[i] = serialParticles[i].y;
+            snapshot.z[i] = serialParticles[i].z;
+            snapshot.vx[i] = serialParticles[i].vx;
+            snapshot.vy[i] = serialParticles[i].vy;
+            snapshot.vz[i] = serialParticles[i].vz;
+        }
+        string error;
+        bool saved = true;
+        PerfRunPhase(PHASE_OUTPUT, [&] { saved = SaveSnapshot(snapshot, (uint64_t)maxSteps, "serial_result.nbs", &error); });
+        if (!saved) {
+            cerr << "❌ Error: " << error << endl;
+            return 1;
+        }
+        cout << "Binary snapshot saved to serial_result.nbs" << endl;
+    }
+    if (usePerf) {
+        cout << "--- Hardware counters per phase ---\n";
+        PrintPerfReport();
+        PerfShutdown();
+        cout << endl;
+    }
     cout << "Serial simulation complete. Results saved to serial_result.txt" << endl;
     return 0;
 }
@@ -1,59 +1,391 @@
 // ===== File: validate.cpp =====
+#include "nbody_parallel.hpp"
+#include "nbody_barneshut.hpp"
+#include "nbody_fmm.hpp"
+#include "nbody_ic.hpp"
+#include "nbody_symmetric.hpp"
+#include "nbody_compare.hpp"
+#include "nbody_cli.hpp"
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <cmath>
 #include <chrono>
+#include <vector>
 using namespace std;
 
-// Acceptable error margin when comparing particle positions
+// Default acceptable error margin when comparing particle positions (--tolerance)
 const float EPSILON = 0.1f;
 
-// Number of particles expected in each file (must match simulation)
-const int nParticles = 16384 * 2; // adjust if needed
+// Per-particle forces of the reference (direct) and tested kernels
+vector<float> refFx, refFy, refFz;
+vector<float> testFx, testFy, testFz;
+
+// Prints one error row: max / mean / percentiles
+void PrintErrorRow(const string &label, const ErrorSummary &e)
+{
+    cout << left << setw(18) << label << right << scientific << setprecision(3)
+         << setw(12) << e.max << setw(12) << e.mean << setw(12) << e.p50
+         << setw(12) << e.p99 << setw(12) << e.p999 << defaultfloat << endl;
+}
+
+// Prints energy and momentum of one state, and its energy drift against the initial state
+void PrintInvariants(const string &label, const Invariants &inv, double initialEnergy)
+{
+    double energy = inv.kinetic + inv.potential;
+    cout << left << setw(10) << label << right << setprecision(10)
+         << "E = " << energy << " (K = " << inv.kinetic << ", U = " << inv.potential << ")"
+         << ", drift " << scientific << setprecision(3) << (energy - initialEnergy) / fabs(initialEnergy)
+         << ", |P| = " << sqrt(inv.px * inv.px + inv.py * inv.py + inv.pz * inv.pz) << defaultfloat << endl;
+}
 
 /**
- * @brief Compares two simulation output files line-by-line for positional accuracy.
- * 
- * Reads particle data from both files and compares the x, y, and z values.
- * If any difference exceeds EPSILON, a mismatch is reported.
- * 
- * @param file1 Path to the first result file (e.g., "serial_result.txt")
- * @param file2 Path to the second result file (e.g., "parallel_result.txt")
- * @return true if all particles match within EPSILON, false otherwise.
+ * @brief Compares two simulation outputs (text or binary snapshots) over positions and velocities.
+ *
+ * Both files are loaded in parallel (see nbody_compare.hpp). Reports max / mean / p50 / p99 / p99.9
+ * of the absolute, relative and ULP error of positions and velocities, and, unless withEnergy
+ * is false, the energy and momentum of both states with their drift against the initial state (--ic / --seed).
+ * The particle count is taken from the files themselves, which must match.
+ *
+ * @param file1 Path to the reference result (e.g., "serial_result.txt")
+ * @param file2 Path to the tested result (e.g., "parallel_result.txt")
+ * @param tolerance Largest accepted absolute position error.
+ * @return true if all positions match within tolerance, false otherwise.
  */
-bool CompareResults(const string& file1, const string& file2) {
-    ifstream in1(file1), in2(file2);
-    if (!in1.is_open() || !in2.is_open()) {
-        cerr << "Error opening files." << endl;
+bool CompareResults(const string& file1, const string& file2, float tolerance, bool withEnergy) {
+    string error;
+    auto start = chrono::high_resolution_clock::now();
+    unique_ptr<ParticleSystem> ref = LoadResults(file1, &error);
+    unique_ptr<ParticleSystem> test = ref ? LoadResults(file2, &error) : nullptr;
+    if (!ref || !test) {
+        cerr << "Error: " << error << endl;
+        return false;
+    }
+    auto end = chrono::high_resolution_clock::now();
+    cout << "Loaded " << file1 << " and " << file2 << " in "
+         << chrono::duration<double, milli>(end - start).count() << " ms" << endl;
+    if (ref->n != test->n) {
+        cout << "Particle count mismatch: " << ref->n << " vs " << test->n << " particles" << endl;
         return false;
     }
 
-    float x1, y1, z1, vx1, vy1, vz1;
-    float x2, y2, z2, vx2, vy2, vz2;
+    const float *refPos[3] = {ref->x, ref->y, ref->z}, *testPos[3] = {test->x, test->y, test->z};
+    const float *refVel[3] = {ref->vx, ref->vy, ref->vz}, *testVel[3] = {test->vx, test->vy, test->vz};
+    QuantityErrors pos = CompareQuantity(refPos, testPos, ref->n);
+    QuantityErrors vel = CompareQuantity(refVel, testVel, ref->n);
 
-    for (int i = 0; i < nParticles; i++) {
-        in1 >> x1 >> y1 >> z1 >> vx1 >> vy1 >> vz1;
-        in2 >> x2 >> y2 >> z2 >> vx2 >> vy2 >> vz2;
+    cout << "\nCompared " << ref->n << " particles (3 components each)\n\n";
+    cout << left << setw(18) << "error" << right << setw(12) << "max" << setw(12) << "mean"
+         << setw(12) << "p50" << setw(12) << "p99" << setw(12) << "p99.9" << endl;
+    PrintErrorRow("position abs", pos.abs);
+    PrintErrorRow("position rel", pos.rel);
+    PrintErrorRow("position ulp", pos.ulp);
+    PrintErrorRow("velocity abs", vel.abs);
+    PrintErrorRow("velocity rel", vel.rel);
+    PrintErrorRow("velocity ulp", vel.ulp);
 
-        if (fabs(x1 - x2) > EPSILON || fabs(y1 - y2) > EPSILON || fabs(z1 - z2) > EPSILON) {
-            cout << "Mismatch at particle " << i << ": dx=" << fabs(x1 - x2)
-                 << " dy=" << fabs(y1 - y2) << " dz=" << fabs(z1 - z2) << endl;
-            return false;
-        }
+    if (withEnergy) {
+        ParticleSystem initial(ref->n);
+        GenerateChunk(initial, 0, initial.n);
+        Invariants inv0 = ComputeInvariants(initial);
+        Invariants inv1 = ComputeInvariants(*ref);
+        Invariants inv2 = ComputeInvariants(*test);
+        double energy0 = inv0.kinetic + inv0.potential;
+        cout << "\nConserved quantities (drift relative to the initial state):\n";
+        PrintInvariants("initial", inv0, energy0);
+        PrintInvariants("reference", inv1, energy0);
+        PrintInvariants("tested", inv2, energy0);
     }
+    cout << endl;
 
+    if (pos.abs.max > tolerance) {
+        cout << "Max position error " << pos.abs.max << " exceeds tolerance " << tolerance << endl;
+        return false;
+    }
     return true;
 }
 
+// Direct-sum forces of a chunk into refF*
+void DirectForceChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+        ComputeForceDirect(ps, i, &refFx[i], &refFy[i], &refFz[i]);
+}
+
+// Barnes-Hut forces of a chunk into testF*
+void BarnesHutForceChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+        ComputeForceBH(ps, i, &testFx[i], &testFy[i], &testFz[i]);
+}
+
+/**
+ * @brief Reports the error of testF* against refF*.
+ *
+ * Prints the max and mean per-particle relative error |dF| / |F| and the
+ * global RMS error sqrt(sum |dF|^2 / sum |F|^2).
+ */
+void ReportForceError()
+{
+    double maxRel = 0, sumRel = 0, sumErr2 = 0, sumRef2 = 0;
+    unsigned int counted = 0;
+    for (unsigned int i = 0; i < refFx.size(); i++) {
+        double ex = testFx[i] - refFx[i], ey = testFy[i] - refFy[i], ez = testFz[i] - refFz[i];
+        double err2 = ex * ex + ey * ey + ez * ez;
+        double ref2 = (double)refFx[i] * refFx[i] + (double)refFy[i] * refFy[i] + (double)refFz[i] * refFz[i];
+        sumErr2 += err2;
+        sumRef2 += ref2;
+        if (ref2 > 0) {
+            double rel = sqrt(err2 / ref2);
+            maxRel = fmax(maxRel, rel);
+            sumRel += rel;
+            counted++;
+        }
+    }
+    cout << "Max relative force error:  " << maxRel << endl;
+    cout << "Mean relative force error: " << (counted ? sumRel / counted : 0.0) << endl;
+    cout << "RMS force error:           " << (sumRef2 > 0 ? sqrt(sumErr2 / sumRef2) : 0.0) << endl;
+}
+
+/**
+ * @brief Compares Barnes-Hut forces against the direct-sum kernel on the initial particle state.
+ *
+ * @param theta Opening angle passed to the tree walk.
+ * @param nParticles Number of particles to initialize.
+ */
+void ValidateBarnesHut(float theta, unsigned int nParticles)
+{
+    cout << "\n---  Barnes-Hut force validation, theta = " << theta << ", N = " << nParticles << " ---\n";
+    ParticleSystem ps(nParticles);
+    GenerateChunk(ps, 0, ps.n);
+    WorkerPool();
+    for (vector<float> *f : {&refFx, &refFy, &refFz, &testFx, &testFy, &testFz})
+        f->assign(ps.n, 0.0f);
+
+    auto start = chrono::high_resolution_clock::now();
+    StartThreads(ps, DirectForceChunk);
+    auto end = chrono::high_resolution_clock::now();
+    cout << "Direct-sum force time: " << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms" << endl;
+
+    start = chrono::high_resolution_clock::now();
+    BuildOctree(ps, theta);
+    auto built = chrono::high_resolution_clock::now();
+    StartThreads(ps, BarnesHutForceChunk);
+    end = chrono::high_resolution_clock::now();
+    cout << "Barnes-Hut force time: " << chrono::duration_cast<chrono::milliseconds>(end - start).count() << " ms"
+         << " (build " << chrono::duration_cast<chrono::milliseconds>(built - start).count() << " ms, "
+         << bhTree.nodes.size() << " nodes)" << endl;
+
+    ReportForceError();
+}
+
+// FMM forces of a chunk into testF* (tree built by BuildFmm)
+void FmmForceChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+        ComputeForceFMM(ps, i, &testFx[i], &testFy[i], &testFz[i]);
+}
+
+/**
+ * @brief Compares FMM forces of orders 1 .. maxOrder against the direct-sum kernel on the initial particle state.
+ *
+ * Uses the initial condition in icConfig; main runs it on the uniform cube and the Plummer sphere
+ * unless --ic is given.
+ *
+ * @param maxOrder Highest expansion order of the sweep.
+ * @param nParticles Number of particles to initialize.
+ */
+void ValidateFMM(unsigned int maxOrder, unsigned int nParticles)
+{
+    cout << "\n---  FMM force validation, " << initialConditionNames[icConfig.kind] << ", orders 1.." << maxOrder
+         << ", N = " << nParticles << ", leaf size " << fmmConfig.leafSize << " ---\n";
+    ParticleSystem ps(nParticles);
+    GenerateChunk(ps, 0, ps.n);
+    WorkerPool();
+    for (vector<float> *f : {&refFx, &refFy, &refFz, &testFx, &testFy, &testFz})
+        f->assign(ps.n, 0.0f);
+
+    auto start = chrono::high_resolution_clock::now();
+    StartThreads(ps, DirectForceChunk);
+    auto end = chrono::high_resolution_clock::now();
+    double directMs = chrono::duration<double, milli>(end - start).count();
+    cout << "Direct-sum force time: " << directMs << " ms" << endl;
+
+    for (unsigned int order = 1; order <= maxOrder; ++order) {
+        fmmConfig.order = order;
+        start = chrono::high_resolution_clock::now();
+        BuildFmm(ps);
+        auto built = chrono::high_resolution_clock::now();
+        StartThreads(ps, FmmForceChunk);
+        end = chrono::high_resolution_clock::now();
+        double fmmMs = chrono::duration<double, milli>(end - start).count();
+        cout << "\nOrder " << order << ": " << fmmMs << " ms (speedup " << directMs / fmmMs << "x), tree + expansions "
+             << chrono::duration<double, milli>(built - start).count() << " ms, depth " << fmmTree.depth
+             << ", " << fmmTree.leafCount << " leaves (largest " << fmmTree.maxLeafCount << "), " << fmmTree.m2lCount
+             << " M2L, " << fmmTree.wCount << " M2P / P2L cell pairs" << endl;
+        ReportForceError();
+    }
+}
+
+// Fast-precision direct-sum forces of a chunk into testF*
+void FastForceChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+        forceBackends[activeBackend].fast[ACCUM_FLOAT](ps, i, &testFx[i], &testFy[i], &testFz[i]);
+}
+
+/**
+ * @brief Compares the rsqrt + Newton-Raphson force kernel against the exact (sqrt + div) one.
+ *
+ * Both run on the active SIMD backend. Reports both timings, the speedup and the
+ * force error of the fast kernel.
+ *
+ * @param nParticles Number of particles to initialize.
+ */
+void ValidatePrecision(unsigned int nParticles)
+{
+    cout << "\n---  Fast precision validation, N = " << nParticles
+         << ", " << forceBackends[activeBackend].name << " backend ---\n";
+    ParticleSystem ps(nParticles);
+    GenerateChunk(ps, 0, ps.n);
+    WorkerPool();
+    for (vector<float> *f : {&refFx, &refFy, &refFz, &testFx, &testFy, &testFz})
+        f->assign(ps.n, 0.0f);
+
+    auto start = chrono::high_resolution_clock::now();
+    StartThreads(ps, DirectForceChunk);
+    auto end = chrono::high_resolution_clock::now();
+    double exactMs = chrono::duration<double, milli>(end - start).count();
+
+    start = chrono::high_resolution_clock::now();
+    StartThreads(ps, FastForceChunk);
+    end = chrono::high_resolution_clock::now();
+    double fastMs = chrono::duration<double, milli>(end - start).count();
+
+    cout << "Exact force time: " << exactMs << " ms" << endl;
+    cout << "Fast force time:  " << fastMs << " ms (speedup " << exactMs / fastMs << "x)" << endl;
+    ReportForceError();
+}
+
+/**
+ * @brief Compares the symmetric pair kernel against the direct-sum kernel on the initial particle state.
+ *
+ * MoveSymmetric only updates velocities, so it runs from zero velocities and the force is read back as v / dt.
+ *
+ * @param nParticles Number of particles to initialize.
+ */
+void ValidateSymmetric(unsigned int nParticles)
+{
+    cout << "\n---  Symmetric pair kernel validation, N = " << nParticles
+         << ", " << forceBackends[activeBackend].name << " backend reference ---\n";
+    ParticleSystem ps(nParticles);
+    GenerateChunk(ps, 0, ps.n);
+    WorkerPool();
+    for (vector<float> *f : {&refFx, &refFy, &refFz, &testFx, &testFy, &testFz})
+        f->assign(ps.n, 0.0f);
+
+    auto start = chrono::high_resolution_clock::now();
+    StartThreads(ps, DirectForceChunk);
+    auto end = chrono::high_resolution_clock::now();
+    double directMs = chrono::duration<double, milli>(end - start).count();
+
+    for (unsigned int i = 0; i < ps.n; i++)
+        ps.vx[i] = ps.vy[i] = ps.vz[i] = 0.0f;
+    start = chrono::high_resolution_clock::now();
+    MoveSymmetric(ps);
+    end = chrono::high_resolution_clock::now();
+    double symmetricMs = chrono::duration<double, milli>(end - start).count();
+    for (unsigned int i = 0; i < ps.n; i++) {
+        testFx[i] = ps.vx[i] / dt;
+        testFy[i] = ps.vy[i] / dt;
+        testFz[i] = ps.vz[i] / dt;
+    }
+
+    cout << "Direct force time:    " << directMs << " ms" << endl;
+    cout << "Symmetric force time: " << symmetricMs << " ms (speedup " << directMs / symmetricMs << "x)" << endl;
+    ReportForceError();
+}
+
 /**
  * @brief Main entry point for result validation between serial and parallel runs.
  * 
- * Compares the particle position output files and reports success or failure.
+ * Compares the serial and parallel outputs (text or binary, see CompareResults) and reports
+ * success or failure. --ref / --test <file> replace the default serial_result.txt /
+ * parallel_result.txt, --tolerance <abs> the default EPSILON position margin, and --no-energy
+ * skips the O(N^2) energy computation.
+ * With --bh <theta>, instead reports the Barnes-Hut force error against the direct sum
+ * on --n <count> particles (default DEFAULT_PARTICLES).
+ * With --fmm <p>, reports the FMM force error and time against the direct sum of orders 1 .. p
+ * (--fmm-leaf <count> particles per leaf), on the uniform cube and the Plummer sphere unless --ic is given.
+ * With --precision, reports the speedup and force error of the fast rsqrt kernel instead.
+ * With --symmetric, does the same for the symmetric pair kernel.
+ * --backend <name> selects the SIMD backend used by both force modes.
+ * --ic <kind> / --seed <s> select the initial state of the force checks and of the energy reference
+ * (default lattice, as parallel.exe and serial.exe).
  * 
  * @return int Exit code (0 for success, 1 for mismatch or error).
  */
-int main() {
-    if (CompareResults("serial_result.txt", "parallel_result.txt")) {
+int main(int argc, char** argv) {
+    if (!ParseSimdBackend(GetFlag(argc, argv, "--backend", "auto"), &activeBackend)) {
+        cerr << "Error: --backend expects auto, sse, avx, avx2 or avx512 (supported by this CPU)" << endl;
+        return 1;
+    }
+
+    if (!ParseInitialCondition(GetFlag(argc, argv, "--ic", "lattice"), &icConfig.kind)) {
+        cerr << "Error: --ic expects lattice, plummer, uniform, cold or galaxies" << endl;
+        return 1;
+    }
+    icConfig.seed = stoull(GetFlag(argc, argv, "--seed", "1"));
+
+    if (HasFlag(argc, argv, "--bh")) {
+        ValidateBarnesHut(GetFlagFloat(argc, argv, "--bh", 0.5f),
+                          (unsigned int)GetFlagInt(argc, argv, "--n", DEFAULT_PARTICLES));
+        return 0;
+    }
+
+    if (HasFlag(argc, argv, "--fmm")) {
+        unsigned int maxOrder = 0;
+        if (!ParseFmmOrder(GetFlag(argc, argv, "--fmm", "4"), &maxOrder)) {
+            cerr << "Error: --fmm expects an expansion order from 1 to " << FMM_MAX_ORDER << endl;
+            return 1;
+        }
+        int leafSize = GetFlagInt(argc, argv, "--fmm-leaf", (int)fmmConfig.leafSize);
+        if (leafSize < 1) {
+            cerr << "Error: --fmm-leaf must be at least 1" << endl;
+            return 1;
+        }
+        fmmConfig.leafSize = (unsigned int)leafSize;
+        unsigned int nParticles = (unsigned int)GetFlagInt(argc, argv, "--n", DEFAULT_PARTICLES);
+        if (HasFlag(argc, argv, "--ic")) {
+            ValidateFMM(maxOrder, nParticles);
+            return 0;
+        }
+        // The lattice holds only 15 distinct positions, so the default sweep uses a uniform and a clustered state
+        for (InitialCondition kind : {IC_UNIFORM, IC_PLUMMER}) {
+            icConfig.kind = kind;
+            ValidateFMM(maxOrder, nParticles);
+        }
+        return 0;
+    }
+
+    if (HasFlag(argc, argv, "--precision")) {
+        ValidatePrecision((unsigned int)GetFlagInt(argc, argv, "--n", DEFAULT_PARTICLES));
+        return 0;
+    }
+
+    if (HasFlag(argc, argv, "--symmetric")) {
+        if (!SymmetricKernelSupported()) {
+            cerr << "Error: --symmetric needs AVX, not supported on this CPU" << endl;
+            return 1;
+        }
+        ValidateSymmetric((unsigned int)GetFlagInt(argc, argv, "--n", DEFAULT_PARTICLES));
+        return 0;
+    }
+
+    string refFile = GetFlag(argc, argv, "--ref", "serial_result.txt");
+    string testFile = GetFlag(argc, argv, "--test", "parallel_result.txt");
+    float tolerance = GetFlagFloat(argc, argv, "--tolerance", EPSILON);
+    if (CompareResults(refFile, testFile, tolerance, !HasFlag(argc, argv, "--no-energy"))) {
         cout << "Validation successful. Outputs match within epsilon." << endl;
         return 0;
     } else {
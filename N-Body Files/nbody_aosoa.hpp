@@ -0,0 +1,115 @@
+#ifndef NBODY_AOSOA_HPP
+#define NBODY_AOSOA_HPP
+
+#include "nbody_parallel.hpp"
+#include "nbody_layout.hpp"
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: the direct-sum step on AoSoA packets (AosoaParticles, nbody_layout.hpp). The force sum is the
+//            same templated kernel as MoveChunk on AosoaLayout, dispatched through forceBackends[] like
+//            ComputeForceDirect, so --backend, --precision and --accumulate apply unchanged. With 8-lane
+//            packets, the AVX kernels load one packet per iteration; SSE loads half a packet and AVX-512 two.
+
+//      Note: the j loop streams one array (192-byte packets) instead of three separate position arrays,
+//            and a packet's velocities sit in the lines right after its positions: fewer concurrent
+//            streams for the prefetcher and fewer pages per block of particles at large N.
+
+//      Note: threads get whole packets, so no two threads write the same cache line. The rest of the
+//            program keeps the SoA ParticleSystem: PackParticles() / UnpackParticles() convert at the
+//            boundaries (initial conditions, snapshots, trajectories, result files).
+
+// Signature of the chunked kernels on packets: (particles, first packet, one past last packet)
+typedef void (*PacketChunkFunction)(AosoaParticles &, unsigned int, unsigned int);
+
+// Direct-sum force of all packed particles at (xi, yi, zi), active backend, precision and accumulation mode
+inline void ComputeForcePacked(const AosoaParticles &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz)
+{
+    const ForceBackend &backend = forceBackends[activeBackend];
+    PacketForceFunction force = (forcePrecision == PRECISION_FAST) ? backend.fastPacked[forceAccumulation] : backend.exactPacked[forceAccumulation];
+    force(src, xi, yi, zi, Fx, Fy, Fz);
+}
+
+// Copies ps into the packets, each thread filling its own packets
+void PackParticles(const ParticleSystem &ps, AosoaParticles &packed, ThreadPool &pool = WorkerPool())
+{
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int first, last;
+        ChunkBounds(t, pool.Size(), packed.Packets(), &first, &last);
+        for (unsigned int i = first * PACKET_LANES; i < last * PACKET_LANES && i < ps.n; ++i)
+        {
+            OneParticle p;
+            ps.Get(i, &p);
+            packed.Set(i, p);
+        }
+    });
+}
+
+// Copies the packets back into ps
+void UnpackParticles(const AosoaParticles &packed, ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int first, last;
+        ChunkBounds(t, pool.Size(), packed.Packets(), &first, &last);
+        for (unsigned int i = first * PACKET_LANES; i < last * PACKET_LANES && i < ps.n; ++i)
+        {
+            OneParticle p;
+            packed.Get(i, &p);
+            ps.x[i] = p.x;
+            ps.y[i] = p.y;
+            ps.z[i] = p.z;
+            ps.vx[i] = p.vx;
+            ps.vy[i] = p.vy;
+            ps.vz[i] = p.vz;
+        }
+    });
+}
+
+// Forces on the particles of packets [first, last) and their velocity update (MoveChunk on packets)
+void MovePacketChunk(AosoaParticles &packed, unsigned int first, unsigned int last)
+{
+    for (unsigned int k = first; k < last; ++k)
+    {
+        ParticlePacket &packet = packed.Data()[k];
+        for (unsigned int l = 0; l < PACKET_LANES && k * PACKET_LANES + l < packed.n; ++l)
+        {
+            float Fx = 0, Fy = 0, Fz = 0;
+            ComputeForcePacked(packed, packet.x[l], packet.y[l], packet.z[l], &Fx, &Fy, &Fz);
+            packet.vx[l] += dt * Fx;
+            packet.vy[l] += dt * Fy;
+            packet.vz[l] += dt * Fz;
+        }
+    }
+}
+
+// Position update of packets [first, last). Padding lanes have zero velocity and stay zero.
+void UpdatePacketPositions(AosoaParticles &packed, unsigned int first, unsigned int last)
+{
+    for (unsigned int k = first; k < last; ++k)
+    {
+        ParticlePacket &packet = packed.Data()[k];
+        for (unsigned int l = 0; l < PACKET_LANES; ++l)
+        {
+            packet.x[l] += packet.vx[l] * dt;
+            packet.y[l] += packet.vy[l] * dt;
+            packet.z[l] += packet.vz[l] * dt;
+        }
+    }
+}
+
+// StartThreads on packets: one contiguous run of whole packets per pool thread
+void StartPacketThreads(AosoaParticles &packed, PacketChunkFunction func, ThreadPool &pool = WorkerPool())
+{
+    pool.Run([&packed, func, &pool](unsigned int t)
+    {
+        unsigned int first, last;
+        ChunkBounds(t, pool.Size(), packed.Packets(), &first, &last);
+        func(packed, first, last);
+    });
+}
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef NBODY_BARNESHUT_HPP
+#define NBODY_BARNESHUT_HPP
+
+#include "nbody_parallel.hpp"
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: Barnes-Hut replaces the O(N^2) direct sum with an O(N log N) tree walk.
+//            A cell of size s at distance d from the particle is treated as a single
+//            point mass at its center of mass when s / d <= theta (the opening angle).
+//            A cell whose particles all coincide gets s = 0, so it is always a single (exact) point mass.
+//            theta = 0 degenerates to the direct sum, 0.5 - 0.7 is the usual trade-off.
+
+//      Note: the tree is rebuilt serially every step from the particle positions, the walk is per particle
+//            and runs in parallel through StartThreads(MoveChunkBH).
+
+// Leaves hold up to BH_LEAF_SIZE particles. Cells of coincident particles (common with the lattice
+// initial conditions) are never split, and subdivision also stops at BH_MAX_DEPTH.
+const unsigned int BH_LEAF_SIZE = 16;
+const int BH_MAX_DEPTH = 24;
+
+struct OctreeNode
+{
+    float cx, cy, cz, half;  // geometric cell (center and half of the edge length)
+    float mx, my, mz;        // center of mass
+    float mass;              // number of particles below this node (all masses are 1)
+    float size;              // cell edge length, 0 if all its particles coincide
+    int firstChild;          // index of the first child in nodes[], -1 for leaves
+    int childCount;          // non-empty children are stored contiguously
+    unsigned int begin, end; // particle range in the sorted arrays
+};
+
+struct Octree
+{
+    vector<OctreeNode> nodes;
+    vector<unsigned int> index;   // sorted position -> particle index
+    vector<unsigned int> scratch; // partitioning buffer
+    vector<float> sx, sy, sz;     // positions in tree order, so leaves are read contiguously
+    float theta;
+};
+
+Octree bhTree;
+
+// Fills node's center of mass and opening size from its particle range
+void ComputeNodeMass(const ParticleSystem &ps, OctreeNode &node)
+{
+    double mx = 0, my = 0, mz = 0;
+    unsigned int first = bhTree.index[node.begin];
+    float minX = ps.x[first], maxX = minX;
+    float minY = ps.y[first], maxY = minY;
+    float minZ = ps.z[first], maxZ = minZ;
+    for (unsigned int k = node.begin; k < node.end; ++k)
+    {
+        unsigned int p = bhTree.index[k];
+        mx += ps.x[p];
+        my += ps.y[p];
+        mz += ps.z[p];
+        minX = fmin(minX, ps.x[p]); maxX = fmax(maxX, ps.x[p]);
+        minY = fmin(minY, ps.y[p]); maxY = fmax(maxY, ps.y[p]);
+        minZ = fmin(minZ, ps.z[p]); maxZ = fmax(maxZ, ps.z[p]);
+    }
+    bool coincident = (minX == maxX) && (minY == maxY) && (minZ == maxZ);
+    node.size = coincident ? 0.0f : 2.0f * node.half;
+    double count = node.end - node.begin;
+    node.mass = (float)count;
+    node.mx = (float)(mx / count);
+    node.my = (float)(my / count);
+    node.mz = (float)(mz / count);
+}
+
+// Recursively splits node nodeIdx into its non-empty octants
+void BuildNode(const ParticleSystem &ps, int nodeIdx, int depth)
+{
+    ComputeNodeMass(ps, bhTree.nodes[nodeIdx]);
+    OctreeNode node = bhTree.nodes[nodeIdx];
+    if (node.end - node.begin <= BH_LEAF_SIZE || depth >= BH_MAX_DEPTH || node.size == 0.0f)
+        return;
+
+    // Counting sort of the particle range by octant
+    unsigned int count[8] = {0}, offset[8];
+    for (unsigned int k = node.begin; k < node.end; ++k)
+    {
+        unsigned int p = bhTree.index[k];
+        int octant = (ps.x[p] >= node.cx) | ((ps.y[p] >= node.cy) << 1) | ((ps.z[p] >= node.cz) << 2);
+        count[octant]++;
+    }
+    offset[0] = node.begin;
+    for (int o = 1; o < 8; ++o)
+        offset[o] = offset[o - 1] + count[o - 1];
+
+    unsigned int cursor[8];
+    for (int o = 0; o < 8; ++o)
+        cursor[o] = offset[o];
+    for (unsigned int k = node.begin; k < node.end; ++k)
+    {
+        unsigned int p = bhTree.index[k];
+        int octant = (ps.x[p] >= node.cx) | ((ps.y[p] >= node.cy) << 1) | ((ps.z[p] >= node.cz) << 2);
+        bhTree.scratch[cursor[octant]++] = p;
+    }
+    for (unsigned int k = node.begin; k < node.end; ++k)
+        bhTree.index[k] = bhTree.scratch[k];
+
+    // Append all children first so they are contiguous, then recurse
+    int firstChild = (int)bhTree.nodes.size();
+    int childCount = 0;
+    float quarter = node.half * 0.5f;
+    for (int o = 0; o < 8; ++o)
+    {
+        if (count[o] == 0)
+            continue;
+        OctreeNode child;
+        child.cx = node.cx + ((o & 1) ? quarter : -quarter);
+        child.cy = node.cy + ((o & 2) ? quarter : -quarter);
+        child.cz = node.cz + ((o & 4) ? quarter : -quarter);
+        child.half = quarter;
+        child.firstChild = -1;
+        child.childCount = 0;
+        child.begin = offset[o];
+        child.end = offset[o] + count[o];
+        bhTree.nodes.push_back(child);
+        childCount++;
+    }
+    bhTree.nodes[nodeIdx].firstChild = firstChild;
+    bhTree.nodes[nodeIdx].childCount = childCount;
+
+    for (int c = 0; c < childCount; ++c)
+        BuildNode(ps, firstChild + c, depth + 1);
+}
+
+// Builds the octree over the current positions of ps
+void BuildOctree(const ParticleSystem &ps, float theta)
+{
+    bhTree.theta = theta;
+    bhTree.nodes.clear();
+    bhTree.index.resize(ps.n);
+    bhTree.scratch.resize(ps.n);
+
+    // Bounding cube of all particles
+    float minX = ps.x[0], maxX = ps.x[0];
+    float minY = ps.y[0], maxY = ps.y[0];
+    float minZ = ps.z[0], maxZ = ps.z[0];
+    for (unsigned int i = 0; i < ps.n; ++i)
+    {
+        bhTree.index[i] = i;
+        minX = fmin(minX, ps.x[i]); maxX = fmax(maxX, ps.x[i]);
+        minY = fmin(minY, ps.y[i]); maxY = fmax(maxY, ps.y[i]);
+        minZ = fmin(minZ, ps.z[i]); maxZ = fmax(maxZ, ps.z[i]);
+    }
+
+    OctreeNode root;
+    root.cx = 0.5f * (minX + maxX);
+    root.cy = 0.5f * (minY + maxY);
+    root.cz = 0.5f * (minZ + maxZ);
+    // Slightly enlarged so particles on the max face still fall inside
+    root.half = 0.5f * fmax(maxX - minX, fmax(maxY - minY, maxZ - minZ)) * 1.001f + 1e-6f;
+    root.firstChild = -1;
+    root.childCount = 0;
+    root.begin = 0;
+    root.end = ps.n;
+    bhTree.nodes.push_back(root);
+    BuildNode(ps, 0, 0);
+
+    // Copy positions into tree order for contiguous leaf reads
+    bhTree.sx.resize(ps.n);
+    bhTree.sy.resize(ps.n);
+    bhTree.sz.resize(ps.n);
+    for (unsigned int k = 0; k < ps.n; ++k)
+    {
+        unsigned int p = bhTree.index[k];
+        bhTree.sx[k] = ps.x[p];
+        bhTree.sy[k] = ps.y[p];
+        bhTree.sz[k] = ps.z[p];
+    }
+}
+
+// Barnes-Hut force on particle i, walking bhTree with an explicit stack
+void ComputeForceBH(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz)
+{
+    const float px = ps.x[i], py = ps.y[i], pz = ps.z[i];
+    const float theta2 = bhTree.theta * bhTree.theta;
+    float fx = 0, fy = 0, fz = 0;
+
+    int stack[8 * BH_MAX_DEPTH + 8];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const OctreeNode &node = bhTree.nodes[stack[--top]];
+
+        const float dx = node.mx - px;
+        const float dy = node.my - py;
+        const float dz = node.mz - pz;
+        const float d2 = dx * dx + dy * dy + dz * dz;
+
+        if (node.size * node.size <= theta2 * d2)
+        {
+            // Far enough: the whole cell acts as one point mass
+            const float dr = 1.0f / sqrtf(d2 + softening);
+            const float mdrPower3 = node.mass * dr * dr * dr;
+            fx += dx * mdrPower3;
+            fy += dy * mdrPower3;
+            fz += dz * mdrPower3;
+        }
+        else if (node.firstChild < 0)
+        {
+            // Near leaf: direct sum over its particles (self interaction contributes 0 as in MoveChunk)
+            for (unsigned int k = node.begin; k < node.end; ++k)
+            {
+                const float ex = bhTree.sx[k] - px;
+                const float ey = bhTree.sy[k] - py;
+                const float ez = bhTree.sz[k] - pz;
+                const float dr = 1.0f / sqrtf(ex * ex + ey * ey + ez * ez + softening);
+                const float drPower3 = dr * dr * dr;
+                fx += ex * drPower3;
+                fy += ey * drPower3;
+                fz += ez * drPower3;
+            }
+        }
+        else
+        {
+            for (int c = 0; c < node.childCount; ++c)
+                stack[top++] = node.firstChild + c;
+        }
+    }
+
+    *Fx = fx;
+    *Fy = fy;
+    *Fz = fz;
+}
+
+// Barnes-Hut counterpart of MoveChunk: tree forces, then velocity update. Needs BuildOctree() first.
+void MoveChunkBH(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+    {
+        float Fx = 0, Fy = 0, Fz = 0;
+        ComputeForceBH(ps, i, &Fx, &Fy, &Fz);
+
+        ps.vx[i] += dt * Fx;
+        ps.vy[i] += dt * Fy;
+        ps.vz[i] += dt * Fz;
+    }
+}
+
+#endif
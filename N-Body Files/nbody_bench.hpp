@@ -0,0 +1,198 @@
+#ifndef NBODY_BENCH_HPP
+#define NBODY_BENCH_HPP
+
+#include "nbody_parallel.hpp"
+#include "nbody_serial.hpp"
+#include "nbody_barneshut.hpp"
+#include "nbody_tiled.hpp"
+#include "nbody_symmetric.hpp"
+#include "nbody_fused.hpp"
+#include "nbody_cells.hpp"
+#include "nbody_fmm.hpp"
+#include "nbody_ic.hpp"
+#include <memory>
+#include <string>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: kernel registry of bench.exe. Every entry runs one full simulation step (force + position
+//            update) on its own particle storage, so layouts other than the SoA ParticleSystem (serial AoS)
+//            fit the same driver. A new kernel is benchmarked by adding a row to benchKernels[].
+
+//      Note: throughput is reported as direct-sum equivalent interactions, N^2 per step, for every kernel.
+//            Kernels that skip work (symmetric pairs, Barnes-Hut) therefore show their effective speedup,
+//            and GFLOP/s uses the customary 20 flops per interaction.
+
+const double FLOPS_PER_INTERACTION = 20.0;
+
+// Cutoff radius of the "cells" kernel, run at unit density (about 65 neighbours within rc)
+const float BENCH_CUTOFF = 2.5f;
+
+// Particle storage and threads of one benchmark configuration
+struct BenchState
+{
+    unsigned int n;
+    ThreadPool *pool;
+    unique_ptr<ParticleSystem> ps;     // SoA kernels
+    unique_ptr<SerialParticles> serial; // AoS serial reference
+};
+
+struct BenchKernel
+{
+    const char *name;
+    bool threaded;            // false: runs on one thread whatever the pool size
+    bool (*supported)();      // CPU check, evaluated before running
+    void (*init)(BenchState &); // allocates and initializes the particles (not timed)
+    void (*step)(BenchState &); // one simulation step (timed)
+};
+
+bool AlwaysSupported() { return true; }
+bool AvxSupported() { return BackendSupported(SIMD_AVX); }
+
+void InitSoA(BenchState &state)
+{
+    state.ps.reset(new ParticleSystem(state.n));
+    InitChunk(*state.ps, 0, state.n);
+}
+
+void InitSoAFused(BenchState &state)
+{
+    InitSoA(state);
+    PrepareFused(*state.ps, MoveChunk);
+}
+
+// Jittered cubic lattice at unit density (side N^(1/3)), so the cutoff kernel sees the same density at every N
+void InitSoAUnitDensity(BenchState &state)
+{
+    state.ps.reset(new ParticleSystem(state.n));
+    ParticleSystem &ps = *state.ps;
+    unsigned int side = (unsigned int)ceil(cbrt((double)state.n));
+    for (unsigned int i = 0; i < state.n; ++i)
+    {
+        unsigned int h = i * 2654435761u; // Knuth multiplicative hash, deterministic jitter in [0, 0.5)
+        ps.x[i] = (float)(i % side) + (float)(h & 0xff) / 512.0f;
+        ps.y[i] = (float)(i / side % side) + (float)((h >> 8) & 0xff) / 512.0f;
+        ps.z[i] = (float)(i / (side * side)) + (float)((h >> 16) & 0xff) / 512.0f;
+        ps.vx[i] = ps.vy[i] = ps.vz[i] = 0.0f;
+    }
+}
+
+// Plummer sphere (scale radius 0.5 N^(1/3)), the clustered input that drives the FMM tree to uneven depth
+void InitSoAPlummer(BenchState &state)
+{
+    state.ps.reset(new ParticleSystem(state.n));
+    icConfig.kind = IC_PLUMMER;
+    GenerateChunk(*state.ps, 0, state.n);
+}
+
+void InitAoS(BenchState &state)
+{
+    state.serial.reset(new SerialParticles(state.n));
+    InitParticleSerial(*state.serial);
+}
+
+void StepSerial(BenchState &state)
+{
+    MoveParticlesSerial(*state.serial);
+}
+
+void StepDirect(BenchState &state)
+{
+    forcePrecision = PRECISION_EXACT;
+    StartThreads(*state.ps, MoveChunk, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+}
+
+void StepDirectFast(BenchState &state)
+{
+    forcePrecision = PRECISION_FAST;
+    StartThreads(*state.ps, MoveChunk, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+    forcePrecision = PRECISION_EXACT;
+}
+
+void StepDirectKahan(BenchState &state)
+{
+    forceAccumulation = ACCUM_KAHAN;
+    StartThreads(*state.ps, MoveChunk, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+    forceAccumulation = ACCUM_FLOAT;
+}
+
+void StepDirectDouble(BenchState &state)
+{
+    forceAccumulation = ACCUM_DOUBLE;
+    StartThreads(*state.ps, MoveChunk, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+    forceAccumulation = ACCUM_FLOAT;
+}
+
+void StepDirectFused(BenchState &state)
+{
+    StartThreads(FusedCurrent(), MoveChunkFused, *state.pool);
+    SwapFusedBuffers();
+}
+
+void StepTiled(BenchState &state)
+{
+    StartThreads(*state.ps, MoveChunkTiled, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+}
+
+void StepSymmetric(BenchState &state)
+{
+    MoveSymmetric(*state.ps, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+}
+
+void StepCells(BenchState &state)
+{
+    BuildCellGrid(*state.ps, BENCH_CUTOFF);
+    StartThreads(*state.ps, MoveChunkCells, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+}
+
+void StepFmm(BenchState &state)
+{
+    BuildFmm(*state.ps, *state.pool);
+    StartThreads(*state.ps, MoveChunkFMM, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+}
+
+void StepBarnesHut(BenchState &state)
+{
+    BuildOctree(*state.ps, 0.5f);
+    StartThreads(*state.ps, MoveChunkBH, *state.pool);
+    StartThreads(*state.ps, UpdateChunkPosition, *state.pool);
+}
+
+// Registered kernels, selected by name with --kernels
+const BenchKernel benchKernels[] = {
+    {"serial", false, AlwaysSupported, InitAoS, StepSerial},         // AoS reference, scalar
+    {"direct", true, AlwaysSupported, InitSoA, StepDirect},          // MoveChunk, active SIMD backend
+    {"direct-fast", true, AlwaysSupported, InitSoA, StepDirectFast}, // MoveChunk, rsqrt + Newton-Raphson
+    {"direct-kahan", true, AlwaysSupported, InitSoA, StepDirectKahan},   // MoveChunk, compensated float sums
+    {"direct-double", true, AlwaysSupported, InitSoA, StepDirectDouble}, // MoveChunk, double sums
+    {"direct-fused", true, AlwaysSupported, InitSoAFused, StepDirectFused}, // MoveChunk + position update, one phase
+    {"tiled", true, AvxSupported, InitSoA, StepTiled},               // cache-blocked AVX, tileConfig
+    {"symmetric", true, AvxSupported, InitSoA, StepSymmetric},       // Newton's third law pairs
+    {"barnes-hut", true, AlwaysSupported, InitSoA, StepBarnesHut},   // octree, theta = 0.5
+    {"cells", true, AlwaysSupported, InitSoAUnitDensity, StepCells}, // cutoff cell list, BENCH_CUTOFF, unit density
+    {"fmm", true, AlwaysSupported, InitSoAUnitDensity, StepFmm},     // FMM, fmmConfig (order 4), unit density
+    {"fmm-plummer", true, AlwaysSupported, InitSoAPlummer, StepFmm}, // FMM, fmmConfig (order 4), Plummer sphere
+};
+
+// Registry lookup, nullptr if no kernel has this name
+const BenchKernel *FindBenchKernel(const string &name)
+{
+    for (const BenchKernel &kernel : benchKernels)
+    {
+        if (name == kernel.name)
+            return &kernel;
+    }
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef NBODY_CELLS_HPP
+#define NBODY_CELLS_HPP
+
+#include "nbody_parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: cutoff mode for short-range workloads. Space is cut into a uniform grid of cubic cells of edge
+//            >= rc, and particle i only interacts with the particles of the 27 cells around its own, so at
+//            fixed density the cost per particle is constant and a step is O(N) instead of O(N^2).
+//            Every pair closer than rc is included. Pairs between rc and 2 * sqrt(3) * rc are included or
+//            not depending on where the grid falls, so only use it where the force beyond rc is negligible.
+
+//      Note: the grid is rebuilt serially every step (bounding box, counting sort by cell). Positions are
+//            copied in cell order into a ParticleSystem whose cells each start on a PARTICLE_PADDING boundary,
+//            with x-neighbouring cells adjacent. The 3 cells of one neighbour row are thus one aligned,
+//            contiguous range, and the force is 9 calls to the same SIMD kernel as MoveChunk (ComputeForceAt).
+
+//      Note: padding slots hold CELL_SENTINEL positions. Their distance d ~ 1e18 makes 1 / d^3 underflow to
+//            exactly 0 in float, so they add nothing to the force whatever the lane layout.
+
+const float CELL_SENTINEL = 1e18f;
+
+// Cells per axis are capped so the grid stays small when rc is tiny compared to the system size
+const unsigned int CELL_MAX_PER_AXIS = 256;
+
+struct CellGrid
+{
+    float cutoff;
+    float originX, originY, originZ; // lower corner of the bounding box
+    float cellSize;                  // edge length, >= cutoff
+    unsigned int dimX, dimY, dimZ;   // cells per axis
+    vector<unsigned int> cellStart;  // first slot of each cell in sorted (x fastest), size cells + 1
+    vector<unsigned int> cellCount;  // particles in each cell
+    vector<unsigned int> cellOf;     // cell of every particle
+    unique_ptr<ParticleSystem> sorted; // positions in cell order, sentinel-padded
+};
+
+CellGrid cellGrid;
+
+// Parses a positive cutoff radius
+bool ParseCutoff(const string &text, float *cutoff)
+{
+    char *end;
+    float value = strtof(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0' || !(value > 0))
+        return false;
+    *cutoff = value;
+    return true;
+}
+
+inline unsigned int CellCoordinate(float p, float origin, float cellSize, unsigned int dim)
+{
+    int c = (int)((p - origin) / cellSize);
+    return (unsigned int)min(max(c, 0), (int)dim - 1);
+}
+
+// Rebuilds the grid for the current positions of ps
+void BuildCellGrid(const ParticleSystem &ps, float cutoff)
+{
+    CellGrid &grid = cellGrid;
+    grid.cutoff = cutoff;
+
+    float minX = ps.x[0], maxX = minX, minY = ps.y[0], maxY = minY, minZ = ps.z[0], maxZ = minZ;
+    for (unsigned int i = 1; i < ps.n; ++i)
+    {
+        minX = min(minX, ps.x[i]);
+        maxX = max(maxX, ps.x[i]);
+        minY = min(minY, ps.y[i]);
+        maxY = max(maxY, ps.y[i]);
+        minZ = min(minZ, ps.z[i]);
+        maxZ = max(maxZ, ps.z[i]);
+    }
+    float extent = max(maxX - minX, max(maxY - minY, maxZ - minZ));
+    grid.cellSize = max(cutoff, extent / (float)CELL_MAX_PER_AXIS);
+    grid.originX = minX;
+    grid.originY = minY;
+    grid.originZ = minZ;
+    grid.dimX = (unsigned int)((maxX - minX) / grid.cellSize) + 1;
+    grid.dimY = (unsigned int)((maxY - minY) / grid.cellSize) + 1;
+    grid.dimZ = (unsigned int)((maxZ - minZ) / grid.cellSize) + 1;
+    grid.dimX = min(grid.dimX, CELL_MAX_PER_AXIS);
+    grid.dimY = min(grid.dimY, CELL_MAX_PER_AXIS);
+    grid.dimZ = min(grid.dimZ, CELL_MAX_PER_AXIS);
+    const unsigned int cells = grid.dimX * grid.dimY * grid.dimZ;
+
+    // Counting sort by cell, every cell padded to a multiple of PARTICLE_PADDING slots
+    grid.cellCount.assign(cells, 0);
+    grid.cellOf.resize(ps.n);
+    for (unsigned int i = 0; i < ps.n; ++i)
+    {
+        unsigned int cx = CellCoordinate(ps.x[i], grid.originX, grid.cellSize, grid.dimX);
+        unsigned int cy = CellCoordinate(ps.y[i], grid.originY, grid.cellSize, grid.dimY);
+        unsigned int cz = CellCoordinate(ps.z[i], grid.originZ, grid.cellSize, grid.dimZ);
+        grid.cellOf[i] = (cz * grid.dimY + cy) * grid.dimX + cx;
+        grid.cellCount[grid.cellOf[i]]++;
+    }
+    grid.cellStart.resize(cells + 1);
+    grid.cellStart[0] = 0;
+    for (unsigned int c = 0; c < cells; ++c)
+        grid.cellStart[c + 1] = grid.cellStart[c] + PaddedCount(grid.cellCount[c]);
+
+    const unsigned int slots = grid.cellStart[cells];
+    if (!grid.sorted || grid.sorted->n < slots)
+        grid.sorted.reset(new ParticleSystem(slots + slots / 8)); // headroom for the next rebuilds
+    ParticleSystem &sorted = *grid.sorted;
+    fill(sorted.x, sorted.x + sorted.n, CELL_SENTINEL);
+    fill(sorted.y, sorted.y + sorted.n, CELL_SENTINEL);
+    fill(sorted.z, sorted.z + sorted.n, CELL_SENTINEL);
+    vector<unsigned int> next(grid.cellStart.begin(), grid.cellStart.end() - 1);
+    for (unsigned int i = 0; i < ps.n; ++i)
+    {
+        unsigned int slot = next[grid.cellOf[i]]++;
+        sorted.x[slot] = ps.x[i];
+        sorted.y[slot] = ps.y[i];
+        sorted.z[slot] = ps.z[i];
+    }
+}
+
+// Force on particle i from the 27 cells around its own: 9 contiguous rows of up to 3 cells
+void ComputeForceCells(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz)
+{
+    const CellGrid &grid = cellGrid;
+    const unsigned int cell = grid.cellOf[i];
+    const int cx = (int)(cell % grid.dimX);
+    const int cy = (int)(cell / grid.dimX % grid.dimY);
+    const int cz = (int)(cell / (grid.dimX * grid.dimY));
+    const unsigned int firstX = (unsigned int)max(cx - 1, 0);
+    const unsigned int lastX = (unsigned int)min(cx + 1, (int)grid.dimX - 1);
+
+    *Fx = *Fy = *Fz = 0;
+    for (int z = max(cz - 1, 0); z <= min(cz + 1, (int)grid.dimZ - 1); ++z)
+    {
+        for (int y = max(cy - 1, 0); y <= min(cy + 1, (int)grid.dimY - 1); ++y)
+        {
+            unsigned int row = ((unsigned int)z * grid.dimY + (unsigned int)y) * grid.dimX;
+            unsigned int begin = grid.cellStart[row + firstX];
+            unsigned int end = grid.cellStart[row + lastX + 1];
+            if (begin == end)
+                continue;
+            ParticleSystem range(*grid.sorted, begin, end - begin);
+            float fx = 0, fy = 0, fz = 0;
+            ComputeForceAt(range, ps.x[i], ps.y[i], ps.z[i], &fx, &fy, &fz);
+            *Fx += fx;
+            *Fy += fy;
+            *Fz += fz;
+        }
+    }
+}
+
+// Calculates cutoff forces on particles [start, end) and updates their velocities (grid built by BuildCellGrid)
+void MoveChunkCells(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+    {
+        float Fx, Fy, Fz;
+        ComputeForceCells(ps, i, &Fx, &Fy, &Fz);
+        ps.vx[i] += dt * Fx;
+        ps.vy[i] += dt * Fy;
+        ps.vz[i] += dt * Fz;
+    }
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef NBODY_CLI_HPP
+#define NBODY_CLI_HPP
+
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+// Minimal "--flag value" parsing shared by the executables.
+// The first positional argument (step count) is still read directly from argv[1].
+
+// Returns true if the flag appears anywhere on the command line
+bool HasFlag(int argc, char **argv, const char *flag)
+{
+    for (int a = 1; a < argc; ++a)
+    {
+        if (strcmp(argv[a], flag) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Returns the argument following the flag, or fallback if the flag (or its value) is missing
+string GetFlag(int argc, char **argv, const char *flag, const string &fallback)
+{
+    for (int a = 1; a + 1 < argc; ++a)
+    {
+        if (strcmp(argv[a], flag) == 0)
+            return argv[a + 1];
+    }
+    return fallback;
+}
+
+float GetFlagFloat(int argc, char **argv, const char *flag, float fallback)
+{
+    string value = GetFlag(argc, argv, flag, "");
+    return value.empty() ? fallback : stof(value);
+}
+
+int GetFlagInt(int argc, char **argv, const char *flag, int fallback)
+{
+    string value = GetFlag(argc, argv, flag, "");
+    return value.empty() ? fallback : stoi(value);
+}
+
+// Splits the comma-separated value of a flag ("--n 1024,4096"), or returns fallback if the flag is missing
+vector<string> GetFlagList(int argc, char **argv, const char *flag, const string &fallback)
+{
+    string value = GetFlag(argc, argv, flag, fallback);
+    vector<string> items;
+    size_t start = 0;
+    while (start <= value.size())
+    {
+        size_t comma = value.find(',', start);
+        if (comma == string::npos)
+            comma = value.size();
+        if (comma > start)
+            items.push_back(value.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+// Integer version of GetFlagList
+vector<int> GetFlagIntList(int argc, char **argv, const char *flag, const string &fallback)
+{
+    vector<int> values;
+    for (const string &item : GetFlagList(argc, argv, flag, fallback))
+        values.push_back(stoi(item));
+    return values;
+}
+
+#endif
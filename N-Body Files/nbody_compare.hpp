@@ -0,0 +1,338 @@
+#ifndef NBODY_COMPARE_HPP
+#define NBODY_COMPARE_HPP
+
+#include "nbody_parallel.hpp"
+#include "nbody_snapshot.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: result files are read in parallel on the worker pool. Binary snapshots (.nbs, detected
+//            by their magic) are mapped directly. Text files are read with one pread() per thread into
+//            one buffer. Each thread then counts the lines of its byte range (starting after the first
+//            newline), and after a prefix sum parses them straight into the right ParticleSystem slots.
+
+//      Note: errors are reported per quantity (positions, velocities): max / mean / percentiles of the
+//            absolute, relative (|a - b| / |a|) and ULP error of every component. The ULP error counts
+//            the representable floats between a and b (0 = bit-identical, 1 = last-bit difference).
+
+//      Note: energy is E = sum(v^2) / 2 - sum over i < j of 1 / sqrt(r^2 + softening) (unit masses,
+//            G = 1, same units as the kernels). Exactly coincident pairs are skipped: they exert no
+//            force (dx = 0), and their 1 / sqrt(softening) = 1e10 term would swamp the sum on the lattice.
+
+// ===== Parallel loading =====
+
+// Reads [offset, offset + bytes) of fd into dst, retrying partial reads. Returns false on error.
+bool ReadFully(int fd, char *dst, size_t bytes, size_t offset)
+{
+    while (bytes > 0)
+    {
+        ssize_t got = pread(fd, dst, bytes, (off_t)offset);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        dst += got;
+        offset += (size_t)got;
+        bytes -= (size_t)got;
+    }
+    return true;
+}
+
+// First byte of the line that contains or follows `pos` (text chunk boundaries)
+size_t NextLineStart(const vector<char> &text, size_t pos, size_t size)
+{
+    if (pos == 0)
+        return 0;
+    while (pos < size && text[pos - 1] != '\n')
+        ++pos;
+    return pos;
+}
+
+// Parses up to 6 floats of the line at p, returns the number parsed and moves p past the line
+int ParseParticleLine(const char *&p, float *values)
+{
+    int count = 0;
+    while (count < 6)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+            ++p;
+        if (*p == '\n' || *p == '\0')
+            break;
+        char *next;
+        values[count] = strtof(p, &next);
+        if (next == p)
+            break;
+        p = next;
+        ++count;
+    }
+    while (*p != '\n' && *p != '\0')
+        ++p;
+    if (*p == '\n')
+        ++p;
+    return count;
+}
+
+/**
+ * @brief Loads a "x y z vx vy vz" text result file (SaveParticlesToFile) with the worker pool.
+ *
+ * @return nullptr (with *error set) on I/O or parse errors.
+ */
+unique_ptr<ParticleSystem> LoadTextResults(const string &path, string *error, ThreadPool &pool = WorkerPool())
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        *error = "cannot open " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    const size_t size = (size_t)info.st_size;
+    vector<char> text(size + 1, '\0'); // NUL-terminated for strtof
+
+    // Parallel read: every thread reads its own byte range
+    const unsigned int nThreads = pool.Size();
+    vector<char> readOk(nThreads, 1);
+    pool.Run([&](unsigned int t)
+    {
+        size_t chunk = size / nThreads;
+        size_t start = t * chunk;
+        size_t end = (t == nThreads - 1) ? size : start + chunk;
+        readOk[t] = ReadFully(fd, text.data() + start, end - start, start);
+    });
+    close(fd);
+    if (find(readOk.begin(), readOk.end(), 0) != readOk.end())
+    {
+        *error = "cannot read " + path;
+        return nullptr;
+    }
+
+    // Line-aligned byte ranges and their line counts
+    vector<size_t> begin(nThreads + 1);
+    for (unsigned int t = 0; t < nThreads; ++t)
+        begin[t] = NextLineStart(text, t * (size / nThreads), size);
+    begin[nThreads] = size;
+    vector<unsigned int> lines(nThreads + 1, 0);
+    pool.Run([&](unsigned int t)
+    {
+        for (size_t c = begin[t]; c < begin[t + 1]; ++c)
+            lines[t + 1] += (text[c] == '\n');
+        // Last line without a trailing newline
+        if (begin[t + 1] > begin[t] && text[begin[t + 1] - 1] != '\n')
+            lines[t + 1]++;
+    });
+    for (unsigned int t = 0; t < nThreads; ++t)
+        lines[t + 1] += lines[t];
+
+    unique_ptr<ParticleSystem> ps(new ParticleSystem(lines[nThreads]));
+    vector<unsigned int> badLine(nThreads, UINT32_MAX);
+    pool.Run([&](unsigned int t)
+    {
+        const char *p = text.data() + begin[t];
+        for (unsigned int i = lines[t]; i < lines[t + 1]; ++i)
+        {
+            float v[6];
+            if (ParseParticleLine(p, v) != 6)
+            {
+                badLine[t] = i;
+                return;
+            }
+            ps->x[i] = v[0];
+            ps->y[i] = v[1];
+            ps->z[i] = v[2];
+            ps->vx[i] = v[3];
+            ps->vy[i] = v[4];
+            ps->vz[i] = v[5];
+        }
+    });
+    for (unsigned int t = 0; t < nThreads; ++t)
+    {
+        if (badLine[t] != UINT32_MAX)
+        {
+            *error = path + ": line " + to_string(badLine[t] + 1) + " does not hold 6 numbers";
+            return nullptr;
+        }
+    }
+    return ps;
+}
+
+// True if the file starts with the binary snapshot magic
+bool IsSnapshotFile(const string &path)
+{
+    char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = ReadFully(fd, magic, sizeof(magic), 0);
+    close(fd);
+    return ok && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
+
+// Loads a binary snapshot or a text result file, whichever path holds
+unique_ptr<ParticleSystem> LoadResults(const string &path, string *error)
+{
+    if (IsSnapshotFile(path))
+    {
+        SnapshotHeader header;
+        return MapSnapshot(path, &header, error);
+    }
+    return LoadTextResults(path, error);
+}
+
+// ===== Error statistics =====
+
+// Distance in representable floats between a and b
+inline uint32_t UlpDistance(float a, float b)
+{
+    int32_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    // Map the sign-magnitude encoding onto a monotonic integer line
+    int64_t la = (ia < 0) ? (int64_t)INT32_MIN - ia : ia;
+    int64_t lb = (ib < 0) ? (int64_t)INT32_MIN - ib : ib;
+    int64_t d = la - lb;
+    d = (d < 0) ? -d : d;
+    return (d > UINT32_MAX) ? UINT32_MAX : (uint32_t)d;
+}
+
+// Summary of one error measure over all compared values
+struct ErrorSummary
+{
+    double max, mean, p50, p99, p999;
+};
+
+// Summarizes `values` (reordered in place)
+ErrorSummary Summarize(vector<double> &values)
+{
+    ErrorSummary s = {0, 0, 0, 0, 0};
+    if (values.empty())
+        return s;
+    double sum = 0;
+    for (double v : values)
+        sum += v;
+    s.mean = sum / values.size();
+    auto percentile = [&values](double q)
+    {
+        size_t k = (size_t)(q * (values.size() - 1));
+        nth_element(values.begin(), values.begin() + k, values.end());
+        return values[k];
+    };
+    s.p50 = percentile(0.5);
+    s.p99 = percentile(0.99);
+    s.p999 = percentile(0.999);
+    s.max = *max_element(values.begin(), values.end());
+    return s;
+}
+
+// Absolute, relative and ULP errors of the three components of one quantity (positions or velocities)
+struct QuantityErrors
+{
+    ErrorSummary abs, rel, ulp;
+};
+
+/**
+ * @brief Compares components of ref and test (3 arrays each) over n particles in parallel.
+ *
+ * Every component of every particle contributes one sample to each summary.
+ */
+QuantityErrors CompareQuantity(const float *const ref[3], const float *const test[3], unsigned int n,
+                               ThreadPool &pool = WorkerPool())
+{
+    vector<double> absErr(3 * (size_t)n), relErr(3 * (size_t)n), ulpErr(3 * (size_t)n);
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), n, &start, &end);
+        for (int c = 0; c < 3; ++c)
+        {
+            for (unsigned int i = start; i < end; ++i)
+            {
+                size_t k = (size_t)c * n + i;
+                double a = ref[c][i], b = test[c][i];
+                absErr[k] = fabs(a - b);
+                relErr[k] = (a != 0) ? absErr[k] / fabs(a) : (b != 0 ? 1.0 : 0.0);
+                ulpErr[k] = UlpDistance(ref[c][i], test[c][i]);
+            }
+        }
+    });
+    QuantityErrors errors;
+    errors.abs = Summarize(absErr);
+    errors.rel = Summarize(relErr);
+    errors.ulp = Summarize(ulpErr);
+    return errors;
+}
+
+// ===== Conserved quantities =====
+
+struct Invariants
+{
+    double kinetic, potential;
+    double px, py, pz; // total momentum (unit masses)
+};
+
+#pragma GCC push_options
+#pragma GCC optimize("O2")
+
+// Potential energy of pairs (i, j > i) for i in [start, end), accumulated in double
+double PotentialRows(const ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    double potential = 0;
+    for (unsigned int i = start; i < end; ++i)
+    {
+        const double xi = ps.x[i], yi = ps.y[i], zi = ps.z[i];
+        for (unsigned int j = i + 1; j < ps.n; ++j)
+        {
+            double dx = ps.x[j] - xi, dy = ps.y[j] - yi, dz = ps.z[j] - zi;
+            double r2 = dx * dx + dy * dy + dz * dz;
+            if (r2 > 0)
+                potential -= 1.0 / sqrt(r2 + softening);
+        }
+    }
+    return potential;
+}
+
+#pragma GCC pop_options
+
+// Kinetic + potential energy and momentum of ps. Rows are dealt round-robin for balance (row i has n - i - 1 pairs).
+Invariants ComputeInvariants(const ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    const unsigned int nThreads = pool.Size();
+    vector<Invariants> partial(nThreads, Invariants{0, 0, 0, 0, 0});
+    const unsigned int ROWS = 64;
+    pool.Run([&](unsigned int t)
+    {
+        Invariants &sum = partial[t];
+        for (unsigned int start = t * ROWS; start < ps.n; start += nThreads * ROWS)
+            sum.potential += PotentialRows(ps, start, min(start + ROWS, ps.n));
+        unsigned int start, end;
+        ChunkBounds(t, nThreads, ps.n, &start, &end);
+        for (unsigned int i = start; i < end; ++i)
+        {
+            sum.kinetic += 0.5 * ((double)ps.vx[i] * ps.vx[i] + (double)ps.vy[i] * ps.vy[i] + (double)ps.vz[i] * ps.vz[i]);
+            sum.px += ps.vx[i];
+            sum.py += ps.vy[i];
+            sum.pz += ps.vz[i];
+        }
+    });
+    Invariants total = {0, 0, 0, 0, 0};
+    for (const Invariants &p : partial)
+    {
+        total.kinetic += p.kinetic;
+        total.potential += p.potential;
+        total.px += p.px;
+        total.py += p.py;
+        total.pz += p.pz;
+    }
+    return total;
+}
+
+#endif
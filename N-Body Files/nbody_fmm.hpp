@@ -0,0 +1,755 @@
+#ifndef NBODY_FMM_HPP
+#define NBODY_FMM_HPP
+
+#include "nbody_parallel.hpp"
+#include "nbody_cells.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: Fast Multipole Method on an adaptive octree: a cell holding more than fmmConfig.leafSize
+//            particles is split into its non-empty octants, so dense regions (the core of a Plummer sphere,
+//            colliding galaxies) get deep leaves and sparse ones stay shallow. A uniform grid sized from the
+//            mean occupancy would put most of a clustered system into a few leaves, and P2P would turn back
+//            into O(N^2). With colleagues = the same-level cells touching a cell, every cell B has the lists
+//            of Greengard's adaptive FMM:
+//              U  (leaves) the leaves touching B, B included                  -> P2P, same SIMD kernel as --cutoff
+//              V  children of the parent's colleagues that do not touch B     -> M2L
+//              W  (leaves) descendants of B's colleagues that do not touch B
+//                 while their parent does                                     -> M2P at B's particles
+//              X  the dual of W: the leaves C with B in W(C)                  -> P2L into B's local expansion
+//            Every step: P2M at the leaves, M2M up the tree, then top-down L2L + M2L (V) + P2L (X), and per
+//            particle L2P from its leaf plus M2P (W) and P2P (U). Every pair is counted exactly once (near or
+//            far), and the cost is O(N) for a given order whatever the distribution.
+
+//      Note: expansions are Cartesian Taylor series of 1/r of total order p (fmmConfig.order): multipole
+//            moments M_a = sum (x_j - c)^a / a!, local coefficients L_b = d^b Phi(z), and M2L keeps the
+//            terms |a| + |b| <= p. The force error falls roughly as (separation ratio)^p. Derivatives of 1/r
+//            come from the Hermite recurrence R^n_{a+1} = x R^{n+1}_a + a R^{n+1}_{a-1}; as the offsets
+//            between interacting cells take only 7^3 values per level, they are tabulated once per level.
+
+//      Note: positions stay float, expansions are double. Softening is ignored in the far field (well
+//            separated pairs only). The tree is built serially (bounding box, breadth-first counting sort by
+//            octant), and so is the step that mirrors lists into other cells (coarse leaves of U, X). Every
+//            other pass over cells and particles runs on the worker pool; a cell only writes its own lists
+//            and coefficients, so no pass needs atomics or per-thread buffers.
+
+const unsigned int FMM_MAX_ORDER = 8;
+const unsigned int FMM_MAX_TERMS = (FMM_MAX_ORDER + 1) * (FMM_MAX_ORDER + 2) * (FMM_MAX_ORDER + 3) / 6;
+const unsigned int FMM_MAX_LEVEL = 20; // deepest split, cells of size / 2^20 (coincident particles stop earlier)
+
+struct FmmConfig
+{
+    unsigned int order = 4;
+    unsigned int leafSize = 128; // cells with more particles are split
+};
+
+FmmConfig fmmConfig;
+
+// One multi-index (a, b, c), in order of total degree
+struct MultiIndex
+{
+    unsigned int a, b, c, degree;
+    unsigned int axis;    // first non-zero axis (0 x, 1 y, 2 z)
+    unsigned int count;   // exponent along that axis
+    unsigned int parent;  // index minus one along that axis
+    unsigned int parent2; // index minus two along that axis (valid if count >= 2)
+};
+
+// out += weight * in * other
+struct FmmPair
+{
+    unsigned int out, in, other;
+    double weight;
+};
+
+struct FmmTables
+{
+    unsigned int order = 0;
+    unsigned int terms = 0;
+    vector<MultiIndex> indices;
+    vector<FmmPair> m2m;    // out: parent moment, in: child moment, other: shift monomial
+    vector<FmmPair> m2l;    // out: local, in: moment, other: derivative, weight (-1)^|a|
+    vector<FmmPair> l2l;    // out: child local, in: parent local, other: shift monomial
+    vector<FmmPair> l2p[3]; // per axis, out: unused, in: local, other: monomial
+    vector<FmmPair> m2p[3]; // per axis, out: unused, in: moment, other: derivative, weight (-1)^|a|
+};
+
+FmmTables fmmTables;
+
+// One cell of the adaptive octree. The children of a node are contiguous in fmmTree.nodes, and so are the
+// nodes of one level (breadth-first build).
+struct FmmNode
+{
+    unsigned int level;
+    unsigned int ix, iy, iz;   // cell coordinates at its level
+    unsigned int parent;       // the root is its own parent
+    unsigned int firstChild;   // first non-empty child, valid if childCount > 0
+    unsigned int childCount;   // 0 for leaves
+    unsigned int first, last;  // particle range in fmmTree.index
+    unsigned int slot;         // leaves: first slot of their particles in fmmTree.sorted (PARTICLE_PADDING aligned)
+};
+
+struct FmmTree
+{
+    float originX, originY, originZ, size;               // root cube
+    vector<FmmNode> nodes;
+    vector<unsigned int> levelStart;                     // nodes of level l: [levelStart[l], levelStart[l + 1])
+    unsigned int depth = 0;                              // deepest level
+    unsigned int leafCount = 0, maxLeafCount = 0;        // leaves, most particles in one leaf
+    vector<unsigned int> index, scratch;                 // tree order -> particle index, partitioning buffer
+    vector<unsigned int> leafOf;                         // leaf of every particle
+    unique_ptr<ParticleSystem> sorted;                   // leaf positions, padded with CELL_SENTINEL
+    vector<vector<unsigned int>> colleagues, u, v, w, x; // per node, see the note above
+    vector<vector<unsigned int>> near;                   // leaves: U as [begin, end) slot ranges, neighbours merged
+    vector<double> multipole, local;                     // nodes x terms
+    vector<double> offsets[FMM_MAX_LEVEL + 1];           // derivatives of 1/r for the 7^3 cell offsets of a level
+    unsigned int m2lCount = 0, wCount = 0;               // V entries and W (= X) entries of the last build
+    double buildMs = 0, upwardMs = 0, downwardMs = 0;    // cumulated over builds
+};
+
+FmmTree fmmTree;
+
+// Parses an expansion order in 1 .. FMM_MAX_ORDER
+bool ParseFmmOrder(const string &text, unsigned int *order)
+{
+    char *end;
+    long value = strtol(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || value < 1 || value > (long)FMM_MAX_ORDER)
+        return false;
+    *order = (unsigned int)value;
+    return true;
+}
+
+// Position of the multi-index (a, b, c) in fmmTables.indices
+unsigned int FmmIndex(unsigned int a, unsigned int b, unsigned int c)
+{
+    for (unsigned int t = 0; t < fmmTables.terms; ++t)
+    {
+        const MultiIndex &m = fmmTables.indices[t];
+        if (m.a == a && m.b == b && m.c == c)
+            return t;
+    }
+    return 0;
+}
+
+// Builds the multi-index list and the translation tables of order p
+void PrepareFmmTables(unsigned int p)
+{
+    FmmTables &tables = fmmTables;
+    if (tables.order == p)
+        return;
+    tables.order = p;
+    tables.indices.clear();
+    for (unsigned int degree = 0; degree <= p; ++degree)
+    {
+        for (unsigned int a = degree + 1; a-- > 0;)
+        {
+            for (unsigned int b = degree - a + 1; b-- > 0;)
+            {
+                MultiIndex m;
+                m.a = a;
+                m.b = b;
+                m.c = degree - a - b;
+                m.degree = degree;
+                m.axis = (a > 0) ? 0 : ((b > 0) ? 1 : 2);
+                m.count = (a > 0) ? a : ((b > 0) ? b : m.c);
+                m.parent = m.parent2 = 0;
+                tables.indices.push_back(m);
+            }
+        }
+    }
+    tables.terms = (unsigned int)tables.indices.size();
+    for (MultiIndex &m : tables.indices)
+    {
+        if (m.degree == 0)
+            continue;
+        unsigned int d[3] = {m.a, m.b, m.c};
+        d[m.axis] -= 1;
+        m.parent = FmmIndex(d[0], d[1], d[2]);
+        if (m.count >= 2)
+            m.parent2 = FmmIndex(d[0] - (m.axis == 0), d[1] - (m.axis == 1), d[2] - (m.axis == 2));
+    }
+
+    tables.m2m.clear();
+    tables.m2l.clear();
+    tables.l2l.clear();
+    for (int k = 0; k < 3; ++k)
+    {
+        tables.l2p[k].clear();
+        tables.m2p[k].clear();
+    }
+    for (unsigned int out = 0; out < tables.terms; ++out)
+    {
+        const MultiIndex &o = tables.indices[out];
+        for (unsigned int in = 0; in < tables.terms; ++in)
+        {
+            const MultiIndex &i = tables.indices[in];
+            // M2M: M_o(parent) += M_i(child) t^(o - i) / (o - i)!
+            if (i.a <= o.a && i.b <= o.b && i.c <= o.c)
+                tables.m2m.push_back({out, in, FmmIndex(o.a - i.a, o.b - i.b, o.c - i.c), 1.0});
+            // M2L: L_o += (-1)^|i| M_i D_(o + i)
+            if (o.degree + i.degree <= p)
+                tables.m2l.push_back({out, in, FmmIndex(o.a + i.a, o.b + i.b, o.c + i.c), (i.degree & 1) ? -1.0 : 1.0});
+            // L2L: L_o(child) += L_i(parent) t^(i - o) / (i - o)!
+            if (o.a <= i.a && o.b <= i.b && o.c <= i.c)
+                tables.l2l.push_back({out, in, FmmIndex(i.a - o.a, i.b - o.b, i.c - o.c), 1.0});
+        }
+        // L2P: dPhi / dx_k = sum L_(o + e_k) (x - z)^o / o!
+        if (o.degree < p)
+        {
+            tables.l2p[0].push_back({0, FmmIndex(o.a + 1, o.b, o.c), out, 1.0});
+            tables.l2p[1].push_back({0, FmmIndex(o.a, o.b + 1, o.c), out, 1.0});
+            tables.l2p[2].push_back({0, FmmIndex(o.a, o.b, o.c + 1), out, 1.0});
+            // M2P: dPhi / dx_k = sum (-1)^|o| M_o D_(o + e_k)
+            const double sign = (o.degree & 1) ? -1.0 : 1.0;
+            tables.m2p[0].push_back({0, out, FmmIndex(o.a + 1, o.b, o.c), sign});
+            tables.m2p[1].push_back({0, out, FmmIndex(o.a, o.b + 1, o.c), sign});
+            tables.m2p[2].push_back({0, out, FmmIndex(o.a, o.b, o.c + 1), sign});
+        }
+    }
+}
+
+//      Note: the kernels below are compiled at -O2 like the SIMD kernels. They walk the tables through raw
+//            pointers: std::vector accessors are templates instantiated outside the pragma, i.e. at -O0.
+
+#pragma GCC push_options
+#pragma GCC optimize("O2")
+
+// Monomials d^a / a! of every multi-index of the tables (d = (x, y, z))
+void FmmMonomials(double x, double y, double z, double *out)
+{
+    const double d[3] = {x, y, z};
+    const MultiIndex *indices = fmmTables.indices.data();
+    out[0] = 1.0;
+    for (unsigned int t = 1; t < fmmTables.terms; ++t)
+    {
+        const MultiIndex &m = indices[t];
+        out[t] = out[m.parent] * d[m.axis] / (double)m.count;
+    }
+}
+
+// Derivatives d^a (1 / r) at r = (x, y, z) of every multi-index of the tables
+void InverseDistanceDerivatives(double x, double y, double z, double *D)
+{
+    const unsigned int p = fmmTables.order, terms = fmmTables.terms;
+    const double d[3] = {x, y, z};
+    const MultiIndex *indices = fmmTables.indices.data();
+    const double inv2 = 1.0 / (x * x + y * y + z * z);
+    double R[(FMM_MAX_ORDER + 1) * FMM_MAX_TERMS]; // R[n * terms + t] = R^n_t
+
+    // R^n_0 = (-1)^n (2n - 1)!! / r^(2n + 1)
+    double base = sqrt(inv2);
+    for (unsigned int n = 0; n <= p; ++n)
+    {
+        R[n * terms] = base;
+        base *= -(double)(2 * n + 1) * inv2;
+    }
+    for (unsigned int t = 1; t < terms; ++t)
+    {
+        const MultiIndex &m = indices[t];
+        for (unsigned int n = 0; n + m.degree <= p; ++n)
+        {
+            double r = d[m.axis] * R[(n + 1) * terms + m.parent];
+            if (m.count >= 2)
+                r += (double)(m.count - 1) * R[(n + 1) * terms + m.parent2];
+            R[n * terms + t] = r;
+        }
+    }
+    for (unsigned int t = 0; t < terms; ++t)
+        D[t] = R[t];
+}
+
+// Applies a translation table: out[pair.out] += pair.weight * in[pair.in] * other[pair.other]
+inline void FmmApply(const vector<FmmPair> &pairs, const double *in, const double *other, double *out)
+{
+    const FmmPair *pair = pairs.data(), *last = pair + pairs.size();
+    for (; pair < last; ++pair)
+        out[pair->out] += pair->weight * in[pair->in] * other[pair->other];
+}
+
+// Multipole about (cx, cy, cz) of the `count` sorted particles from slot `first`
+void FmmP2M(const ParticleSystem &sorted, unsigned int first, unsigned int count, double cx, double cy, double cz, double *M)
+{
+    const unsigned int terms = fmmTables.terms;
+    double mono[FMM_MAX_TERMS];
+    for (unsigned int t = 0; t < terms; ++t)
+        M[t] = 0.0;
+    for (unsigned int k = first; k < first + count; ++k)
+    {
+        FmmMonomials(sorted.x[k] - cx, sorted.y[k] - cy, sorted.z[k] - cz, mono);
+        for (unsigned int t = 0; t < terms; ++t)
+            M[t] += mono[t];
+    }
+}
+
+// Far force at (x, y, z) from a local expansion about (zx, zy, zz)
+void FmmL2P(const double *L, double zx, double zy, double zz, float x, float y, float z, double *F)
+{
+    double mono[FMM_MAX_TERMS];
+    FmmMonomials(x - zx, y - zy, z - zz, mono);
+    for (int k = 0; k < 3; ++k)
+    {
+        const FmmPair *pair = fmmTables.l2p[k].data(), *last = pair + fmmTables.l2p[k].size();
+        double f = 0;
+        for (; pair < last; ++pair)
+            f += L[pair->in] * mono[pair->other];
+        F[k] = f;
+    }
+}
+
+// Adds to F the far force at (x, y, z) of a multipole about (cx, cy, cz)
+void FmmM2P(const double *M, double cx, double cy, double cz, float x, float y, float z, double *F)
+{
+    double D[FMM_MAX_TERMS];
+    InverseDistanceDerivatives(x - cx, y - cy, z - cz, D);
+    for (int k = 0; k < 3; ++k)
+    {
+        const FmmPair *pair = fmmTables.m2p[k].data(), *last = pair + fmmTables.m2p[k].size();
+        double f = 0;
+        for (; pair < last; ++pair)
+            f += pair->weight * M[pair->in] * D[pair->other];
+        F[k] += f;
+    }
+}
+
+// Adds the `count` sorted particles from slot `first` to a local expansion about (zx, zy, zz)
+void FmmP2L(const ParticleSystem &sorted, unsigned int first, unsigned int count, double zx, double zy, double zz, double *L)
+{
+    const unsigned int terms = fmmTables.terms;
+    double D[FMM_MAX_TERMS];
+    for (unsigned int k = first; k < first + count; ++k)
+    {
+        InverseDistanceDerivatives(zx - sorted.x[k], zy - sorted.y[k], zz - sorted.z[k], D);
+        for (unsigned int t = 0; t < terms; ++t)
+            L[t] += D[t];
+    }
+}
+
+// True if the closed cubes of a and b touch or overlap
+bool FmmAdjacent(const FmmNode &a, const FmmNode &b)
+{
+    const unsigned int sa = FMM_MAX_LEVEL - a.level, sb = FMM_MAX_LEVEL - b.level;
+    return (a.ix << sa) <= ((b.ix + 1) << sb) && (b.ix << sb) <= ((a.ix + 1) << sa) &&
+           (a.iy << sa) <= ((b.iy + 1) << sb) && (b.iy << sb) <= ((a.iy + 1) << sa) &&
+           (a.iz << sa) <= ((b.iz + 1) << sb) && (b.iz << sb) <= ((a.iz + 1) << sa);
+}
+
+#pragma GCC pop_options
+
+// Cells per axis at a level
+inline unsigned int FmmSide(unsigned int level)
+{
+    return 1u << level;
+}
+
+// Center of a node's cube
+inline void FmmNodeCenter(const FmmNode &node, double *c)
+{
+    const double h = (double)fmmTree.size / FmmSide(node.level);
+    c[0] = fmmTree.originX + (node.ix + 0.5) * h;
+    c[1] = fmmTree.originY + (node.iy + 0.5) * h;
+    c[2] = fmmTree.originZ + (node.iz + 0.5) * h;
+}
+
+// Runs body(cell) over cells [first, last) on the pool, in static chunks
+void ForEachCell(unsigned int first, unsigned int last, const function<void(unsigned int)> &body, ThreadPool &pool)
+{
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), last - first, &start, &end);
+        for (unsigned int c = first + start; c < first + end; ++c)
+            body(c);
+    });
+}
+
+// True if the node holds more than fmmConfig.leafSize particles that do not all coincide
+bool FmmShouldSplit(const ParticleSystem &ps, const FmmNode &node)
+{
+    if (node.last - node.first <= fmmConfig.leafSize || node.level >= FMM_MAX_LEVEL)
+        return false;
+    const unsigned int p0 = fmmTree.index[node.first];
+    for (unsigned int k = node.first + 1; k < node.last; ++k)
+    {
+        const unsigned int p = fmmTree.index[k];
+        if (ps.x[p] != ps.x[p0] || ps.y[p] != ps.y[p0] || ps.z[p] != ps.z[p0])
+            return true;
+    }
+    return false;
+}
+
+// Partitions the particles of node k by octant and appends its non-empty children
+void SplitFmmNode(const ParticleSystem &ps, unsigned int k)
+{
+    FmmTree &tree = fmmTree;
+    const FmmNode node = tree.nodes[k];
+    double c[3];
+    FmmNodeCenter(node, c);
+
+    // Counting sort of the particle range by octant
+    unsigned int count[8] = {0}, offset[8], cursor[8];
+    for (unsigned int j = node.first; j < node.last; ++j)
+    {
+        const unsigned int p = tree.index[j];
+        count[(ps.x[p] >= c[0]) | ((ps.y[p] >= c[1]) << 1) | ((ps.z[p] >= c[2]) << 2)]++;
+    }
+    offset[0] = node.first;
+    for (int o = 1; o < 8; ++o)
+        offset[o] = offset[o - 1] + count[o - 1];
+    for (int o = 0; o < 8; ++o)
+        cursor[o] = offset[o];
+    for (unsigned int j = node.first; j < node.last; ++j)
+    {
+        const unsigned int p = tree.index[j];
+        tree.scratch[cursor[(ps.x[p] >= c[0]) | ((ps.y[p] >= c[1]) << 1) | ((ps.z[p] >= c[2]) << 2)]++] = p;
+    }
+    copy(tree.scratch.begin() + node.first, tree.scratch.begin() + node.last, tree.index.begin() + node.first);
+
+    tree.nodes[k].firstChild = (unsigned int)tree.nodes.size();
+    for (unsigned int o = 0; o < 8; ++o)
+    {
+        if (count[o] == 0)
+            continue;
+        FmmNode child;
+        child.level = node.level + 1;
+        child.ix = 2 * node.ix + (o & 1);
+        child.iy = 2 * node.iy + ((o >> 1) & 1);
+        child.iz = 2 * node.iz + (o >> 2);
+        child.parent = k;
+        child.firstChild = 0;
+        child.childCount = 0;
+        child.first = offset[o];
+        child.last = offset[o] + count[o];
+        child.slot = 0;
+        tree.nodes.push_back(child);
+        tree.nodes[k].childCount++;
+    }
+}
+
+// Builds the octree over ps breadth first, then copies the leaf positions into their padded slots
+void BuildFmmTree(const ParticleSystem &ps)
+{
+    FmmTree &tree = fmmTree;
+    tree.index.resize(ps.n);
+    tree.scratch.resize(ps.n);
+    for (unsigned int i = 0; i < ps.n; ++i)
+        tree.index[i] = i;
+    tree.nodes.clear();
+    tree.nodes.push_back(FmmNode{0, 0, 0, 0, 0, 0, 0, 0, ps.n, 0});
+    for (unsigned int k = 0; k < tree.nodes.size(); ++k)
+    {
+        if (FmmShouldSplit(ps, tree.nodes[k]))
+            SplitFmmNode(ps, k);
+    }
+
+    tree.depth = tree.nodes.back().level;
+    tree.levelStart.assign(tree.depth + 2, (unsigned int)tree.nodes.size());
+    for (unsigned int k = (unsigned int)tree.nodes.size(); k-- > 0;)
+        tree.levelStart[tree.nodes[k].level] = k;
+
+    // Leaves in tree (depth-first octant) order, each padded to whole PARTICLE_PADDING slots
+    vector<unsigned int> leaves;
+    for (unsigned int k = 0; k < tree.nodes.size(); ++k)
+    {
+        if (tree.nodes[k].childCount == 0)
+            leaves.push_back(k);
+    }
+    sort(leaves.begin(), leaves.end(), [&](unsigned int a, unsigned int b) { return tree.nodes[a].first < tree.nodes[b].first; });
+    unsigned int slots = 0;
+    tree.maxLeafCount = 0;
+    for (unsigned int leaf : leaves)
+    {
+        FmmNode &node = tree.nodes[leaf];
+        node.slot = slots;
+        slots += PaddedCount(node.last - node.first);
+        tree.maxLeafCount = max(tree.maxLeafCount, node.last - node.first);
+    }
+    tree.leafCount = (unsigned int)leaves.size();
+
+    if (!tree.sorted || tree.sorted->n < slots)
+        tree.sorted.reset(new ParticleSystem(slots + slots / 8)); // headroom for the next rebuilds
+    ParticleSystem &sorted = *tree.sorted;
+    fill(sorted.x, sorted.x + sorted.n, CELL_SENTINEL);
+    fill(sorted.y, sorted.y + sorted.n, CELL_SENTINEL);
+    fill(sorted.z, sorted.z + sorted.n, CELL_SENTINEL);
+    tree.leafOf.resize(ps.n);
+    for (unsigned int leaf : leaves)
+    {
+        const FmmNode &node = tree.nodes[leaf];
+        for (unsigned int j = node.first; j < node.last; ++j)
+        {
+            const unsigned int p = tree.index[j], slot = node.slot + (j - node.first);
+            sorted.x[slot] = ps.x[p];
+            sorted.y[slot] = ps.y[p];
+            sorted.z[slot] = ps.z[p];
+            tree.leafOf[p] = leaf;
+        }
+    }
+}
+
+// Descends node c (a colleague of leaf b, or one of its descendants touching b): leaves touching b go to
+// U(b), the first cells below that do not touch b go to W(b)
+void CollectNearFmm(unsigned int b, unsigned int c)
+{
+    FmmTree &tree = fmmTree;
+    const FmmNode &node = tree.nodes[c];
+    for (unsigned int d = node.firstChild; d < node.firstChild + node.childCount; ++d)
+    {
+        if (!FmmAdjacent(tree.nodes[d], tree.nodes[b]))
+            tree.w[b].push_back(d);
+        else if (tree.nodes[d].childCount == 0)
+            tree.u[b].push_back(d);
+        else
+            CollectNearFmm(b, d);
+    }
+}
+
+// Colleagues, then the U, V, W and X lists of every node
+void BuildFmmLists(ThreadPool &pool)
+{
+    FmmTree &tree = fmmTree;
+    const unsigned int count = (unsigned int)tree.nodes.size();
+    for (vector<vector<unsigned int>> *lists : {&tree.colleagues, &tree.u, &tree.v, &tree.w, &tree.x, &tree.near})
+        lists->resize(count);
+
+    // Colleagues and V, level by level: the children of the parent's colleagues, touching or not
+    tree.colleagues[0].assign(1, 0);
+    tree.v[0].clear();
+    for (unsigned int l = 1; l <= tree.depth; ++l)
+    {
+        ForEachCell(tree.levelStart[l], tree.levelStart[l + 1], [&](unsigned int b)
+        {
+            const FmmNode &node = tree.nodes[b];
+            tree.colleagues[b].clear();
+            tree.v[b].clear();
+            for (unsigned int c : tree.colleagues[node.parent])
+            {
+                const FmmNode &colleague = tree.nodes[c];
+                for (unsigned int d = colleague.firstChild; d < colleague.firstChild + colleague.childCount; ++d)
+                    (FmmAdjacent(tree.nodes[d], node) ? tree.colleagues[b] : tree.v[b]).push_back(d);
+            }
+        }, pool);
+    }
+
+    // U (same level and finer) and W of every leaf
+    ForEachCell(0, count, [&](unsigned int b)
+    {
+        tree.u[b].clear();
+        tree.w[b].clear();
+        tree.x[b].clear();
+        if (tree.nodes[b].childCount > 0)
+            return;
+        for (unsigned int c : tree.colleagues[b])
+        {
+            if (c == b || tree.nodes[c].childCount == 0)
+                tree.u[b].push_back(c);
+            else
+                CollectNearFmm(b, c);
+        }
+    }, pool);
+
+    // Coarser leaves of U and the X lists are the mirror images of the lists above
+    tree.wCount = 0;
+    for (unsigned int b = 0; b < count; ++b)
+    {
+        for (unsigned int d : tree.u[b])
+        {
+            if (tree.nodes[d].level > tree.nodes[b].level)
+                tree.u[d].push_back(b);
+        }
+        for (unsigned int d : tree.w[b])
+            tree.x[d].push_back(b);
+        tree.wCount += (unsigned int)tree.w[b].size();
+    }
+
+    // P2P ranges: U in slot order, leaves stored next to each other merged into one range
+    ForEachCell(0, count, [&](unsigned int b)
+    {
+        vector<unsigned int> &u = tree.u[b], &near = tree.near[b];
+        sort(u.begin(), u.end(), [&](unsigned int a, unsigned int c) { return tree.nodes[a].slot < tree.nodes[c].slot; });
+        near.clear();
+        for (unsigned int d : u)
+        {
+            const unsigned int begin = tree.nodes[d].slot, end = begin + PaddedCount(tree.nodes[d].last - tree.nodes[d].first);
+            if (!near.empty() && near.back() == begin)
+                near.back() = end;
+            else
+            {
+                near.push_back(begin);
+                near.push_back(end);
+            }
+        }
+    }, pool);
+}
+
+/**
+ * @brief Builds the adaptive tree and the interaction lists over the current positions of ps and computes
+ *        every cell's multipole and local expansion (P2M, M2M, then L2L + M2L + P2L). MoveChunkFMM then
+ *        evaluates L2P + M2P + P2P per particle.
+ */
+void BuildFmm(const ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    FmmTree &tree = fmmTree;
+    PrepareFmmTables(fmmConfig.order);
+    const unsigned int terms = fmmTables.terms;
+    auto buildStart = chrono::high_resolution_clock::now();
+
+    // Root cube, slightly enlarged so particles on the max faces fall inside
+    float minX = ps.x[0], maxX = minX, minY = ps.y[0], maxY = minY, minZ = ps.z[0], maxZ = minZ;
+    for (unsigned int i = 1; i < ps.n; ++i)
+    {
+        minX = min(minX, ps.x[i]);
+        maxX = max(maxX, ps.x[i]);
+        minY = min(minY, ps.y[i]);
+        maxY = max(maxY, ps.y[i]);
+        minZ = min(minZ, ps.z[i]);
+        maxZ = max(maxZ, ps.z[i]);
+    }
+    tree.size = max(maxX - minX, max(maxY - minY, maxZ - minZ)) * 1.001f + 1e-6f;
+    tree.originX = minX;
+    tree.originY = minY;
+    tree.originZ = minZ;
+    BuildFmmTree(ps);
+    BuildFmmLists(pool);
+
+    // Derivatives of 1/r for every offset (dx, dy, dz) in [-3, 3]^3 cells of the levels with V lists
+    for (unsigned int l = 2; l <= tree.depth; ++l)
+    {
+        const double h = (double)tree.size / FmmSide(l);
+        tree.offsets[l].resize(343 * (size_t)terms);
+        for (int dz = -3; dz <= 3; ++dz)
+            for (int dy = -3; dy <= 3; ++dy)
+                for (int dx = -3; dx <= 3; ++dx)
+                {
+                    if (abs(dx) <= 1 && abs(dy) <= 1 && abs(dz) <= 1)
+                        continue;
+                    size_t o = (size_t)((dz + 3) * 49 + (dy + 3) * 7 + (dx + 3));
+                    InverseDistanceDerivatives(dx * h, dy * h, dz * h, &tree.offsets[l][o * terms]);
+                }
+    }
+    tree.multipole.resize(tree.nodes.size() * terms);
+    tree.local.resize(tree.nodes.size() * terms);
+    auto upwardStart = chrono::high_resolution_clock::now();
+
+    // Upward pass, deepest level first: P2M at the leaves, M2M from the children elsewhere
+    const ParticleSystem &sorted = *tree.sorted;
+    for (unsigned int l = tree.depth + 1; l-- > 0;)
+    {
+        ForEachCell(tree.levelStart[l], tree.levelStart[l + 1], [&](unsigned int b)
+        {
+            const FmmNode &node = tree.nodes[b];
+            double *M = &tree.multipole[(size_t)b * terms];
+            double c[3], cc[3], mono[FMM_MAX_TERMS];
+            FmmNodeCenter(node, c);
+            if (node.childCount == 0)
+            {
+                FmmP2M(sorted, node.slot, node.last - node.first, c[0], c[1], c[2], M);
+                return;
+            }
+            fill(M, M + terms, 0.0);
+            for (unsigned int d = node.firstChild; d < node.firstChild + node.childCount; ++d)
+            {
+                FmmNodeCenter(tree.nodes[d], cc);
+                FmmMonomials(cc[0] - c[0], cc[1] - c[1], cc[2] - c[2], mono);
+                FmmApply(fmmTables.m2m, &tree.multipole[(size_t)d * terms], mono, M);
+            }
+        }, pool);
+    }
+    auto downwardStart = chrono::high_resolution_clock::now();
+
+    // Downward pass, root first: L2L from the parent, M2L from V, P2L from X
+    tree.m2lCount = 0;
+    for (unsigned int l = 0; l <= tree.depth; ++l)
+    {
+        ForEachCell(tree.levelStart[l], tree.levelStart[l + 1], [&](unsigned int b)
+        {
+            const FmmNode &node = tree.nodes[b];
+            double *Lc = &tree.local[(size_t)b * terms];
+            double c[3], pc[3], mono[FMM_MAX_TERMS];
+            fill(Lc, Lc + terms, 0.0);
+            FmmNodeCenter(node, c);
+            if (l > 0)
+            {
+                FmmNodeCenter(tree.nodes[node.parent], pc);
+                FmmMonomials(c[0] - pc[0], c[1] - pc[1], c[2] - pc[2], mono);
+                FmmApply(fmmTables.l2l, &tree.local[(size_t)node.parent * terms], mono, Lc);
+            }
+            for (unsigned int s : tree.v[b])
+            {
+                const FmmNode &source = tree.nodes[s];
+                const int dx = (int)node.ix - (int)source.ix, dy = (int)node.iy - (int)source.iy, dz = (int)node.iz - (int)source.iz;
+                const size_t o = (size_t)((dz + 3) * 49 + (dy + 3) * 7 + (dx + 3));
+                FmmApply(fmmTables.m2l, &tree.multipole[(size_t)s * terms], &tree.offsets[l][o * terms], Lc);
+            }
+            for (unsigned int s : tree.x[b])
+            {
+                const FmmNode &source = tree.nodes[s];
+                FmmP2L(sorted, source.slot, source.last - source.first, c[0], c[1], c[2], Lc);
+            }
+        }, pool);
+        for (unsigned int b = tree.levelStart[l]; b < tree.levelStart[l + 1]; ++b)
+            tree.m2lCount += (unsigned int)tree.v[b].size();
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    tree.buildMs += chrono::duration<double, milli>(upwardStart - buildStart).count();
+    tree.upwardMs += chrono::duration<double, milli>(downwardStart - upwardStart).count();
+    tree.downwardMs += chrono::duration<double, milli>(end - downwardStart).count();
+}
+
+// FMM force on particle i: L2P from its leaf, M2P from the leaf's W list and P2P over its U list. Needs BuildFmm() first.
+void ComputeForceFMM(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz)
+{
+    const FmmTree &tree = fmmTree;
+    const unsigned int terms = fmmTables.terms;
+    const unsigned int leaf = tree.leafOf[i];
+    const FmmNode &node = tree.nodes[leaf];
+    double c[3], far[3];
+    FmmNodeCenter(node, c);
+    FmmL2P(&tree.local[(size_t)leaf * terms], c[0], c[1], c[2], ps.x[i], ps.y[i], ps.z[i], far);
+    for (unsigned int s : tree.w[leaf])
+    {
+        FmmNodeCenter(tree.nodes[s], c);
+        FmmM2P(&tree.multipole[(size_t)s * terms], c[0], c[1], c[2], ps.x[i], ps.y[i], ps.z[i], far);
+    }
+
+    // Near field: one call of the SIMD kernel per merged range of U
+    float nearX = 0, nearY = 0, nearZ = 0;
+    const unsigned int *near = tree.near[leaf].data();
+    for (size_t k = 0; k < tree.near[leaf].size(); k += 2)
+    {
+        ParticleSystem range(*tree.sorted, near[k], near[k + 1] - near[k]);
+        float fx = 0, fy = 0, fz = 0;
+        ComputeForceAt(range, ps.x[i], ps.y[i], ps.z[i], &fx, &fy, &fz);
+        nearX += fx;
+        nearY += fy;
+        nearZ += fz;
+    }
+    *Fx = nearX + (float)far[0];
+    *Fy = nearY + (float)far[1];
+    *Fz = nearZ + (float)far[2];
+}
+
+// FMM counterpart of MoveChunk: forces, then velocity update
+void MoveChunkFMM(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+    {
+        float Fx, Fy, Fz;
+        ComputeForceFMM(ps, i, &Fx, &Fy, &Fz);
+        ps.vx[i] += dt * Fx;
+        ps.vy[i] += dt * Fy;
+        ps.vz[i] += dt * Fz;
+    }
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef NBODY_FUSED_HPP
+#define NBODY_FUSED_HPP
+
+#include "nbody_parallel.hpp"
+#include <memory>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: the update phase cannot run inside the force phase in place: while thread t moves its
+//            particles, other threads are still reading the old positions. With two position buffers,
+//            the force pass reads positions from the current buffer and writes x + v * dt of its own
+//            particles into the other one, and the buffers swap roles after the pass. This leaves one
+//            parallel phase per step instead of two, and each thread writes its positions while its
+//            velocities are still in cache.
+
+//      Note: the direct kernel fuses per particle (force, velocity, next position). Any other chunk kernel
+//            (tiled, Barnes-Hut, cutoff) runs on the chunk first and the chunk's positions are written after it.
+//            Both do the same operations as MoveChunk + UpdateChunkPosition, so results are bit-identical.
+
+//      Note: both buffers are ParticleSystem views sharing the velocity arrays: views[0] over the owner's
+//            positions, views[1] over a second x / y / z block. Anything that reads the owner's block
+//            (snapshots, result files) must call SyncFusedPositions() first.
+
+struct FusedBuffers
+{
+    float *positions = nullptr;           // second x | y | z block
+    unique_ptr<ParticleSystem> views[2];  // 0: owner positions, 1: second block
+    unsigned int current = 0;             // view holding the current positions
+    ChunkFunction force = MoveChunk;      // force + velocity kernel of the fused pass
+};
+
+FusedBuffers fusedBuffers;
+
+// Allocates the second position block of ps, forces with `force`
+void PrepareFused(ParticleSystem &ps, ChunkFunction force)
+{
+    free(fusedBuffers.positions);
+    fusedBuffers.positions = (float *)AllocateAligned(3 * (size_t)ps.stride * sizeof(float));
+    float *p = fusedBuffers.positions;
+    fusedBuffers.views[0].reset(new ParticleSystem(ps, ps.x, ps.y, ps.z));
+    fusedBuffers.views[1].reset(new ParticleSystem(ps, p, p + ps.stride, p + 2 * (size_t)ps.stride));
+    fusedBuffers.current = 0;
+    fusedBuffers.force = force;
+}
+
+void FreeFused()
+{
+    fusedBuffers.views[0].reset();
+    fusedBuffers.views[1].reset();
+    free(fusedBuffers.positions);
+    fusedBuffers.positions = nullptr;
+}
+
+// Particle system holding the current positions
+ParticleSystem &FusedCurrent()
+{
+    return *fusedBuffers.views[fusedBuffers.current];
+}
+
+// Force, velocity and next-position update of [start, end): reads ps (current), writes the other buffer
+void MoveChunkFused(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    ParticleSystem &next = *fusedBuffers.views[fusedBuffers.current ^ 1];
+    if (fusedBuffers.force == MoveChunk)
+    {
+        for (unsigned int i = start; i < end; ++i)
+        {
+            float Fx = 0, Fy = 0, Fz = 0;
+            ComputeForceDirect(ps, i, &Fx, &Fy, &Fz);
+            ps.vx[i] += dt * Fx;
+            ps.vy[i] += dt * Fy;
+            ps.vz[i] += dt * Fz;
+            next.x[i] = ps.x[i] + ps.vx[i] * dt;
+            next.y[i] = ps.y[i] + ps.vy[i] * dt;
+            next.z[i] = ps.z[i] + ps.vz[i] * dt;
+        }
+        return;
+    }
+    fusedBuffers.force(ps, start, end);
+    for (unsigned int i = start; i < end; ++i)
+    {
+        next.x[i] = ps.x[i] + ps.vx[i] * dt;
+        next.y[i] = ps.y[i] + ps.vy[i] * dt;
+        next.z[i] = ps.z[i] + ps.vz[i] * dt;
+    }
+}
+
+// Call after every fused pass: the buffer just written becomes the current one
+void SwapFusedBuffers()
+{
+    fusedBuffers.current ^= 1;
+}
+
+// Copies the current positions back into the owner's block (no-op if they are already there)
+void SyncFusedPositions(ThreadPool &pool = WorkerPool())
+{
+    if (fusedBuffers.current == 0)
+        return;
+    ParticleSystem &from = *fusedBuffers.views[1];
+    ParticleSystem &to = *fusedBuffers.views[0];
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), from.stride, &start, &end);
+        memcpy(to.x + start, from.x + start, (end - start) * sizeof(float));
+        memcpy(to.y + start, from.y + start, (end - start) * sizeof(float));
+        memcpy(to.z + start, from.z + start, (end - start) * sizeof(float));
+    });
+    fusedBuffers.current = 0;
+}
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef NBODY_IC_HPP
+#define NBODY_IC_HPP
+
+#include "particle_system.hpp"
+#include <cmath>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: the original lattice (i % 15, i * i % 15, 3 * i * i % 15) only has 15 distinct positions, so
+//            all but a few particles sit exactly on top of others and, with softening = 1e-20, feel huge
+//            forces. The generators below produce realistic, collision-free workloads:
+//              plummer   Plummer sphere in equilibrium (Aarseth, Henon & Wielen 1974 sampling)
+//              uniform   uniform cube with uniform random velocities at virial ratio 1/2
+//              cold      uniform sphere at rest (cold collapse)
+//              galaxies  two Plummer spheres on a parabolic collision orbit with an impact parameter
+//            The lattice stays the default, so existing results and reference files are unchanged.
+//            Softening is untouched: no two particles coincide any more, but close encounters are still
+//            unregularized (a cold collapse, where pairs fall straight onto each other, shows it within a
+//            few steps at dt = 0.01).
+
+//      Note: units G = 1 and unit masses (the force kernels sum unit masses). Lengths scale with N^(1/3),
+//            keeping the mean density near one particle per unit volume, so the dynamical time
+//            sqrt(R^3 / N) and hence the number of dt steps per crossing do not depend on N.
+
+//      Note: random numbers come from Philox4x32-10, a counter-based generator: the numbers of particle
+//            i are the encryption of the counter (i, block) under the key (seed). Each particle depends
+//            only on (kind, seed, i, N), so any chunking, thread count or first-touch order produces
+//            identical data, and initializing tens of millions of particles is a plain parallel loop.
+//            There is no centre-of-mass correction (it would need a global reduction); the drift is
+//            O(1 / sqrt(N)).
+
+enum InitialCondition
+{
+    IC_LATTICE,
+    IC_PLUMMER,
+    IC_UNIFORM,
+    IC_COLD,
+    IC_GALAXIES,
+    IC_COUNT
+};
+
+const char *const initialConditionNames[IC_COUNT] = {"lattice", "plummer", "uniform", "cold", "galaxies"};
+
+struct IcConfig
+{
+    InitialCondition kind = IC_LATTICE;
+    uint64_t seed = 1;
+};
+
+IcConfig icConfig;
+
+bool ParseInitialCondition(const string &text, InitialCondition *kind)
+{
+    for (int k = 0; k < IC_COUNT; ++k)
+    {
+        if (text == initialConditionNames[k])
+        {
+            *kind = (InitialCondition)k;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Philox4x32-10 block: encrypts counter c[4] under key (k0, k1) in place
+inline void Philox4x32(uint32_t c[4], uint32_t k0, uint32_t k1)
+{
+    for (int round = 0; round < 10; ++round)
+    {
+        uint64_t p0 = (uint64_t)0xD2511F53u * c[0];
+        uint64_t p1 = (uint64_t)0xCD9E8D57u * c[2];
+        uint32_t next[4] = {(uint32_t)(p1 >> 32) ^ c[1] ^ k0, (uint32_t)p1, (uint32_t)(p0 >> 32) ^ c[3] ^ k1, (uint32_t)p0};
+        c[0] = next[0];
+        c[1] = next[1];
+        c[2] = next[2];
+        c[3] = next[3];
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+}
+
+// Random numbers of one particle: counter (particle, block, stream), four 32-bit outputs per block
+class ParticleRandom
+{
+public:
+    ParticleRandom(uint64_t seed, unsigned int particle, unsigned int stream = 0)
+        : key0((uint32_t)seed), key1((uint32_t)(seed >> 32)), particle(particle), stream(stream), block(0), used(4)
+    {
+    }
+
+    // Uniform double in (0, 1)
+    double Uniform()
+    {
+        if (used == 4)
+        {
+            values[0] = particle;
+            values[1] = block++;
+            values[2] = stream;
+            values[3] = 0;
+            Philox4x32(values, key0, key1);
+            used = 0;
+        }
+        return ((double)values[used++] + 0.5) * (1.0 / 4294967296.0);
+    }
+
+private:
+    uint32_t key0, key1;
+    unsigned int particle, stream, block;
+    uint32_t values[4];
+    int used;
+};
+
+// Isotropic unit vector times length
+inline void RandomDirection(ParticleRandom &random, double length, double *v)
+{
+    double cosTheta = 2.0 * random.Uniform() - 1.0;
+    double sinTheta = sqrt(fmax(0.0, 1.0 - cosTheta * cosTheta));
+    double phi = 2.0 * M_PI * random.Uniform();
+    v[0] = length * sinTheta * cos(phi);
+    v[1] = length * sinTheta * sin(phi);
+    v[2] = length * cosTheta;
+}
+
+// Plummer scale radius of a sphere of `mass` unit particles at the generators' density scale
+inline double PlummerRadius(double mass)
+{
+    return 0.5 * cbrt(mass);
+}
+
+// One particle of a Plummer sphere of `mass` and scale radius a, centred on the origin, at rest overall
+void PlummerParticle(ParticleRandom &random, double mass, double a, double *pos, double *vel)
+{
+    // Radius from the cumulative mass m(r) = (r / a)^3 / (1 + (r / a)^2)^(3/2), cut at 99.9 % of the mass
+    double m = 0.999 * random.Uniform();
+    double r = a / sqrt(pow(m, -2.0 / 3.0) - 1.0);
+    RandomDirection(random, r, pos);
+
+    // Speed q * v_escape, q drawn from q^2 (1 - q^2)^(7/2) by rejection
+    double q, g;
+    do
+    {
+        q = random.Uniform();
+        g = 0.1 * random.Uniform();
+    } while (g > q * q * pow(1.0 - q * q, 3.5));
+    double escape = sqrt(2.0 * mass / sqrt(r * r + a * a));
+    RandomDirection(random, q * escape, vel);
+}
+
+/**
+ * @brief Particle i of n for the given initial condition and seed. Depends on nothing else, so chunks can be
+ *        generated in any order and on any number of threads.
+ */
+void GenerateParticle(const IcConfig &config, unsigned int i, unsigned int n, OneParticle *p)
+{
+    double pos[3] = {0, 0, 0}, vel[3] = {0, 0, 0};
+    ParticleRandom random(config.seed, i);
+    switch (config.kind)
+    {
+    case IC_PLUMMER:
+        PlummerParticle(random, n, PlummerRadius(n), pos, vel);
+        break;
+    case IC_UNIFORM:
+    {
+        // Cube of edge s = N^(1/3); uniform velocities in [-u, u]^3 give K = |W| / 2 with W = -0.9411 N^2 / s
+        const double s = cbrt((double)n);
+        const double u = sqrt(0.9411 * n / s);
+        for (int k = 0; k < 3; ++k)
+            pos[k] = s * (random.Uniform() - 0.5);
+        for (int k = 0; k < 3; ++k)
+            vel[k] = u * (2.0 * random.Uniform() - 1.0);
+        break;
+    }
+    case IC_COLD:
+    {
+        // Unit density sphere: 4/3 pi R^3 = N
+        const double R = cbrt(3.0 * n / (4.0 * M_PI));
+        RandomDirection(random, R * cbrt(random.Uniform()), pos);
+        break;
+    }
+    case IC_GALAXIES:
+    {
+        // Galaxy 0 takes the first half. Separation 6 a along x, impact parameter a along y,
+        // relative speed of a parabolic orbit sqrt(2 M / d), shared about the centre of mass.
+        const unsigned int half = n / 2;
+        const bool second = (i >= half);
+        const double mass = second ? n - half : half;
+        const double a = PlummerRadius(mass);
+        PlummerParticle(random, mass, a, pos, vel);
+        const double d = 6.0 * a;
+        const double speed = sqrt(2.0 * n / sqrt(d * d + a * a));
+        const double sign = second ? 1.0 : -1.0;
+        const double share = (second ? half : n - half) / (double)n; // the lighter galaxy moves more
+        pos[0] += sign * 0.5 * d;
+        pos[1] += sign * 0.5 * a;
+        vel[0] -= sign * share * speed;
+        break;
+    }
+    default:
+        pos[0] = (float)(i % 15);
+        pos[1] = (float)((i * i) % 15);
+        pos[2] = (float)((i * i * 3) % 15);
+        break;
+    }
+    p->x = (float)pos[0];
+    p->y = (float)pos[1];
+    p->z = (float)pos[2];
+    p->vx = (float)vel[0];
+    p->vy = (float)vel[1];
+    p->vz = (float)vel[2];
+}
+
+// Initializes particles [start, end) of ps with icConfig (drop-in replacement for InitChunk)
+void GenerateChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    for (unsigned int i = start; i < end; ++i)
+    {
+        OneParticle p;
+        GenerateParticle(icConfig, i, ps.n, &p);
+        ps.x[i] = p.x;
+        ps.y[i] = p.y;
+        ps.z[i] = p.z;
+        ps.vx[i] = p.vx;
+        ps.vy[i] = p.vy;
+        ps.vz[i] = p.vz;
+    }
+}
+
+#endif
@@ -0,0 +1,374 @@
+#ifndef NBODY_INTEGRATOR_HPP
+#define NBODY_INTEGRATOR_HPP
+
+#include "nbody_parallel.hpp"
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: MoveChunk + UpdateChunkPosition is a semi-implicit (symplectic) Euler step: first order, so
+//            accuracy needs a small dt, and every step costs a full O(N^2) force evaluation. The integrators
+//            here all advance the system by dt per step, with the direct-sum force of MoveChunk (active
+//            backend, precision and accumulation mode):
+//              euler     the original MoveChunk / UpdateChunkPosition pair (1 force evaluation per step)
+//              leapfrog  kick-drift-kick, second order and symplectic. The closing kick's accelerations are
+//                        the next opening kick's, so it also costs 1 evaluation per step
+//              rk4       classical Runge-Kutta, fourth order, 4 evaluations per step
+//              block     hierarchical (power-of-two) block timesteps on top of KDK leapfrog, see below
+
+//      Note: block timesteps: particle i is on level l, with step dt / 2^l, l in [0, maxLevel], the smallest
+//            level with dt / 2^l <= eta * sqrt(1 / |a_i|) (unit length, the lattice spacing). A step of dt
+//            is cut into 2^maxLevel ticks. On every tick all particles drift, and only the particles whose
+//            own step ends get a new force, their closing kick and a new level. A level can get finer at
+//            any step end, and coarser only where the coarser step grid lines up. Quiet particles thus cost
+//            one force evaluation per dt, and only the fast ones pay for the fine steps.
+
+//      Note: scratch arrays reuse the ParticleSystem layout (six padded, aligned float arrays): accel holds
+//            the accelerations in x / y / z, the RK4 stage system the stage positions and velocities.
+
+enum IntegratorKind
+{
+    INTEGRATOR_EULER,
+    INTEGRATOR_LEAPFROG,
+    INTEGRATOR_RK4,
+    INTEGRATOR_BLOCK,
+    INTEGRATOR_COUNT
+};
+
+const char *const integratorNames[INTEGRATOR_COUNT] = {"euler", "leapfrog", "rk4", "block"};
+
+// Parses an integrator name, returns false for unknown names
+bool ParseIntegrator(const string &text, IntegratorKind *kind)
+{
+    for (int k = 0; k < INTEGRATOR_COUNT; ++k)
+    {
+        if (text == integratorNames[k])
+        {
+            *kind = (IntegratorKind)k;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Block timestep parameters (--max-level, --eta)
+struct BlockConfig
+{
+    unsigned int maxLevel = 4; // finest step dt / 2^maxLevel
+    float eta = 0.02f;         // accuracy parameter of the step criterion
+};
+
+BlockConfig blockConfig;
+
+struct IntegratorState
+{
+    IntegratorKind kind = INTEGRATOR_EULER;
+    unique_ptr<ParticleSystem> accel;  // accelerations in x / y / z
+    unique_ptr<ParticleSystem> stage;  // RK4: stage positions and velocities
+    unique_ptr<ParticleSystem> sum;    // RK4: weighted sums of the stage derivatives (x: dx/dt, vx: dv/dt)
+    vector<unsigned char> level;       // block: timestep level of every particle
+    vector<unsigned int> active;       // block: particles whose step ends on the current tick
+    unsigned int finestLevel = 0;      // block: finest level any particle reached
+    bool primed = false;               // accel holds the accelerations of the current positions
+    unsigned long long forceEvaluations = 0; // single-particle force evaluations (N per full evaluation)
+    unsigned long long steps = 0;
+};
+
+IntegratorState integratorState;
+
+// Allocates the scratch arrays of `kind` for ps. Call before the first IntegratorStep.
+void PrepareIntegrator(IntegratorKind kind, const ParticleSystem &ps)
+{
+    integratorState.kind = kind;
+    integratorState.primed = false;
+    if (kind == INTEGRATOR_EULER)
+        return;
+    integratorState.accel.reset(new ParticleSystem(ps.n));
+    if (kind == INTEGRATOR_RK4)
+    {
+        integratorState.stage.reset(new ParticleSystem(ps.n));
+        integratorState.sum.reset(new ParticleSystem(ps.n));
+    }
+    if (kind == INTEGRATOR_BLOCK)
+    {
+        integratorState.level.assign(ps.n, 0);
+        integratorState.active.reserve(ps.n);
+    }
+}
+
+// Accelerations of a chunk of ps (positions only) into integratorState.accel
+void AccelChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    ParticleSystem &a = *integratorState.accel;
+    for (unsigned int i = start; i < end; ++i)
+        ComputeForceDirect(ps, i, &a.x[i], &a.y[i], &a.z[i]);
+}
+
+// Full force evaluation at the positions of ps
+void ComputeAccelerations(ParticleSystem &ps, ThreadPool &pool)
+{
+    StartThreads(ps, AccelChunk, pool);
+    integratorState.forceEvaluations += ps.n;
+}
+
+// Kick-drift-kick leapfrog step
+void StepLeapfrog(ParticleSystem &ps, ThreadPool &pool)
+{
+    ParticleSystem &a = *integratorState.accel;
+    const float halfDt = 0.5f * dt;
+    if (!integratorState.primed)
+        ComputeAccelerations(ps, pool);
+
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        for (unsigned int i = start; i < end; ++i)
+        {
+            ps.vx[i] += halfDt * a.x[i];
+            ps.vy[i] += halfDt * a.y[i];
+            ps.vz[i] += halfDt * a.z[i];
+            ps.x[i] += dt * ps.vx[i];
+            ps.y[i] += dt * ps.vy[i];
+            ps.z[i] += dt * ps.vz[i];
+        }
+    });
+    ComputeAccelerations(ps, pool);
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        for (unsigned int i = start; i < end; ++i)
+        {
+            ps.vx[i] += halfDt * a.x[i];
+            ps.vy[i] += halfDt * a.y[i];
+            ps.vz[i] += halfDt * a.z[i];
+        }
+    });
+    integratorState.primed = true;
+}
+
+// Classical RK4 step. Stage s evaluates the accelerations at the stage positions, adds its weighted
+// derivatives to sum and builds the next stage from the start-of-step state.
+void StepRK4(ParticleSystem &ps, ThreadPool &pool)
+{
+    ParticleSystem &a = *integratorState.accel;
+    ParticleSystem &stage = *integratorState.stage;
+    ParticleSystem &sum = *integratorState.sum;
+    const float weights[4] = {1.0f, 2.0f, 2.0f, 1.0f}; // weight of stage s in the final sum
+    const float offsets[4] = {0.5f * dt, 0.5f * dt, dt, 0.0f}; // time offset of stage s + 1
+
+    // Stage 1 runs on the start-of-step state
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        for (unsigned int i = start; i < end; ++i)
+        {
+            stage.x[i] = ps.x[i];
+            stage.y[i] = ps.y[i];
+            stage.z[i] = ps.z[i];
+            stage.vx[i] = ps.vx[i];
+            stage.vy[i] = ps.vy[i];
+            stage.vz[i] = ps.vz[i];
+        }
+    });
+
+    for (int s = 0; s < 4; ++s)
+    {
+        ComputeAccelerations(stage, pool);
+        pool.Run([&](unsigned int t)
+        {
+            unsigned int start, end;
+            ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+            const float w = weights[s], h = offsets[s];
+            for (unsigned int i = start; i < end; ++i)
+            {
+                // Derivatives of stage s: (stage velocity, acceleration)
+                if (s == 0)
+                {
+                    sum.x[i] = stage.vx[i];
+                    sum.y[i] = stage.vy[i];
+                    sum.z[i] = stage.vz[i];
+                    sum.vx[i] = a.x[i];
+                    sum.vy[i] = a.y[i];
+                    sum.vz[i] = a.z[i];
+                }
+                else
+                {
+                    sum.x[i] += w * stage.vx[i];
+                    sum.y[i] += w * stage.vy[i];
+                    sum.z[i] += w * stage.vz[i];
+                    sum.vx[i] += w * a.x[i];
+                    sum.vy[i] += w * a.y[i];
+                    sum.vz[i] += w * a.z[i];
+                }
+
+                if (s < 3)
+                {
+                    // Next stage: start-of-step state advanced by h along this stage's derivatives
+                    stage.x[i] = ps.x[i] + h * stage.vx[i];
+                    stage.y[i] = ps.y[i] + h * stage.vy[i];
+                    stage.z[i] = ps.z[i] + h * stage.vz[i];
+                    stage.vx[i] = ps.vx[i] + h * a.x[i];
+                    stage.vy[i] = ps.vy[i] + h * a.y[i];
+                    stage.vz[i] = ps.vz[i] + h * a.z[i];
+                }
+                else
+                {
+                    ps.x[i] += (dt / 6.0f) * sum.x[i];
+                    ps.y[i] += (dt / 6.0f) * sum.y[i];
+                    ps.z[i] += (dt / 6.0f) * sum.z[i];
+                    ps.vx[i] += (dt / 6.0f) * sum.vx[i];
+                    ps.vy[i] += (dt / 6.0f) * sum.vy[i];
+                    ps.vz[i] += (dt / 6.0f) * sum.vz[i];
+                }
+            }
+        });
+    }
+}
+
+// Finest level whose step fits the criterion dt_i = eta * sqrt(1 / |a_i|)
+inline unsigned char BlockLevel(float ax, float ay, float az)
+{
+    float a2 = ax * ax + ay * ay + az * az;
+    unsigned int level = 0;
+    if (a2 > 0)
+    {
+        float wanted = blockConfig.eta / sqrtf(sqrtf(a2));
+        while (level < blockConfig.maxLevel && dt / (float)(1u << level) > wanted)
+            ++level;
+    }
+    return (unsigned char)level;
+}
+
+// Ticks (of dt / 2^maxLevel) in one step of `level`
+inline unsigned int BlockTicks(unsigned int level)
+{
+    return 1u << (blockConfig.maxLevel - level);
+}
+
+// One dt of hierarchical block timesteps (KDK per level)
+void StepBlock(ParticleSystem &ps, ThreadPool &pool)
+{
+    ParticleSystem &a = *integratorState.accel;
+    vector<unsigned char> &level = integratorState.level;
+    vector<unsigned int> &active = integratorState.active;
+    const unsigned int ticks = 1u << blockConfig.maxLevel;
+    const float tickDt = dt / (float)ticks;
+
+    if (!integratorState.primed)
+    {
+        ComputeAccelerations(ps, pool);
+        for (unsigned int i = 0; i < ps.n; ++i)
+            level[i] = BlockLevel(a.x[i], a.y[i], a.z[i]);
+        integratorState.primed = true;
+    }
+
+    for (unsigned int tick = 0; tick < ticks; ++tick)
+    {
+        // Opening kick of the particles whose step starts now, then everyone drifts one tick
+        pool.Run([&](unsigned int t)
+        {
+            unsigned int start, end;
+            ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+            for (unsigned int i = start; i < end; ++i)
+            {
+                if (tick % BlockTicks(level[i]) == 0)
+                {
+                    const float halfStep = 0.5f * tickDt * (float)BlockTicks(level[i]);
+                    ps.vx[i] += halfStep * a.x[i];
+                    ps.vy[i] += halfStep * a.y[i];
+                    ps.vz[i] += halfStep * a.z[i];
+                }
+                ps.x[i] += tickDt * ps.vx[i];
+                ps.y[i] += tickDt * ps.vy[i];
+                ps.z[i] += tickDt * ps.vz[i];
+            }
+        });
+
+        // Particles whose step ends after this tick
+        const unsigned int next = tick + 1;
+        active.clear();
+        for (unsigned int i = 0; i < ps.n; ++i)
+        {
+            if (next % BlockTicks(level[i]) == 0)
+                active.push_back(i);
+        }
+
+        // New forces, closing kick and new level of the active particles only
+        pool.Run([&](unsigned int t)
+        {
+            unsigned int start, end;
+            ChunkBounds(t, pool.Size(), (unsigned int)active.size(), &start, &end);
+            for (unsigned int k = start; k < end; ++k)
+            {
+                unsigned int i = active[k];
+                ComputeForceDirect(ps, i, &a.x[i], &a.y[i], &a.z[i]);
+                const float halfStep = 0.5f * tickDt * (float)BlockTicks(level[i]);
+                ps.vx[i] += halfStep * a.x[i];
+                ps.vy[i] += halfStep * a.y[i];
+                ps.vz[i] += halfStep * a.z[i];
+
+                // A coarser level must start on its own step grid
+                unsigned int wanted = BlockLevel(a.x[i], a.y[i], a.z[i]);
+                while (wanted < level[i] && next % BlockTicks(wanted) != 0)
+                    ++wanted;
+                level[i] = (unsigned char)wanted;
+            }
+        });
+        integratorState.forceEvaluations += active.size();
+    }
+    for (unsigned int i = 0; i < ps.n; ++i)
+        integratorState.finestLevel = max(integratorState.finestLevel, (unsigned int)level[i]);
+}
+
+/**
+ * @brief Advances ps by dt with the integrator chosen in PrepareIntegrator (not euler, which main runs
+ * through its own MoveChunk / UpdateChunkPosition path).
+ */
+void IntegratorStep(ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    switch (integratorState.kind)
+    {
+    case INTEGRATOR_LEAPFROG: StepLeapfrog(ps, pool); break;
+    case INTEGRATOR_RK4: StepRK4(ps, pool); break;
+    case INTEGRATOR_BLOCK: StepBlock(ps, pool); break;
+    default:
+        StartThreads(ps, MoveChunk, pool);
+        StartThreads(ps, UpdateChunkPosition, pool);
+        integratorState.forceEvaluations += ps.n;
+        break;
+    }
+    integratorState.steps++;
+}
+
+// Force evaluations per particle and step (1 = one direct-sum evaluation per step), and the block levels
+void PrintIntegratorReport(const ParticleSystem &ps)
+{
+    const IntegratorState &state = integratorState;
+    double perStep = (state.steps > 0) ? (double)state.forceEvaluations / ((double)ps.n * state.steps) : 0;
+    cout << "Integrator: " << integratorNames[state.kind] << ", " << state.steps << " steps, "
+         << state.forceEvaluations << " particle force evaluations (" << perStep << " per particle per step)" << endl;
+    if (state.kind == INTEGRATOR_BLOCK)
+    {
+        // Uniform stepping at the finest level used would cost 2^finest evaluations per particle per step
+        vector<unsigned int> histogram(blockConfig.maxLevel + 1, 0);
+        for (unsigned int i = 0; i < ps.n; ++i)
+            histogram[state.level[i]]++;
+        cout << "Final block levels (particles per level, step dt / 2^level):";
+        for (unsigned int l = 0; l <= blockConfig.maxLevel; ++l)
+            cout << ' ' << l << ':' << histogram[l];
+        cout << endl;
+        cout << "Uniform steps at the finest level reached (" << state.finestLevel << ") would cost "
+             << (1u << state.finestLevel) << " evaluations per particle per step" << endl;
+    }
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef NBODY_LAYOUT_HPP
+#define NBODY_LAYOUT_HPP
+
+#include "particle_system.hpp"
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: compile-time descriptions of the particle layouts, used as the Layout parameter of the force
+//            kernels in nbody_simd_kernel.inl. A layout only says where a coordinate lives: Open() turns the
+//            storage into a View of three base pointers, and coordinate `axis` of particle j is at
+//            view.axis[Offset(j)]. RUN is the number of consecutive particles whose coordinates are
+//            contiguous: the kernels load W particles with one aligned vector load when W <= RUN, and
+//            gather them lane by lane otherwise.
+
+//      Note: Offset() is always_inline: the kernels are compiled at -O2, and an ordinary function defined
+//            here would be compiled at the makefile's -O0 and called once per interaction.
+
+#define LAYOUT_INLINE __attribute__((always_inline)) static inline
+
+// This is a AoS - Array of Structs (the serial reference layout, 32 bytes per particle)
+struct ParticleType
+{
+    float x, y, z;
+    float vx, vy, vz;
+    float trash1, trash2;
+};
+
+// Runtime-sized, cache-line aligned AoS storage for the serial reference
+typedef AlignedBuffer<ParticleType> SerialParticles;
+
+// Particles per AoSoA packet: one AVX register of floats
+const unsigned int PACKET_LANES = 8;
+
+// PACKET_LANES particles, coordinate-major: 192 bytes, three whole cache lines
+struct alignas(CACHE_LINE) ParticlePacket
+{
+    float x[PACKET_LANES], y[PACKET_LANES], z[PACKET_LANES];
+    float vx[PACKET_LANES], vy[PACKET_LANES], vz[PACKET_LANES];
+};
+
+// This is a AoSoA - Array of Structs of Arrays: one stream of packets instead of six arrays. A vector of
+// x's is still one aligned load, and the positions of 8 particles share the cache lines of their velocities.
+// Lanes past n in the last packet are zero and never read as particles.
+class AosoaParticles
+{
+public:
+    explicit AosoaParticles(unsigned int n) : n(n), packets((n + PACKET_LANES - 1) / PACKET_LANES) {}
+
+    // Given an index, and a pointer, fills pointer p with particle[i]'s credentials
+    void Get(unsigned int i, OneParticle *p) const
+    {
+        const ParticlePacket &packet = packets[i / PACKET_LANES];
+        const unsigned int l = i % PACKET_LANES;
+        p->x = packet.x[l];
+        p->y = packet.y[l];
+        p->z = packet.z[l];
+        p->vx = packet.vx[l];
+        p->vy = packet.vy[l];
+        p->vz = packet.vz[l];
+    }
+
+    void Set(unsigned int i, const OneParticle &p)
+    {
+        ParticlePacket &packet = packets[i / PACKET_LANES];
+        const unsigned int l = i % PACKET_LANES;
+        packet.x[l] = p.x;
+        packet.y[l] = p.y;
+        packet.z[l] = p.z;
+        packet.vx[l] = p.vx;
+        packet.vy[l] = p.vy;
+        packet.vz[l] = p.vz;
+    }
+
+    unsigned int Packets() const { return packets.Size(); }
+    ParticlePacket *Data() { return packets.Data(); }
+    const ParticlePacket *Data() const { return packets.Data(); }
+
+    const unsigned int n; // number of particles
+
+private:
+    AlignedBuffer<ParticlePacket> packets;
+};
+
+// Base pointers of the three position coordinates, and the particle count
+struct LayoutView
+{
+    const float *x, *y, *z;
+    unsigned int n;
+};
+
+// Six separate arrays (ParticleSystem): every coordinate array is contiguous and 64-byte aligned
+struct SoaLayout
+{
+    typedef ParticleSystem Source;
+    static const unsigned int RUN = ~0u;
+    static LayoutView Open(const Source &ps) { return LayoutView{ps.x, ps.y, ps.z, ps.n}; }
+    LAYOUT_INLINE unsigned int Offset(unsigned int j) { return j; }
+};
+
+// ParticleType structs: consecutive x's are 8 floats apart, every vector load is a gather
+struct AosLayout
+{
+    typedef SerialParticles Source;
+    static const unsigned int RUN = 1;
+    static LayoutView Open(const Source &particles)
+    {
+        const ParticleType *p = particles.Data();
+        return LayoutView{&p->x, &p->y, &p->z, particles.Size()};
+    }
+    LAYOUT_INLINE unsigned int Offset(unsigned int j) { return j * (unsigned int)(sizeof(ParticleType) / sizeof(float)); }
+};
+
+// ParticlePacket stream: vectors of up to PACKET_LANES particles are one aligned load inside a packet,
+// wider ones (AVX-512) are assembled from consecutive packets
+struct AosoaLayout
+{
+    typedef AosoaParticles Source;
+    static const unsigned int RUN = PACKET_LANES;
+    static LayoutView Open(const Source &particles)
+    {
+        const ParticlePacket *p = particles.Data();
+        return LayoutView{p->x, p->y, p->z, particles.n};
+    }
+    LAYOUT_INLINE unsigned int Offset(unsigned int j)
+    {
+        return j / PACKET_LANES * (unsigned int)(sizeof(ParticlePacket) / sizeof(float)) + j % PACKET_LANES;
+    }
+};
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef NBODY_MORTON_HPP
+#define NBODY_MORTON_HPP
+
+#include "nbody_parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: the initial conditions leave neighbouring indices far apart in space (the lattice's
+//            i % 15, i * i % 15, ..., and the independent random draws of nbody_ic.hpp), so consecutive
+//            particles of a chunk walk unrelated paths of the octree and touch unrelated cells.
+//            ReorderMorton() sorts all six arrays by the Z-order (Morton) key of the position: particles
+//            close in space become close in memory, and the particles of one chunk share most of their
+//            tree nodes and neighbour cells. Positions drift slowly, so sorting every few steps is enough.
+
+//      Note: keys are 30 bits (10 bits per axis over the cubic bounding box), sorted by a parallel LSD radix
+//            sort: 4 passes of 8 bits, each one a per-thread histogram, a serial prefix sum over
+//            (digit, thread) and a stable per-thread scatter. Particles with equal keys keep their order.
+
+//      Note: mortonState.original[s] is the original index of the particle in slot s. Anything written out
+//            (result files, snapshots, trajectories) goes through MortonOriginalOrder() so files keep the
+//            original particle order. The reordered sums run in a different order, so results match a run
+//            without reordering to rounding, not bit for bit.
+
+const unsigned int MORTON_BITS_PER_AXIS = 10;
+const unsigned int RADIX_DIGIT_BITS = 8;
+const unsigned int RADIX_BUCKETS = 1u << RADIX_DIGIT_BITS;
+const unsigned int RADIX_PASSES = 4; // 3 * MORTON_BITS_PER_AXIS bits, rounded up to whole digits
+
+struct MortonState
+{
+    vector<unsigned int> original;          // original index of the particle in each slot
+    vector<uint32_t> keys[2];               // radix sort ping-pong buffers
+    vector<unsigned int> slots[2];          // current slot of each key
+    vector<unsigned int> offsets;           // per-thread bucket offsets, thread-major
+    vector<float> bounds;                   // per-thread bounding boxes, 6 floats each
+    unique_ptr<ParticleSystem> scratch;     // gather target of the reorder, original-order output copy
+    unsigned int reorders = 0;
+    double sortMs = 0;                      // keys + radix sort
+    double permuteMs = 0;                   // gathering the arrays into the new order
+};
+
+MortonState mortonState;
+
+// Spreads the low 10 bits of v to every third bit (bit k goes to bit 3k)
+inline uint32_t SpreadBits(uint32_t v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// Morton key of the cell (cx, cy, cz), x in the lowest bit
+inline uint32_t MortonKey(uint32_t cx, uint32_t cy, uint32_t cz)
+{
+    return SpreadBits(cx) | (SpreadBits(cy) << 1) | (SpreadBits(cz) << 2);
+}
+
+// Computes the Morton key of every particle into keys[0] (slots[0] = identity)
+void ComputeMortonKeys(const ParticleSystem &ps, ThreadPool &pool)
+{
+    MortonState &state = mortonState;
+    const unsigned int T = pool.Size();
+    state.bounds.resize(6 * (size_t)T);
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, T, ps.n, &start, &end);
+        float *b = &state.bounds[6 * (size_t)t];
+        b[0] = b[1] = b[2] = 1e30f;
+        b[3] = b[4] = b[5] = -1e30f;
+        for (unsigned int i = start; i < end; ++i)
+        {
+            b[0] = min(b[0], ps.x[i]);
+            b[1] = min(b[1], ps.y[i]);
+            b[2] = min(b[2], ps.z[i]);
+            b[3] = max(b[3], ps.x[i]);
+            b[4] = max(b[4], ps.y[i]);
+            b[5] = max(b[5], ps.z[i]);
+        }
+    });
+    float lo[3] = {1e30f, 1e30f, 1e30f}, hi[3] = {-1e30f, -1e30f, -1e30f};
+    for (unsigned int t = 0; t < T; ++t)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            lo[a] = min(lo[a], state.bounds[6 * (size_t)t + a]);
+            hi[a] = max(hi[a], state.bounds[6 * (size_t)t + 3 + a]);
+        }
+    }
+    float extent = max(hi[0] - lo[0], max(hi[1] - lo[1], hi[2] - lo[2]));
+    const float cells = (float)(1u << MORTON_BITS_PER_AXIS);
+    const float scale = (extent > 0) ? cells / extent : 0.0f;
+    const uint32_t top = (1u << MORTON_BITS_PER_AXIS) - 1;
+
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, T, ps.n, &start, &end);
+        for (unsigned int i = start; i < end; ++i)
+        {
+            uint32_t cx = min((uint32_t)((ps.x[i] - lo[0]) * scale), top);
+            uint32_t cy = min((uint32_t)((ps.y[i] - lo[1]) * scale), top);
+            uint32_t cz = min((uint32_t)((ps.z[i] - lo[2]) * scale), top);
+            state.keys[0][i] = MortonKey(cx, cy, cz);
+            state.slots[0][i] = i;
+        }
+    });
+}
+
+// Stable parallel LSD radix sort of (keys[0], slots[0]); the result ends in keys[0] / slots[0]
+void RadixSortKeys(unsigned int n, ThreadPool &pool)
+{
+    MortonState &state = mortonState;
+    const unsigned int T = pool.Size();
+    state.offsets.resize((size_t)T * RADIX_BUCKETS);
+    for (unsigned int pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        const unsigned int shift = pass * RADIX_DIGIT_BITS;
+        const vector<uint32_t> &keysIn = state.keys[pass & 1];
+        const vector<unsigned int> &slotsIn = state.slots[pass & 1];
+        vector<uint32_t> &keysOut = state.keys[(pass & 1) ^ 1];
+        vector<unsigned int> &slotsOut = state.slots[(pass & 1) ^ 1];
+
+        // Digit histogram of every thread's chunk
+        pool.Run([&](unsigned int t)
+        {
+            unsigned int *count = &state.offsets[(size_t)t * RADIX_BUCKETS];
+            fill(count, count + RADIX_BUCKETS, 0u);
+            unsigned int start, end;
+            ChunkBounds(t, T, n, &start, &end);
+            for (unsigned int i = start; i < end; ++i)
+                count[(keysIn[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+        });
+
+        // Exclusive prefix sum, digit-major then thread: each thread's run of a digit follows the previous thread's
+        unsigned int sum = 0;
+        for (unsigned int b = 0; b < RADIX_BUCKETS; ++b)
+        {
+            for (unsigned int t = 0; t < T; ++t)
+            {
+                unsigned int count = state.offsets[(size_t)t * RADIX_BUCKETS + b];
+                state.offsets[(size_t)t * RADIX_BUCKETS + b] = sum;
+                sum += count;
+            }
+        }
+
+        // Stable scatter
+        pool.Run([&](unsigned int t)
+        {
+            unsigned int *next = &state.offsets[(size_t)t * RADIX_BUCKETS];
+            unsigned int start, end;
+            ChunkBounds(t, T, n, &start, &end);
+            for (unsigned int i = start; i < end; ++i)
+            {
+                unsigned int slot = next[(keysIn[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+                keysOut[slot] = keysIn[i];
+                slotsOut[slot] = slotsIn[i];
+            }
+        });
+    }
+}
+
+// Sets the identity order for n particles (call before the first reorder)
+void ResetMortonOrder(unsigned int n)
+{
+    MortonState &state = mortonState;
+    state.original.resize(n);
+    for (unsigned int i = 0; i < n; ++i)
+        state.original[i] = i;
+    state.reorders = 0;
+    state.sortMs = state.permuteMs = 0;
+}
+
+/**
+ * @brief Sorts all particle arrays of ps in place by Morton key, and composes the permutation into
+ *        mortonState.original.
+ */
+void ReorderMorton(ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    MortonState &state = mortonState;
+    if (state.original.size() != ps.n)
+        ResetMortonOrder(ps.n);
+    for (int b = 0; b < 2; ++b)
+    {
+        state.keys[b].resize(ps.n);
+        state.slots[b].resize(ps.n);
+    }
+    if (!state.scratch || state.scratch->n != ps.n)
+        state.scratch.reset(new ParticleSystem(ps.n));
+
+    auto sortStart = chrono::high_resolution_clock::now();
+    ComputeMortonKeys(ps, pool);
+    RadixSortKeys(ps.n, pool);
+    auto sortEnd = chrono::high_resolution_clock::now();
+
+    // New slot s takes the particle of old slot order[s]; slots[1] is free after the sort
+    const vector<unsigned int> &order = state.slots[0];
+    vector<unsigned int> &original = state.slots[1];
+    ParticleSystem &scratch = *state.scratch;
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        for (unsigned int s = start; s < end; ++s)
+        {
+            unsigned int from = order[s];
+            scratch.x[s] = ps.x[from];
+            scratch.y[s] = ps.y[from];
+            scratch.z[s] = ps.z[from];
+            scratch.vx[s] = ps.vx[from];
+            scratch.vy[s] = ps.vy[from];
+            scratch.vz[s] = ps.vz[from];
+            original[s] = state.original[from];
+        }
+    });
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        size_t bytes = (end - start) * sizeof(float);
+        memcpy(ps.x + start, scratch.x + start, bytes);
+        memcpy(ps.y + start, scratch.y + start, bytes);
+        memcpy(ps.z + start, scratch.z + start, bytes);
+        memcpy(ps.vx + start, scratch.vx + start, bytes);
+        memcpy(ps.vy + start, scratch.vy + start, bytes);
+        memcpy(ps.vz + start, scratch.vz + start, bytes);
+    });
+    state.original.swap(original);
+    auto permuteEnd = chrono::high_resolution_clock::now();
+
+    state.reorders++;
+    state.sortMs += chrono::duration<double, milli>(sortEnd - sortStart).count();
+    state.permuteMs += chrono::duration<double, milli>(permuteEnd - sortEnd).count();
+}
+
+/**
+ * @brief ps in the original particle order: ps itself if it was never reordered, otherwise the scratch
+ *        copy with every particle scattered back to its original index (valid until the next reorder).
+ */
+const ParticleSystem &MortonOriginalOrder(const ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    MortonState &state = mortonState;
+    if (state.reorders == 0 || state.original.size() != ps.n)
+        return ps;
+    ParticleSystem &out = *state.scratch;
+    pool.Run([&](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        for (unsigned int s = start; s < end; ++s)
+        {
+            unsigned int to = state.original[s];
+            out.x[to] = ps.x[s];
+            out.y[to] = ps.y[s];
+            out.z[to] = ps.z[s];
+            out.vx[to] = ps.vx[s];
+            out.vy[to] = ps.vy[s];
+            out.vz[to] = ps.vz[s];
+        }
+    });
+    return out;
+}
+
+#endif
@@ -0,0 +1,421 @@
+#ifndef NBODY_NUMA_HPP
+#define NBODY_NUMA_HPP
+
+#include "nbody_parallel.hpp"
+#include "nbody_scheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: Linux places a page on the NUMA node of the thread that first writes it. The particle block
+//            is therefore allocated untouched and initialized by FirstTouchInit on the pool, each thread
+//            writing the same [start, end) chunk that StartThreads later hands it, so the velocities every
+//            thread updates are local.
+
+//      Note: positions are read by every thread in the force phase, so on a multi-socket machine half of
+//            the reads are remote whatever the placement. With replication, each node gets its own copy of
+//            x / y / z, refreshed after every position update by the threads of that node. The force
+//            kernel then runs on a non-owning ParticleSystem view: the node-local positions plus the
+//            shared velocity arrays, which each thread writes only inside its own chunk.
+
+//      Note: no libnuma dependency: the topology comes from /sys/devices/system/node, pinning uses
+//            pthread_setaffinity_np, and page placement is queried with the move_pages syscall.
+//            Without sysfs NUMA information everything is treated as one node.
+
+//      Note: node ids can be sparse, and nodes without an allowed CPU (taskset, cpusets) are left out,
+//            so the topology entries are indexed 0 .. count - 1 and nodeIds keeps the kernel id of each.
+//            move_pages reports kernel ids, mapped back to an entry by NodeIndex.
+
+enum PinPolicy
+{
+    PIN_NONE,    // leave placement to the scheduler
+    PIN_COMPACT, // thread t on the t-th CPU, filling one node before the next
+    PIN_SCATTER  // round-robin over nodes, spreading threads (and bandwidth) across sockets
+};
+
+bool ParsePinPolicy(const string &text, PinPolicy *policy)
+{
+    if (text == "none")
+        *policy = PIN_NONE;
+    else if (text == "compact")
+        *policy = PIN_COMPACT;
+    else if (text == "scatter")
+        *policy = PIN_SCATTER;
+    else
+        return false;
+    return true;
+}
+
+struct NumaTopology
+{
+    vector<int> nodeIds;          // kernel node id of each entry
+    vector<vector<int>> nodeCpus; // CPUs of each entry, only those this process may run on
+    vector<int> cpuNode;          // entry of each CPU id, -1 if unknown
+};
+
+// Parses a sysfs list such as "0-3,8-11" (a node's cpulist, or node/online)
+vector<int> ParseSysfsList(const string &text)
+{
+    vector<int> cpus;
+    stringstream stream(text);
+    string range;
+    while (getline(stream, range, ','))
+    {
+        if (range.empty() || range == "\n")
+            continue;
+        size_t dash = range.find('-');
+        int first = stoi(range.substr(0, dash));
+        int last = (dash == string::npos) ? first : stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Reads the node -> CPU map from sysfs, restricted to the process affinity mask
+NumaTopology DetectTopology()
+{
+    NumaTopology topology;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    ifstream online("/sys/devices/system/node/online");
+    string nodes;
+    if (online.is_open())
+        getline(online, nodes);
+    for (int node : ParseSysfsList(nodes))
+    {
+        ifstream list("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+        if (!list.is_open())
+            continue;
+        string text;
+        getline(list, text);
+        vector<int> cpus;
+        for (int cpu : ParseSysfsList(text))
+        {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        }
+        if (!cpus.empty())
+        {
+            topology.nodeIds.push_back(node);
+            topology.nodeCpus.push_back(cpus);
+        }
+    }
+
+    // No sysfs NUMA information: one node holding every allowed CPU
+    if (topology.nodeCpus.empty())
+    {
+        vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        }
+        topology.nodeIds.push_back(0);
+        topology.nodeCpus.push_back(cpus);
+    }
+
+    for (unsigned int node = 0; node < topology.nodeCpus.size(); ++node)
+    {
+        for (int cpu : topology.nodeCpus[node])
+        {
+            if ((int)topology.cpuNode.size() <= cpu)
+                topology.cpuNode.resize(cpu + 1, -1);
+            topology.cpuNode[cpu] = (int)node;
+        }
+    }
+    return topology;
+}
+
+// Entry of a kernel node id, -1 if the process has no CPU on that node
+inline int NodeIndex(const NumaTopology &topology, int id)
+{
+    vector<int>::const_iterator it = find(topology.nodeIds.begin(), topology.nodeIds.end(), id);
+    return (it == topology.nodeIds.end()) ? -1 : (int)(it - topology.nodeIds.begin());
+}
+
+// Entry of a CPU, 0 when unknown
+inline int NodeOfCpu(const NumaTopology &topology, int cpu)
+{
+    return (cpu >= 0 && cpu < (int)topology.cpuNode.size() && topology.cpuNode[cpu] >= 0) ? topology.cpuNode[cpu] : 0;
+}
+
+// CPU that pool thread t is pinned to under policy (threads beyond the CPU count wrap around)
+int PinnedCpu(const NumaTopology &topology, PinPolicy policy, unsigned int t)
+{
+    const unsigned int nodes = topology.nodeCpus.size();
+    if (policy == PIN_SCATTER)
+    {
+        const vector<int> &cpus = topology.nodeCpus[t % nodes];
+        return cpus[(t / nodes) % cpus.size()];
+    }
+    vector<int> all;
+    for (const vector<int> &cpus : topology.nodeCpus)
+        all.insert(all.end(), cpus.begin(), cpus.end());
+    return all[t % all.size()];
+}
+
+// Per-thread placement, filled by PinThreads and by every replica refresh
+struct ThreadPlacement
+{
+    int pinnedCpu = -1; // -1: not pinned
+    int cpu = -1;       // CPU observed at the last placement check
+    int node = 0;       // node used for the thread's replica
+};
+
+struct NumaState
+{
+    NumaTopology topology;
+    PinPolicy pin = PIN_NONE;
+    vector<ThreadPlacement> threads;
+    vector<float *> replicas;                     // per node: x | y | z, stride floats each
+    vector<unique_ptr<ParticleSystem>> views;     // per node: replica positions + shared velocities
+    vector<vector<unsigned int>> nodeThreads;     // pool threads of each node
+};
+
+NumaState numaState;
+
+/**
+ * @brief Detects the topology, and pins every pool thread (main thread = thread 0) under policy.
+ *
+ * Always records where each thread runs, so the placement report works without pinning too.
+ */
+void PinThreads(PinPolicy policy, ThreadPool &pool = WorkerPool())
+{
+    numaState.topology = DetectTopology();
+    numaState.pin = policy;
+    numaState.threads.assign(pool.Size(), ThreadPlacement());
+    pool.Run([policy](unsigned int t)
+    {
+        ThreadPlacement &placement = numaState.threads[t];
+        if (policy != PIN_NONE)
+        {
+            int cpu = PinnedCpu(numaState.topology, policy, t);
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+                placement.pinnedCpu = cpu;
+        }
+        placement.cpu = sched_getcpu();
+        placement.node = NodeOfCpu(numaState.topology, placement.pinnedCpu >= 0 ? placement.pinnedCpu : placement.cpu);
+    });
+}
+
+// Parallel first-touch initialization: every thread zeroes its own StartThreads chunk and fills it with `init`
+void FirstTouchInit(ParticleSystem &ps, ChunkFunction init = InitChunk, ThreadPool &pool = WorkerPool())
+{
+    pool.Run([&ps, init, &pool](unsigned int t)
+    {
+        // Same chunk for zeroing and init (chunks over stride and n do not line up); the last thread
+        // also clears the padding
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        unsigned int clearEnd = (t + 1 == pool.Size()) ? ps.stride : end;
+        float *arrays[6] = {ps.x, ps.y, ps.z, ps.vx, ps.vy, ps.vz};
+        for (float *array : arrays)
+            memset(array + start, 0, (clearEnd - start) * sizeof(float));
+        init(ps, start, end);
+    });
+}
+
+// Copies the master positions into every node replica; the threads of a node fill their own replica
+void RefreshReplicas(const ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    pool.Run([&ps](unsigned int t)
+    {
+        int node = numaState.threads[t].node;
+        const vector<unsigned int> &peers = numaState.nodeThreads[node];
+        unsigned int rank = find(peers.begin(), peers.end(), t) - peers.begin();
+        unsigned int start, end;
+        ChunkBounds(rank, peers.size(), ps.stride, &start, &end);
+        float *replica = numaState.replicas[node];
+        memcpy(replica + start, ps.x + start, (end - start) * sizeof(float));
+        memcpy(replica + ps.stride + start, ps.y + start, (end - start) * sizeof(float));
+        memcpy(replica + 2 * (size_t)ps.stride + start, ps.z + start, (end - start) * sizeof(float));
+    });
+}
+
+// Allocates one untouched x / y / z replica per node used by the pool, and its view. Call after PinThreads.
+void CreateReplicas(const ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    const unsigned int nodes = numaState.topology.nodeCpus.size();
+    numaState.nodeThreads.assign(nodes, vector<unsigned int>());
+    for (unsigned int t = 0; t < pool.Size(); ++t)
+        numaState.nodeThreads[numaState.threads[t].node].push_back(t);
+
+    numaState.replicas.assign(nodes, nullptr);
+    numaState.views.clear();
+    for (unsigned int node = 0; node < nodes; ++node)
+    {
+        if (!numaState.nodeThreads[node].empty())
+            numaState.replicas[node] = (float *)AllocateAligned(3 * (size_t)ps.stride * sizeof(float), false);
+        float *replica = numaState.replicas[node];
+        numaState.views.emplace_back(replica == nullptr ? nullptr
+                                                        : new ParticleSystem(ps, replica, replica + ps.stride, replica + 2 * (size_t)ps.stride));
+    }
+    RefreshReplicas(ps, pool);
+}
+
+void FreeReplicas()
+{
+    numaState.views.clear();
+    for (float *replica : numaState.replicas)
+        free(replica);
+    numaState.replicas.clear();
+}
+
+// StartThreadsStatic on the node-local views: thread t computes its chunk from its node's position replica
+void StartThreadsReplicated(ChunkFunction func, ThreadPool &pool = WorkerPool())
+{
+    PrepareScheduler(pool);
+    auto phaseStart = chrono::high_resolution_clock::now();
+    pool.Run([func, &pool](unsigned int t)
+    {
+        ParticleSystem &view = *numaState.views[numaState.threads[t].node];
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), view.n, &start, &end);
+        auto taskStart = chrono::high_resolution_clock::now();
+        func(view, start, end);
+        auto taskEnd = chrono::high_resolution_clock::now();
+        threadStats[t].phaseBusyMs = chrono::duration<double, milli>(taskEnd - taskStart).count();
+        threadStats[t].tasks++;
+    });
+    auto phaseEnd = chrono::high_resolution_clock::now();
+    AccumulatePhaseStats(chrono::duration<double, milli>(phaseEnd - phaseStart).count());
+}
+
+// Counts the pages of [data, data + bytes) on each topology entry (move_pages query mode). The last count
+// holds pages that are not present or sit on a node outside the topology.
+vector<unsigned long> PagesPerNode(const void *data, size_t bytes, const NumaTopology &topology)
+{
+    const unsigned int nodes = topology.nodeIds.size();
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)data / page * page;
+    uintptr_t last = ((uintptr_t)data + bytes + page - 1) / page * page;
+    vector<void *> pages;
+    for (uintptr_t p = first; p < last; p += page)
+        pages.push_back((void *)p);
+    vector<int> status(pages.size(), -1);
+    vector<unsigned long> counts(nodes + 1, 0); // last entry: not present / query failed
+    if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0)
+    {
+        counts[nodes] = pages.size();
+        return counts;
+    }
+    for (int s : status)
+    {
+        int node = (s >= 0) ? NodeIndex(topology, s) : -1;
+        counts[(node >= 0) ? node : nodes]++;
+    }
+    return counts;
+}
+
+void PrintPageRow(const string &label, const void *data, size_t bytes, const NumaTopology &topology)
+{
+    vector<unsigned long> counts = PagesPerNode(data, bytes, topology);
+    cout << left << setw(22) << label << right;
+    for (unsigned int node = 0; node < counts.size(); ++node)
+        cout << setw(10) << counts[node];
+    cout << endl;
+}
+
+// Bytes of [data, data + bytes) in transparent huge pages: AnonHugePages of the /proc/self/smaps mapping holding data
+size_t TransparentHugeBytes(const void *data)
+{
+    ifstream smaps("/proc/self/smaps");
+    string line;
+    bool inside = false;
+    while (getline(smaps, line))
+    {
+        // Mapping headers start with "start-end", the fields below them with a name and a colon
+        size_t dash = line.find('-');
+        size_t space = line.find(' ');
+        if (dash != string::npos && space != string::npos && dash < space && line.find(':') > space)
+        {
+            uintptr_t start = stoull(line.substr(0, dash), nullptr, 16);
+            uintptr_t end = stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16);
+            inside = (uintptr_t)data >= start && (uintptr_t)data < end;
+        }
+        else if (inside && line.compare(0, 14, "AnonHugePages:") == 0)
+        {
+            return (size_t)stoull(line.substr(14)) * 1024;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Page backing of one block (`name`): what it got for --huge-pages, how much of it the kernel actually
+ *        put in 2 MB pages, and why it got less than requested.
+ */
+void PrintPageReport(const char *name, const ParticleSystem &ps)
+{
+    const char *descriptions[PAGES_COUNT] = {"4 KB pages", "transparent huge pages (madvise)", "hugetlbfs 2 MB pages"};
+    const double MB = 1024.0 * 1024.0;
+    const size_t huge = (ps.BlockBytes() + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES; // pages of the rounded mapping
+    cout << name << ": " << fixed << setprecision(2) << ps.BlockBytes() / MB << " MB, " << descriptions[ps.Pages()];
+    if (ps.Pages() == PAGES_THP)
+        cout << ", " << TransparentHugeBytes(ps.x) / MB << " of " << huge * HUGE_PAGE_BYTES / MB << " MB mapped in huge pages";
+    else if (ps.Pages() == PAGES_HUGETLB)
+        cout << ", " << huge << " huge pages";
+    if (pageConfig.requested != PAGES_SMALL && ps.BlockBytes() < HUGE_PAGE_BYTES && !ps.IsMapped())
+        cout << " (smaller than one huge page)";
+    if (!ps.PageFallback().empty())
+        cout << " (fallback: " << ps.PageFallback() << ")";
+    cout << defaultfloat << endl;
+}
+
+// Placement report: topology, thread -> CPU / node, and the node of the particle and replica pages
+void PrintNumaReport(const ParticleSystem &ps)
+{
+    const NumaTopology &topology = numaState.topology;
+    const unsigned int nodes = topology.nodeCpus.size();
+    cout << "NUMA nodes: " << nodes << endl;
+    for (unsigned int node = 0; node < nodes; ++node)
+        cout << "  node " << topology.nodeIds[node] << ": " << topology.nodeCpus[node].size() << " CPUs" << endl;
+
+    const char *pinNames[] = {"none", "compact", "scatter"};
+    cout << "Thread placement (pinning: " << pinNames[numaState.pin] << ")" << endl;
+    cout << left << setw(8) << "thread" << right << setw(8) << "pinned" << setw(8) << "cpu" << setw(8) << "node" << endl;
+    for (unsigned int t = 0; t < numaState.threads.size(); ++t)
+    {
+        const ThreadPlacement &placement = numaState.threads[t];
+        cout << left << setw(8) << t << right << setw(8)
+             << (placement.pinnedCpu >= 0 ? to_string(placement.pinnedCpu) : string("-"))
+             << setw(8) << placement.cpu << setw(8) << topology.nodeIds[placement.node] << endl;
+    }
+
+    cout << "Page placement" << endl;
+    cout << left << setw(22) << "array" << right;
+    for (unsigned int node = 0; node < nodes; ++node)
+        cout << setw(10) << ("node " + to_string(topology.nodeIds[node]));
+    cout << setw(10) << "other" << endl;
+    const size_t arrayBytes = (size_t)ps.stride * sizeof(float);
+    PrintPageRow("positions x|y|z", ps.x, 3 * arrayBytes, topology);
+    PrintPageRow("velocities vx|vy|vz", ps.vx, 3 * arrayBytes, topology);
+    for (unsigned int node = 0; node < numaState.replicas.size(); ++node)
+    {
+        if (numaState.replicas[node] != nullptr)
+            PrintPageRow("replica node " + to_string(topology.nodeIds[node]), numaState.replicas[node], 3 * arrayBytes, topology);
+    }
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef NBODY_OUTPUT_HPP
+#define NBODY_OUTPUT_HPP
+
+#include "nbody_snapshot.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: trajectory dumps (--dump-every K) would stall every worker if written synchronously.
+//            Instead, the main thread copies the positions into one of two staging buffers at the end of
+//            a step, and a background writer thread serializes the buffer while the next force phase runs.
+//            The main thread only blocks if both buffers are still waiting to be written, i.e. when I/O
+//            is slower than K steps of compute.
+
+//      Note: trajectory format (.nbt): a sequence of frames, each one written with a single write():
+//              [ 64-byte TrajectoryFrameHeader ][ x[n] | y[n] | z[n] ]
+//            Frames have a fixed size, so frame k is at offset k * (64 + 12 * n).
+
+const char TRAJECTORY_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'T', 'R', 'J'};
+const uint32_t TRAJECTORY_VERSION = 1;
+
+struct TrajectoryFrameHeader
+{
+    char magic[8];    // TRAJECTORY_MAGIC
+    uint32_t version; // TRAJECTORY_VERSION
+    uint32_t n;       // particles in the frame
+    uint64_t step;    // step after which the positions were taken
+    float dt;
+    uint8_t padding[36];
+};
+
+static_assert(sizeof(TrajectoryFrameHeader) == CACHE_LINE, "frame header must be one cache line");
+
+// Time accounting of the output stage, in milliseconds
+struct OutputStats
+{
+    unsigned long frames = 0;
+    size_t bytes = 0;
+    double copyMs = 0;    // main thread: copying positions into staging
+    double blockedMs = 0; // main thread: waiting for a free staging buffer
+    double drainMs = 0;   // main thread: waiting for the last frames at the end of the run
+    double writeMs = 0;   // writer thread: serializing frames
+};
+
+// Double-buffered trajectory writer with one background thread
+class AsyncTrajectoryWriter
+{
+public:
+    AsyncTrajectoryWriter(const string &path, unsigned int n)
+        : n(n), frameBytes(sizeof(TrajectoryFrameHeader) + 3 * (size_t)n * sizeof(float)),
+          nextSubmit(0), stopping(false), failed(false)
+    {
+        for (Staging &buffer : buffers)
+        {
+            buffer.frame = nullptr;
+            buffer.full = false;
+        }
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            error = "cannot create " + path + ": " + strerror(errno);
+            failed = true;
+            return;
+        }
+        for (Staging &buffer : buffers)
+            buffer.frame = (char *)AllocateAligned(frameBytes);
+        writer = thread(&AsyncTrajectoryWriter::WriterLoop, this);
+    }
+
+    ~AsyncTrajectoryWriter()
+    {
+        Finish();
+        for (Staging &buffer : buffers)
+            free(buffer.frame);
+    }
+
+    AsyncTrajectoryWriter(const AsyncTrajectoryWriter &) = delete;
+    AsyncTrajectoryWriter &operator=(const AsyncTrajectoryWriter &) = delete;
+
+    // Stages the positions of ps after `step` and returns; the write happens in the background.
+    // Returns false if the writer failed (see Error()).
+    bool Submit(const ParticleSystem &ps, uint64_t step)
+    {
+        if (fd < 0)
+            return false;
+        Staging &buffer = buffers[nextSubmit];
+
+        // Wait until the writer released this buffer (only when two frames are pending)
+        auto waitStart = chrono::high_resolution_clock::now();
+        {
+            unique_lock<mutex> lock(m);
+            cv.wait(lock, [&] { return !buffer.full || failed; });
+            if (failed)
+                return false;
+        }
+        auto copyStart = chrono::high_resolution_clock::now();
+
+        // The writer does not touch a buffer that is not full, so the copy needs no lock
+        TrajectoryFrameHeader header = {};
+        memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+        header.version = TRAJECTORY_VERSION;
+        header.n = n;
+        header.step = step;
+        header.dt = dt;
+        memcpy(buffer.frame, &header, sizeof(header));
+        float *positions = (float *)(buffer.frame + sizeof(header));
+        memcpy(positions, ps.x, n * sizeof(float));
+        memcpy(positions + n, ps.y, n * sizeof(float));
+        memcpy(positions + 2 * (size_t)n, ps.z, n * sizeof(float));
+        auto copyEnd = chrono::high_resolution_clock::now();
+
+        {
+            lock_guard<mutex> lock(m);
+            buffer.full = true;
+            stats.blockedMs += chrono::duration<double, milli>(copyStart - waitStart).count();
+            stats.copyMs += chrono::duration<double, milli>(copyEnd - copyStart).count();
+        }
+        cv.notify_all();
+        nextSubmit ^= 1;
+        return true;
+    }
+
+    // Waits for the pending frames, stops the writer thread and closes the file. Idempotent.
+    void Finish()
+    {
+        if (!writer.joinable())
+            return;
+        auto drainStart = chrono::high_resolution_clock::now();
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        writer.join();
+        auto drainEnd = chrono::high_resolution_clock::now();
+        stats.drainMs += chrono::duration<double, milli>(drainEnd - drainStart).count();
+        if (close(fd) != 0 && !failed)
+        {
+            error = string("cannot close trajectory: ") + strerror(errno);
+            failed = true;
+        }
+        fd = -1;
+    }
+
+    bool Failed() const { return failed; }
+    const string &Error() const { return error; }
+    const OutputStats &Stats() const { return stats; }
+
+    // Writer time the main thread did not wait for (the compute it overlapped with)
+    double HiddenMs() const
+    {
+        double hidden = stats.writeMs - stats.blockedMs - stats.drainMs;
+        return hidden > 0 ? hidden : 0;
+    }
+
+private:
+    struct Staging
+    {
+        char *frame; // header + x | y | z
+        bool full;   // staged and not yet written, guarded by m
+    };
+
+    void WriterLoop()
+    {
+        unsigned int nextWrite = 0;
+        while (true)
+        {
+            Staging &buffer = buffers[nextWrite];
+            {
+                unique_lock<mutex> lock(m);
+                cv.wait(lock, [&] { return buffer.full || stopping; });
+                if (!buffer.full)
+                    return; // stopping and nothing left to write
+            }
+
+            auto start = chrono::high_resolution_clock::now();
+            bool ok = WriteFully(fd, buffer.frame, frameBytes);
+            auto end = chrono::high_resolution_clock::now();
+
+            {
+                lock_guard<mutex> lock(m);
+                stats.writeMs += chrono::duration<double, milli>(end - start).count();
+                if (ok)
+                {
+                    stats.frames++;
+                    stats.bytes += frameBytes;
+                }
+                else
+                {
+                    error = string("cannot write trajectory: ") + strerror(errno);
+                    failed = true;
+                }
+                buffer.full = false;
+            }
+            cv.notify_all();
+            if (!ok)
+                return;
+            nextWrite ^= 1;
+        }
+    }
+
+    const unsigned int n;
+    const size_t frameBytes;
+    int fd;
+    Staging buffers[2];
+    unsigned int nextSubmit; // main thread only
+
+    mutex m;
+    condition_variable cv;
+    bool stopping;
+    bool failed;
+    string error;
+    OutputStats stats;
+    thread writer;
+};
+
+#endif
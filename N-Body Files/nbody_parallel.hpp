@@ -1,7 +1,13 @@
+#ifndef NBODY_PARALLEL_HPP
+#define NBODY_PARALLEL_HPP
+
 #include <cmath>
+#include <string>
 #include <thread>
 #include <vector>
-#include <immintrin.h>
+#include "nbody_simd.hpp"
+#include "particle_system.hpp"
+#include "thread_pool.hpp"
 using namespace std;
 
 
@@ -10,153 +16,159 @@ using namespace std;
 
 //      Note: this code runs 56x faster than the original, due to cache optimization, vectorization (AVX2) and multi-threading.
 
-//      Note: __m256 needs to be supported to run this (AVX2)
+//      Note: the force kernel comes in SSE / AVX / AVX2 / AVX-512 variants (nbody_simd.hpp),
+//            the widest one the CPU supports is picked at startup.
 
-//      Note: 256 = 32 bytes = 8 floats/ints
+//      Note: 256 = 32 bytes = 8 floats/ints, 512 = 16 floats
 
-//      Note: This means unit stride of 8 per vector
+//      Note: This means unit stride of 8 (16) per vector
 
-#ifndef N_BODY_CONSTS
-#define N_BODY_CONSTS
-// Simulation parameters
-const int nParticles = 16384 * 2;
-const float dt = 0.01f;
-const float softening = 1e-20f;
+// Note: notice how we moved from a particle array to coords arrays, in order to improve cache locality.
+//       The SoA arrays live in a ParticleSystem (particle_system.hpp) that every kernel takes as a parameter.
 
-// Particle definition (not used here but left for consistency)
-typedef struct
+// Force precision: EXACT uses sqrt + div, FAST uses rsqrt + one Newton-Raphson step (+ FMA where available)
+enum ForcePrecision
 {
-    float x, y, z, vx, vy, vz;
-} OneParticle;
-#endif 
+    PRECISION_EXACT,
+    PRECISION_FAST
+};
+ForcePrecision forcePrecision = PRECISION_EXACT;
 
-// Note: notice how we moved from a particle array to coords arrays, in order to improve cache locality.
+// Parses "exact" or "fast", returns false for unknown names
+bool ParseForcePrecision(const string &text, ForcePrecision *precision)
+{
+    if (text == "exact")
+    {
+        *precision = PRECISION_EXACT;
+        return true;
+    }
+    if (text == "fast")
+    {
+        *precision = PRECISION_FAST;
+        return true;
+    }
+    return false;
+}
 
-// This is a SoA - Struct of Arrays, which allows us to better utilize cache locality during vectorization
-// Global arrays for particle positions and velocities
-float global_X[nParticles];
-float global_Y[nParticles];
-float global_Z[nParticles];
-float global_Vx[nParticles];
-float global_Vy[nParticles];
-float global_Vz[nParticles];
-
-// Preloaded SIMD vectors for constants
-__m256 zeroVector = _mm256_set1_ps(0.0f);
-__m256 oneVector = _mm256_set1_ps(1.0f);
-__m256 dtVector = _mm256_set1_ps(dt);
-__m256 softVector = _mm256_set1_ps(softening);
+// Accumulation mode of the force kernels (ForceAccumulation, nbody_simd.hpp)
+ForceAccumulation forceAccumulation = ACCUM_FLOAT;
+
+// Parses "float", "kahan" or "double", returns false for unknown names
+bool ParseForceAccumulation(const string &text, ForceAccumulation *accumulation)
+{
+    for (int a = 0; a < ACCUM_COUNT; ++a)
+    {
+        if (text == accumulationNames[a])
+        {
+            *accumulation = (ForceAccumulation)a;
+            return true;
+        }
+    }
+    return false;
+}
 
 // Threading configuration
 const unsigned int NUM_THREADS = thread::hardware_concurrency(); // Detect number of CPU cores, originally designed for 12 cores, 24 threads.
-const unsigned int CHUNK_SIZE = nParticles / NUM_THREADS;        // Divide work evenly across threads
+unsigned int poolThreads = NUM_THREADS; // Size of WorkerPool(), overridden by --threads before its first use
 
 // Initializes particle positions and velocities in parallel
-void InitChunk(unsigned int start, unsigned int end)
+void InitChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
 {
     for (unsigned int i = start; i < end; ++i)
     {
-        global_X[i] = (float)(i % 15);
-        global_Y[i] = (float)((i * i) % 15);
-        global_Z[i] = (float)((i * i * 3) % 15);
-        global_Vx[i] = 0.0f;
-        global_Vy[i] = 0.0f;
-        global_Vz[i] = 0.0f;
+        ps.x[i] = (float)(i % 15);
+        ps.y[i] = (float)((i * i) % 15);
+        ps.z[i] = (float)((i * i * 3) % 15);
+        ps.vx[i] = 0.0f;
+        ps.vy[i] = 0.0f;
+        ps.vz[i] = 0.0f;
     }
 }
 
+// Direct-sum force on particle i from all particles (O(N) per particle, vectorized over j),
+// computed by the active SIMD backend in the active precision and accumulation mode
+inline void ComputeForceDirect(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz)
+{
+    const ForceBackend &backend = forceBackends[activeBackend];
+    ForceFunction force = (forcePrecision == PRECISION_FAST) ? backend.fast[forceAccumulation] : backend.exact[forceAccumulation];
+    force(ps, i, Fx, Fy, Fz);
+}
+
+// Direct-sum force of all particles of src at (xi, yi, zi), active backend, precision and accumulation mode
+inline void ComputeForceAt(const ParticleSystem &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz)
+{
+    const ForceBackend &backend = forceBackends[activeBackend];
+    PointForceFunction force = (forcePrecision == PRECISION_FAST) ? backend.fastAt[forceAccumulation] : backend.exactAt[forceAccumulation];
+    force(src, xi, yi, zi, Fx, Fy, Fz);
+}
+
 // Calculates forces on particles and updates velocities in parallel
-void MoveChunk(unsigned int start, unsigned int end)
+void MoveChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
 {
     for (unsigned int i = start; i < end; ++i)
     {
         // Accumulated force components for particle i
         float Fx = 0, Fy = 0, Fz = 0;
-        __m256 FxVector = zeroVector;
-        __m256 FyVector = zeroVector;
-        __m256 FzVector = zeroVector;
-
-        // Load current particle position as SIMD vector
-        __m256 PixVector = _mm256_set1_ps(global_X[i]);
-        __m256 PiyVector = _mm256_set1_ps(global_Y[i]);
-        __m256 PizVector = _mm256_set1_ps(global_Z[i]);
-
-        // Iterate over all particles in vectorized blocks of 8
-        for (unsigned int j = 0; j < nParticles; j += 8)
-        {
-            // Load positions of 8 particles
-            __m256 PjxVector = _mm256_loadu_ps(&global_X[j]);
-            __m256 PjyVector = _mm256_loadu_ps(&global_Y[j]);
-            __m256 PjzVector = _mm256_loadu_ps(&global_Z[j]);
-
-            // Compute displacement vectors
-            __m256 dx = _mm256_sub_ps(PjxVector, PixVector);
-            __m256 dy = _mm256_sub_ps(PjyVector, PiyVector);
-            __m256 dz = _mm256_sub_ps(PjzVector, PizVector);
-
-            // Compute squared distance + softening
-            __m256 dx2 = _mm256_mul_ps(dx, dx);
-            __m256 dy2 = _mm256_mul_ps(dy, dy);
-            __m256 dz2 = _mm256_mul_ps(dz, dz);
-            
-            
-            // denominator calcs (this is dumb but refactor later)
-            __m256 temp1 = _mm256_add_ps(dx2, softVector);
-            __m256 temp2 = _mm256_add_ps(dy2, dz2);
-            __m256 temp3 = _mm256_add_ps(temp1, temp2);
-            __m256 distSqr = _mm256_sqrt_ps(temp3);
-
-            // Compute 1 / distance and its cube
-            __m256 invDist = _mm256_div_ps(oneVector, distSqr);
-            __m256 invDist3 = _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist));
-
-            // Accumulate forces
-            FxVector = _mm256_add_ps(FxVector, _mm256_mul_ps(dx, invDist3));
-            FyVector = _mm256_add_ps(FyVector, _mm256_mul_ps(dy, invDist3));
-            FzVector = _mm256_add_ps(FzVector, _mm256_mul_ps(dz, invDist3));
-        }
-
-        // Unpack SIMD accumulations to scalar
-        float *TempArray = (float *)&FxVector;
-        Fx = TempArray[0] + TempArray[1] + TempArray[2] + TempArray[3] +
-             TempArray[4] + TempArray[5] + TempArray[6] + TempArray[7];
-
-        TempArray = (float *)&FyVector;
-        Fy = TempArray[0] + TempArray[1] + TempArray[2] + TempArray[3] +
-             TempArray[4] + TempArray[5] + TempArray[6] + TempArray[7];
-
-        TempArray = (float *)&FzVector;
-        Fz = TempArray[0] + TempArray[1] + TempArray[2] + TempArray[3] +
-             TempArray[4] + TempArray[5] + TempArray[6] + TempArray[7];
+        ComputeForceDirect(ps, i, &Fx, &Fy, &Fz);
 
         // Update particle velocity using computed forces
-        global_Vx[i] += dt * Fx;
-        global_Vy[i] += dt * Fy;
-        global_Vz[i] += dt * Fz;
+        ps.vx[i] += dt * Fx;
+        ps.vy[i] += dt * Fy;
+        ps.vz[i] += dt * Fz;
     }
 }
 
 // Updates particle positions based on their velocities in parallel
-void UpdateChunkPosition(unsigned int start, unsigned int end)
+void UpdateChunkPosition(ParticleSystem &ps, unsigned int start, unsigned int end)
 {
     for (unsigned int i = start; i < end; ++i)
     {
-        global_X[i] += global_Vx[i] * dt;
-        global_Y[i] += global_Vy[i] * dt;
-        global_Z[i] += global_Vz[i] * dt;
+        ps.x[i] += ps.vx[i] * dt;
+        ps.y[i] += ps.vy[i] * dt;
+        ps.z[i] += ps.vz[i] * dt;
     }
 }
 
 
-// Generic parallel execution helper for any chunked operation
-void StartThreads(void (*func)(unsigned int, unsigned int))
+// Long-lived worker pool shared by all phases, created on first use (main creates it at startup)
+ThreadPool &WorkerPool()
+{
+    static ThreadPool pool(poolThreads);
+    return pool;
+}
+
+// Signature shared by all chunked kernels: (particles, first index, one past last index)
+typedef void (*ChunkFunction)(ParticleSystem &, unsigned int, unsigned int);
+
+// Returns the [start, end) range of chunk t out of n items, the last chunk takes the remainder
+void ChunkBounds(unsigned int t, unsigned int nChunks, unsigned int n, unsigned int *start, unsigned int *end)
+{
+    unsigned int chunk = n / nChunks;
+    *start = t * chunk;
+    *end = (t == nChunks - 1) ? n : *start + chunk;
+}
+
+// Generic parallel execution helper for any chunked operation, runs on the parked pool threads
+void StartThreads(ParticleSystem &ps, ChunkFunction func, ThreadPool &pool = WorkerPool())
+{
+    pool.Run([&ps, func, &pool](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        func(ps, start, end);
+    });
+}
+
+// Original spawn/join model: creates and joins nThreads threads per call.
+// Kept as the baseline for bench_pool.exe
+void StartThreadsSpawn(ParticleSystem &ps, ChunkFunction func, unsigned int nThreads = NUM_THREADS)
 {
     vector<thread> threads;
-    for (unsigned int t = 0; t < NUM_THREADS; ++t)
+    for (unsigned int t = 0; t < nThreads; ++t)
     {
-        unsigned int start = t * CHUNK_SIZE;
-        unsigned int end = (t == NUM_THREADS - 1) ? nParticles : start + CHUNK_SIZE;
-        threads.emplace_back(func, start, end);
+        unsigned int start, end;
+        ChunkBounds(t, nThreads, ps.n, &start, &end);
+        threads.emplace_back(func, ref(ps), start, end);
     }
 
     for (auto &th : threads)
@@ -164,3 +176,5 @@ void StartThreads(void (*func)(unsigned int, unsigned int))
         th.join();
     }
 }
+
+#endif
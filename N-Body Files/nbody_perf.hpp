@@ -0,0 +1,286 @@
+#ifndef NBODY_PERF_HPP
+#define NBODY_PERF_HPP
+
+#include "particle_system.hpp"
+#include "thread_pool.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: in-process hardware counters through perf_event_open, instead of perf record on the whole
+//            run. Every pool thread opens its own counters (pid = 0: the calling thread, any CPU, user
+//            space only), so each thread reads exactly its own work.
+
+//      Note: PerfRunPhase(phase, body) brackets body with two extra phases of the pool given to PerfInit(),
+//            in which every thread reads its counters; the difference is added to (phase, thread).
+//            Any body works: pool kernels (StartThreads, MoveSymmetric) and main-thread work (octree
+//            build, output) alike, the latter showing up on thread 0. The bracketing costs two barrier
+//            rounds (microseconds) per phase.
+
+//      Note: events are opened one by one (not as a group), so an event the CPU or hypervisor does not
+//            expose is reported as n/a while the others still count. If no event opens at all
+//            (perf_event_paranoid, containers, no PMU), PerfInit() returns false and every PerfRunPhase
+//            simply runs body. Counts are scaled by time_enabled / time_running when the kernel multiplexes.
+
+enum PerfEventId
+{
+    PERF_TASK_CLOCK, // software event (ns on CPU), available even without a PMU
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES, // data TLB load misses (page walks), see --huge-pages
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+};
+
+const char *const perfEventNames[PERF_EVENT_COUNT] = {
+    "task-ms", "cycles", "instructions", "L1D-miss", "LLC-miss", "dTLB-miss", "br-miss"};
+
+enum PerfPhase
+{
+    PHASE_FORCE,  // force computation (MoveChunk and alternatives, octree build included; serial: whole step)
+    PHASE_UPDATE, // UpdateChunkPosition
+    PHASE_OUTPUT, // snapshots, trajectory staging, result files
+    PHASE_COUNT
+};
+
+const char *const perfPhaseNames[PHASE_COUNT] = {"MoveChunk", "UpdateChunkPosition", "output"};
+
+// perf_event_attr (type, config) of every PerfEventId
+void PerfEventAttr(PerfEventId id, perf_event_attr *attr)
+{
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (id)
+    {
+    case PERF_TASK_CLOCK:
+        attr->type = PERF_TYPE_SOFTWARE;
+        attr->config = PERF_COUNT_SW_TASK_CLOCK;
+        break;
+    case PERF_CYCLES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PERF_INSTRUCTIONS:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PERF_L1D_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case PERF_LLC_MISSES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case PERF_DTLB_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    default:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+}
+
+// Counters of one thread: its file descriptors and the values read at the start of the current phase
+struct alignas(CACHE_LINE) PerfThreadCounters
+{
+    int fd[PERF_EVENT_COUNT];
+    double start[PERF_EVENT_COUNT];
+    double total[PHASE_COUNT][PERF_EVENT_COUNT];
+};
+
+struct PerfState
+{
+    bool enabled = false;
+    bool available[PERF_EVENT_COUNT] = {};
+    string firstError; // why the first unavailable event failed to open
+    ThreadPool *pool = nullptr; // threads whose counters are open
+    vector<PerfThreadCounters> threads;
+};
+
+PerfState perfState;
+
+// Current (multiplex-scaled) value of one counter, 0 if it is not open
+double PerfRead(int fd)
+{
+    if (fd < 0)
+        return 0;
+    uint64_t values[3]; // value, time_enabled, time_running
+    if (read(fd, values, sizeof(values)) != (ssize_t)sizeof(values) || values[2] == 0)
+        return 0;
+    return (double)values[0] * ((double)values[1] / (double)values[2]);
+}
+
+/**
+ * @brief Opens the counters on every thread of the pool (the main thread being thread 0).
+ *
+ * @return false (counting disabled, PerfRunPhase becomes a plain call) if no event could be opened.
+ */
+bool PerfInit(ThreadPool &pool)
+{
+    perfState.pool = &pool;
+    perfState.threads.assign(pool.Size(), PerfThreadCounters());
+    vector<int> openErrno(PERF_EVENT_COUNT, 0);
+    pool.Run([&](unsigned int t)
+    {
+        PerfThreadCounters &counters = perfState.threads[t];
+        memset(counters.total, 0, sizeof(counters.total));
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+        {
+            perf_event_attr attr;
+            PerfEventAttr((PerfEventId)e, &attr);
+            counters.fd[e] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            if (counters.fd[e] < 0 && t == 0)
+                openErrno[e] = errno;
+        }
+    });
+
+    // An event counts only if every thread could open it
+    perfState.enabled = false;
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+    {
+        bool everywhere = true;
+        for (const PerfThreadCounters &counters : perfState.threads)
+            everywhere = everywhere && counters.fd[e] >= 0;
+        perfState.available[e] = everywhere;
+        perfState.enabled = perfState.enabled || everywhere;
+        if (!everywhere && perfState.firstError.empty())
+            perfState.firstError = string(perfEventNames[e]) + ": " + strerror(openErrno[e] ? openErrno[e] : EINVAL);
+    }
+    return perfState.enabled;
+}
+
+// Closes all counters
+void PerfShutdown()
+{
+    for (PerfThreadCounters &counters : perfState.threads)
+    {
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+        {
+            if (counters.fd[e] >= 0)
+                close(counters.fd[e]);
+            counters.fd[e] = -1;
+        }
+    }
+    perfState.enabled = false;
+}
+
+// Runs body and attributes the counts of every pool thread during body to `phase`
+void PerfRunPhase(PerfPhase phase, const function<void()> &body)
+{
+    if (!perfState.enabled)
+    {
+        body();
+        return;
+    }
+    perfState.pool->Run([](unsigned int t)
+    {
+        PerfThreadCounters &counters = perfState.threads[t];
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+            counters.start[e] = PerfRead(counters.fd[e]);
+    });
+    body();
+    perfState.pool->Run([phase](unsigned int t)
+    {
+        PerfThreadCounters &counters = perfState.threads[t];
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+            counters.total[phase][e] += PerfRead(counters.fd[e]) - counters.start[e];
+    });
+}
+
+// Sum over the threads of one counter of one phase
+double PerfPhaseTotal(PerfPhase phase, PerfEventId e)
+{
+    double sum = 0;
+    for (const PerfThreadCounters &counters : perfState.threads)
+        sum += counters.total[phase][e];
+    return sum;
+}
+
+// Prints one counter in millions for the benchmark tables (12 wide), n/a if unavailable
+void PrintPerfMillions(PerfEventId e, double value)
+{
+    cout << setw(12);
+    if (perfState.enabled && perfState.available[e])
+        cout << fixed << setprecision(2) << value * 1e-6;
+    else
+        cout << "n/a";
+}
+
+// Prints one counter cell (task-clock in ms, others raw), n/a if unavailable
+void PrintPerfValue(int e, double value)
+{
+    cout << setw(14);
+    if (!perfState.available[e])
+        cout << "n/a";
+    else if (e == PERF_TASK_CLOCK)
+        cout << fixed << setprecision(2) << value * 1e-6;
+    else
+        cout << fixed << setprecision(0) << value;
+}
+
+// Per-phase, per-thread counter table with IPC and a total row per phase
+void PrintPerfReport()
+{
+    if (!perfState.enabled)
+    {
+        cout << "Hardware counters unavailable (" << perfState.firstError << "), no counts collected." << endl;
+        return;
+    }
+    if (!perfState.firstError.empty())
+        cout << "Some counters are unavailable (" << perfState.firstError << ")." << endl;
+
+    for (int p = 0; p < PHASE_COUNT; ++p)
+    {
+        cout << "\n[" << perfPhaseNames[p] << "]\n";
+        cout << left << setw(8) << "thread" << right;
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+            cout << setw(14) << perfEventNames[e];
+        cout << setw(8) << "IPC" << endl;
+
+        double sum[PERF_EVENT_COUNT] = {};
+        for (unsigned int t = 0; t <= perfState.threads.size(); ++t)
+        {
+            bool totalRow = (t == perfState.threads.size());
+            const double *values = totalRow ? sum : perfState.threads[t].total[p];
+            cout << left << setw(8) << (totalRow ? string("total") : to_string(t)) << right;
+            for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+            {
+                PrintPerfValue(e, values[e]);
+                if (!totalRow)
+                    sum[e] += values[e];
+            }
+            bool hasIpc = perfState.available[PERF_CYCLES] && perfState.available[PERF_INSTRUCTIONS] && values[PERF_CYCLES] > 0;
+            cout << setw(8);
+            if (hasIpc)
+                cout << fixed << setprecision(2) << values[PERF_INSTRUCTIONS] / values[PERF_CYCLES];
+            else
+                cout << "n/a";
+            cout << endl;
+        }
+    }
+    cout << defaultfloat;
+}
+
+#endif
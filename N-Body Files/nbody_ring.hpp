@@ -0,0 +1,403 @@
+#ifndef NBODY_RING_HPP
+#define NBODY_RING_HPP
+
+#include "nbody_parallel.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: distributed direct sum over R ranks (processes) on one host. Rank r owns particles
+//            [start_r, end_r) (ChunkBounds). Each step, every rank starts with its own position block
+//            and passes blocks around a ring R - 1 times: at shift k it holds the block of rank
+//            (r - k) mod R, computes its particles against it, and meanwhile a communication thread sends
+//            that block to rank r + 1 and receives the next one from rank r - 1. After R shifts every
+//            rank has seen all N positions, and it updates its own velocities and positions.
+
+//      Note: ranks are fork()ed from one parent and linked by Unix socketpairs (rank r writes to r + 1).
+//            Both directions of an exchange progress together in one poll() loop, so a block larger than
+//            the socket buffers cannot deadlock the ring. Initial state, results and per-rank statistics
+//            live in MAP_SHARED memory that the parent created before forking; rank r writes only its own
+//            slice, and nothing else is shared.
+
+//      Note: every rank keeps one communication thread for the whole run (RingCommThread), handed one
+//            exchange per shift, so thread creation is not part of the measured time. Each shift records
+//            when the exchange and the force kernel started and ended; the overlap of the two intervals,
+//            summed over shifts, is the communication actually hidden behind compute.
+
+//      Note: the force on particle i is accumulated per source block and the R partial sums are added in
+//            block order 0 .. R-1, whatever the order the blocks arrived in. Coincident particles owned by
+//            different ranks therefore get bit-identical forces (the lattice stays stable), and R = 1
+//            reproduces parallel.exe bit for bit. With R > 1 the split sum differs in the last bits.
+
+// Per-rank timings, in shared memory
+struct alignas(CACHE_LINE) RankStats
+{
+    double stepMs;    // whole step loop
+    double computeMs; // force kernel against held blocks
+    double commMs;    // communication thread busy time
+    double overlapMs; // time an exchange and the force kernel were both running
+    double waitMs;    // compute side blocked on a pending exchange
+    double bytes;     // bytes sent
+    int failed;       // non-zero if the rank hit an I/O error
+};
+
+// Ring configuration of one run
+struct RingConfig
+{
+    unsigned int ranks = 2;
+    unsigned int threadsPerRank = 1;
+    int steps = 1;
+};
+
+// Long-lived communication thread of one rank: Start() hands it a job and returns at once, Finish()
+// waits for the job to end. Same barrier handoff as ThreadPool, except the caller does not take part.
+class RingCommThread
+{
+public:
+    RingCommThread() : startBarrier(2), endBarrier(2), job(nullptr), stopping(false)
+    {
+        worker = thread(&RingCommThread::WorkerLoop, this);
+    }
+
+    ~RingCommThread()
+    {
+        stopping = true;
+        startBarrier.Wait();
+        worker.join();
+    }
+
+    RingCommThread(const RingCommThread &) = delete;
+    RingCommThread &operator=(const RingCommThread &) = delete;
+
+    // `work` must stay alive until Finish() returns
+    void Start(const function<void()> &work)
+    {
+        job = &work;
+        startBarrier.Wait();
+    }
+
+    void Finish()
+    {
+        endBarrier.Wait();
+        job = nullptr;
+    }
+
+private:
+    void WorkerLoop()
+    {
+        while (true)
+        {
+            startBarrier.Wait();
+            if (stopping)
+                return;
+            (*job)();
+            endBarrier.Wait();
+        }
+    }
+
+    thread worker;
+    Barrier startBarrier;
+    Barrier endBarrier;
+    const function<void()> *job; // published before startBarrier, read after it
+    bool stopping;
+};
+
+// Milliseconds during which [start1, end1) and [start2, end2) both ran
+inline double OverlapMs(chrono::high_resolution_clock::time_point start1, chrono::high_resolution_clock::time_point end1,
+                        chrono::high_resolution_clock::time_point start2, chrono::high_resolution_clock::time_point end2)
+{
+    double ms = chrono::duration<double, milli>(min(end1, end2) - max(start1, start2)).count();
+    return ms > 0 ? ms : 0;
+}
+
+// Sends sendBytes from sendBuf to sendFd while receiving recvBytes from recvFd into recvBuf, both
+// non-blocking under one poll() loop. Returns false on any I/O error or early EOF.
+bool RingExchange(int sendFd, const char *sendBuf, size_t sendBytes, int recvFd, char *recvBuf, size_t recvBytes)
+{
+    size_t sent = 0, received = 0;
+    while (sent < sendBytes || received < recvBytes)
+    {
+        pollfd fds[2];
+        int count = 0;
+        if (sent < sendBytes)
+            fds[count++] = {sendFd, POLLOUT, 0};
+        if (received < recvBytes)
+            fds[count++] = {recvFd, POLLIN, 0};
+        if (poll(fds, count, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        for (int k = 0; k < count; ++k)
+        {
+            if (fds[k].revents == 0)
+                continue;
+            if (fds[k].fd == sendFd && sent < sendBytes)
+            {
+                ssize_t done = send(sendFd, sendBuf + sent, sendBytes - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (done < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    return false;
+                if (done > 0)
+                    sent += (size_t)done;
+            }
+            else if (received < recvBytes)
+            {
+                ssize_t done = recv(recvFd, recvBuf + received, recvBytes - received, MSG_DONTWAIT);
+                if (done == 0)
+                    return false;
+                if (done < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    return false;
+                if (done > 0)
+                    received += (size_t)done;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Body of rank `rank`: runs config.steps ring steps on its slice of `global` (shared memory).
+ *
+ * @param sendFd Socket to rank + 1, recvFd socket from rank - 1.
+ */
+void RunRank(unsigned int rank, const RingConfig &config, ParticleSystem &global, int sendFd, int recvFd,
+             RankStats *stats)
+{
+    const unsigned int R = config.ranks;
+    unsigned int start, end;
+    ChunkBounds(rank, R, global.n, &start, &end);
+    const unsigned int count = end - start;
+
+    // Largest block (the last rank takes the remainder)
+    unsigned int lastStart, lastEnd;
+    ChunkBounds(R - 1, R, global.n, &lastStart, &lastEnd);
+    const unsigned int capacity = lastEnd - lastStart;
+
+    // Own particles, the two position block buffers and the per-block partial forces
+    ParticleSystem local(count);
+    ParticleSystem blocks[2] = {ParticleSystem(capacity), ParticleSystem(capacity)};
+    vector<float> partial(3 * (size_t)R * count);
+    const size_t blockBytes = 3 * (size_t)blocks[0].stride * sizeof(float); // x | y | z, contiguous
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        local.x[i] = global.x[start + i];
+        local.y[i] = global.y[start + i];
+        local.z[i] = global.z[start + i];
+        local.vx[i] = global.vx[start + i];
+        local.vy[i] = global.vy[start + i];
+        local.vz[i] = global.vz[start + i];
+    }
+
+    ThreadPool pool(config.threadsPerRank);
+    RingCommThread comm;
+    memset(stats, 0, sizeof(*stats));
+    auto loopStart = chrono::high_resolution_clock::now();
+
+    for (int step = 0; step < config.steps; ++step)
+    {
+        // Shift 0 holds the own block
+        unsigned int current = 0;
+        memcpy(blocks[0].x, local.x, count * sizeof(float));
+        memcpy(blocks[0].y, local.y, count * sizeof(float));
+        memcpy(blocks[0].z, local.z, count * sizeof(float));
+
+        for (unsigned int shift = 0; shift < R; ++shift)
+        {
+            const unsigned int owner = (rank + R - shift) % R;
+            unsigned int ownerStart, ownerEnd;
+            ChunkBounds(owner, R, global.n, &ownerStart, &ownerEnd);
+            ParticleSystem held(blocks[current], 0, ownerEnd - ownerStart);
+
+            // Pass the held block on while computing against it
+            const bool exchanging = (shift + 1 < R);
+            bool exchanged = true;
+            chrono::high_resolution_clock::time_point commStart, commEnd;
+            const function<void()> exchange = [&]()
+            {
+                commStart = chrono::high_resolution_clock::now();
+                exchanged = RingExchange(sendFd, (const char *)blocks[current].x, blockBytes,
+                                         recvFd, (char *)blocks[current ^ 1].x, blockBytes);
+                commEnd = chrono::high_resolution_clock::now();
+            };
+            if (exchanging)
+                comm.Start(exchange);
+
+            auto computeStart = chrono::high_resolution_clock::now();
+            float *F = &partial[3 * (size_t)owner * count];
+            pool.Run([&](unsigned int t)
+            {
+                unsigned int first, last;
+                ChunkBounds(t, pool.Size(), count, &first, &last);
+                for (unsigned int i = first; i < last; ++i)
+                    ComputeForceAt(held, local.x[i], local.y[i], local.z[i], &F[i], &F[count + i], &F[2 * (size_t)count + i]);
+            });
+            auto computeEnd = chrono::high_resolution_clock::now();
+            stats->computeMs += chrono::duration<double, milli>(computeEnd - computeStart).count();
+
+            if (exchanging)
+            {
+                comm.Finish();
+                stats->waitMs += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - computeEnd).count();
+                stats->commMs += chrono::duration<double, milli>(commEnd - commStart).count();
+                stats->overlapMs += OverlapMs(commStart, commEnd, computeStart, computeEnd);
+                stats->bytes += (double)blockBytes;
+            }
+            if (!exchanged)
+            {
+                stats->failed = 1;
+                return;
+            }
+            current ^= 1;
+        }
+
+        // Sum the partial forces in block order, then the same update as MoveChunk + UpdateChunkPosition
+        pool.Run([&](unsigned int t)
+        {
+            unsigned int first, last;
+            ChunkBounds(t, pool.Size(), count, &first, &last);
+            for (unsigned int i = first; i < last; ++i)
+            {
+                float Fx = partial[i], Fy = partial[count + i], Fz = partial[2 * (size_t)count + i];
+                for (unsigned int b = 1; b < R; ++b)
+                {
+                    const float *Fb = &partial[3 * (size_t)b * count];
+                    Fx += Fb[i];
+                    Fy += Fb[count + i];
+                    Fz += Fb[2 * (size_t)count + i];
+                }
+                local.vx[i] += dt * Fx;
+                local.vy[i] += dt * Fy;
+                local.vz[i] += dt * Fz;
+                local.x[i] += local.vx[i] * dt;
+                local.y[i] += local.vy[i] * dt;
+                local.z[i] += local.vz[i] * dt;
+            }
+        });
+    }
+    stats->stepMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - loopStart).count();
+
+    // Publish the own slice of the final state
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        global.x[start + i] = local.x[i];
+        global.y[start + i] = local.y[i];
+        global.z[start + i] = local.z[i];
+        global.vx[start + i] = local.vx[i];
+        global.vy[start + i] = local.vy[i];
+        global.vz[start + i] = local.vz[i];
+    }
+}
+
+// Shared-memory particle system of n particles, unmapped by its destructor
+unique_ptr<ParticleSystem> CreateSharedParticles(unsigned int n)
+{
+    size_t bytes = 6 * (size_t)PaddedCount(n) * sizeof(float);
+    void *mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+        return nullptr;
+    return unique_ptr<ParticleSystem>(new ParticleSystem(n, mapping, bytes, 0));
+}
+
+/**
+ * @brief Forks config.ranks ranks over `particles` (shared memory, see CreateSharedParticles), waits for
+ *        them, and returns their statistics. The final state is left in `particles`.
+ *
+ * @return false (with *error set) if a socket, fork or rank failed.
+ */
+bool RunRing(const RingConfig &config, ParticleSystem &particles, vector<RankStats> *stats, string *error)
+{
+    const unsigned int R = config.ranks;
+    RankStats *shared = (RankStats *)mmap(nullptr, R * sizeof(RankStats), PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        *error = string("mmap: ") + strerror(errno);
+        return false;
+    }
+    memset(shared, 0, R * sizeof(RankStats));
+
+    // links[r]: [0] written by rank r, [1] read by rank r + 1
+    vector<int> links(2 * R, -1);
+    for (unsigned int r = 0; r < R && R > 1; ++r)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, &links[2 * r]) != 0)
+        {
+            *error = string("socketpair: ") + strerror(errno);
+            return false;
+        }
+    }
+
+    cout.flush();
+    vector<pid_t> children;
+    bool ok = true;
+    for (unsigned int r = 0; r < R; ++r)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            *error = string("fork: ") + strerror(errno);
+            ok = false;
+            break;
+        }
+        if (pid == 0)
+        {
+            int sendFd = (R > 1) ? links[2 * r] : -1;
+            int recvFd = (R > 1) ? links[2 * ((r + R - 1) % R) + 1] : -1;
+            for (int fd : links)
+            {
+                if (fd != sendFd && fd != recvFd && fd >= 0)
+                    close(fd);
+            }
+            RunRank(r, config, particles, sendFd, recvFd, &shared[r]);
+            _exit(shared[r].failed ? 1 : 0);
+        }
+        children.push_back(pid);
+    }
+
+    for (int fd : links)
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+    for (pid_t pid : children)
+    {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            if (ok)
+                *error = "a rank failed";
+            ok = false;
+        }
+    }
+
+    stats->assign(shared, shared + R);
+    munmap(shared, R * sizeof(RankStats));
+    return ok;
+}
+
+// Wall time of a run: the slowest rank's step loop
+double RingWallMs(const vector<RankStats> &stats)
+{
+    double wall = 0;
+    for (const RankStats &s : stats)
+        wall = max(wall, s.stepMs);
+    return wall;
+}
+
+#endif
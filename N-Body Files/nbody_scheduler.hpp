@@ -0,0 +1,238 @@
+#ifndef NBODY_SCHEDULER_HPP
+#define NBODY_SCHEDULER_HPP
+
+#include "nbody_parallel.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: StartThreads gives every thread one static chunk of n / T particles, so the slowest
+//            thread (SMT sibling, lower turbo, noisy neighbour) sets the step time. The stealing
+//            scheduler splits [0, n) into tasks of `grain` particles. Each thread first drains its own
+//            queue, then steals from the others until every queue is empty.
+
+//      Note: tasks are never added during a phase, so a queue is just a range of task indices
+//            [head, tail) packed in one 64-bit atomic. The owner pops at the tail, thieves take from the
+//            head, and both sides claim a task with a single compare-and-swap (no locks).
+
+//      Note: both policies record per-thread busy time (inside func) and idle time (phase wall time minus
+//            busy: waiting at the end barrier) so the load imbalance can be compared.
+
+enum SchedulePolicy
+{
+    SCHED_STATIC, // one chunk per thread (StartThreads)
+    SCHED_STEAL   // many small tasks, work stealing
+};
+
+struct ScheduleConfig
+{
+    SchedulePolicy policy;
+    unsigned int grain; // particles per task (SCHED_STEAL only)
+};
+
+// Default schedule, overridden by --sched and --grain
+ScheduleConfig scheduleConfig = {SCHED_STATIC, 64};
+
+bool ParseSchedulePolicy(const string &text, SchedulePolicy *policy)
+{
+    if (text == "static")
+    {
+        *policy = SCHED_STATIC;
+        return true;
+    }
+    if (text == "steal")
+    {
+        *policy = SCHED_STEAL;
+        return true;
+    }
+    return false;
+}
+
+// Accumulated over all scheduled phases, one entry per pool thread (own cache line, no false sharing)
+struct alignas(CACHE_LINE) ThreadStats
+{
+    double busyMs = 0;
+    double idleMs = 0;
+    unsigned long tasks = 0;
+    unsigned long steals = 0;
+    double phaseBusyMs = 0; // busy time of the running phase
+};
+
+vector<ThreadStats> threadStats;
+
+// Task range [head, tail) of one thread, head in the low 32 bits, tail in the high 32 bits
+struct alignas(CACHE_LINE) TaskQueue
+{
+    atomic<uint64_t> range;
+};
+
+unique_ptr<TaskQueue[]> taskQueues;
+unsigned int taskQueueCount = 0;
+
+inline uint64_t PackRange(uint32_t head, uint32_t tail)
+{
+    return ((uint64_t)tail << 32) | head;
+}
+
+// Owner side: takes the last task of its own queue. Returns false when the queue is empty.
+bool PopTask(TaskQueue &queue, unsigned int *task)
+{
+    uint64_t range = queue.range.load(memory_order_relaxed);
+    while (true)
+    {
+        uint32_t head = (uint32_t)range, tail = (uint32_t)(range >> 32);
+        if (head >= tail)
+            return false;
+        if (queue.range.compare_exchange_weak(range, PackRange(head, tail - 1), memory_order_acq_rel))
+        {
+            *task = tail - 1;
+            return true;
+        }
+    }
+}
+
+// Thief side: takes the first task of another thread's queue. Returns false when the queue is empty.
+bool StealTask(TaskQueue &queue, unsigned int *task)
+{
+    uint64_t range = queue.range.load(memory_order_relaxed);
+    while (true)
+    {
+        uint32_t head = (uint32_t)range, tail = (uint32_t)(range >> 32);
+        if (head >= tail)
+            return false;
+        if (queue.range.compare_exchange_weak(range, PackRange(head + 1, tail), memory_order_acq_rel))
+        {
+            *task = head;
+            return true;
+        }
+    }
+}
+
+// Sizes the statistics (and queues) to the pool, keeping accumulated statistics if the size is unchanged
+void PrepareScheduler(ThreadPool &pool)
+{
+    if (threadStats.size() != pool.Size())
+        threadStats.assign(pool.Size(), ThreadStats());
+    if (taskQueueCount != pool.Size())
+    {
+        taskQueues.reset(new TaskQueue[pool.Size()]);
+        taskQueueCount = pool.Size();
+    }
+}
+
+// Adds the phase's busy / idle time of every thread to the totals
+void AccumulatePhaseStats(double phaseMs)
+{
+    for (ThreadStats &stats : threadStats)
+    {
+        stats.busyMs += stats.phaseBusyMs;
+        stats.idleMs += phaseMs - stats.phaseBusyMs;
+    }
+}
+
+// StartThreads with per-thread statistics: one static chunk per thread
+void StartThreadsStatic(ParticleSystem &ps, ChunkFunction func, ThreadPool &pool = WorkerPool())
+{
+    PrepareScheduler(pool);
+    auto phaseStart = chrono::high_resolution_clock::now();
+    pool.Run([&ps, func, &pool](unsigned int t)
+    {
+        unsigned int start, end;
+        ChunkBounds(t, pool.Size(), ps.n, &start, &end);
+        auto taskStart = chrono::high_resolution_clock::now();
+        func(ps, start, end);
+        auto taskEnd = chrono::high_resolution_clock::now();
+        threadStats[t].phaseBusyMs = chrono::duration<double, milli>(taskEnd - taskStart).count();
+        threadStats[t].tasks++;
+    });
+    auto phaseEnd = chrono::high_resolution_clock::now();
+    AccumulatePhaseStats(chrono::duration<double, milli>(phaseEnd - phaseStart).count());
+}
+
+// Runs func over [0, ps.n) in tasks of `grain` particles with work stealing
+void StartThreadsStealing(ParticleSystem &ps, ChunkFunction func, unsigned int grain, ThreadPool &pool = WorkerPool())
+{
+    PrepareScheduler(pool);
+    const unsigned int nTasks = (ps.n + grain - 1) / grain;
+
+    // Initial distribution: contiguous task ranges, published to the workers by the start barrier
+    for (unsigned int t = 0; t < pool.Size(); ++t)
+    {
+        unsigned int head, tail;
+        ChunkBounds(t, pool.Size(), nTasks, &head, &tail);
+        taskQueues[t].range.store(PackRange(head, tail), memory_order_relaxed);
+    }
+
+    auto phaseStart = chrono::high_resolution_clock::now();
+    pool.Run([&ps, func, grain, &pool](unsigned int t)
+    {
+        const unsigned int nThreads = pool.Size();
+        ThreadStats &stats = threadStats[t];
+        double busyMs = 0;
+        unsigned int task;
+        while (true)
+        {
+            bool stolen = false;
+            bool found = PopTask(taskQueues[t], &task);
+            // Own queue empty: scan the other queues, starting with the next thread
+            for (unsigned int k = 1; !found && k < nThreads; ++k)
+                found = stolen = StealTask(taskQueues[(t + k) % nThreads], &task);
+            if (!found)
+                break;
+
+            unsigned int start = task * grain;
+            unsigned int end = (start + grain < ps.n) ? start + grain : ps.n;
+            auto taskStart = chrono::high_resolution_clock::now();
+            func(ps, start, end);
+            auto taskEnd = chrono::high_resolution_clock::now();
+            busyMs += chrono::duration<double, milli>(taskEnd - taskStart).count();
+            stats.tasks++;
+            stats.steals += stolen;
+        }
+        stats.phaseBusyMs = busyMs;
+    });
+    auto phaseEnd = chrono::high_resolution_clock::now();
+    AccumulatePhaseStats(chrono::duration<double, milli>(phaseEnd - phaseStart).count());
+}
+
+// Runs func over the particles with the policy of the global scheduleConfig
+void StartThreadsScheduled(ParticleSystem &ps, ChunkFunction func, ThreadPool &pool = WorkerPool())
+{
+    if (scheduleConfig.policy == SCHED_STEAL)
+        StartThreadsStealing(ps, func, scheduleConfig.grain, pool);
+    else
+        StartThreadsStatic(ps, func, pool);
+}
+
+// Prints the accumulated per-thread statistics and the imbalance (slowest thread busy / mean busy)
+void PrintThreadStats()
+{
+    if (threadStats.empty())
+        return;
+    double totalBusy = 0, maxBusy = 0, totalIdle = 0;
+    cout << left << setw(8) << "thread" << right << setw(12) << "busy ms" << setw(12) << "idle ms"
+         << setw(10) << "tasks" << setw(10) << "steals" << endl;
+    for (unsigned int t = 0; t < threadStats.size(); ++t)
+    {
+        const ThreadStats &stats = threadStats[t];
+        cout << fixed << setprecision(2) << left << setw(8) << t << right << setw(12) << stats.busyMs
+             << setw(12) << stats.idleMs << setw(10) << stats.tasks << setw(10) << stats.steals << endl;
+        totalBusy += stats.busyMs;
+        totalIdle += stats.idleMs;
+        maxBusy = (stats.busyMs > maxBusy) ? stats.busyMs : maxBusy;
+    }
+    double meanBusy = totalBusy / threadStats.size();
+    cout << "Imbalance (max / mean busy): " << (meanBusy > 0 ? maxBusy / meanBusy : 1.0)
+         << ", idle share: " << 100.0 * totalIdle / (totalBusy + totalIdle) << " %" << endl;
+}
+
+#endif
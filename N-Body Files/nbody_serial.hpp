@@ -1,4 +1,8 @@
+#ifndef NBODY_SERIAL_HPP
+#define NBODY_SERIAL_HPP
+
 #include <cmath>
+#include "nbody_simd.hpp"
 using namespace std;
 
 // Written by: Amir Zuabi - 212606222
@@ -7,32 +11,16 @@ using namespace std;
 
 // Note: This is a serial implementation of a massivlely parallel problem.
 //       It uses Newton's grav. law (check pdf) in order to calc grav. forces between serialParticles.
-#ifndef N_BODY_CONSTS
-#define N_BODY_CONSTS
-// Simulation parameters
-const int nParticles = 16384 * 2;
-const float dt = 0.01f;
-const float softening = 1e-20f;
-
-typedef struct
-{
-    float x, y, z, vx, vy, vz;
-} OneParticle;
-#endif
 
-// This is a AoS - Array of Structs
-struct ParticleType
-{
-    float x, y, z;
-    float vx, vy, vz;
-    float trash1, trash2;
-};
+// Note: dt, softening and OneParticle are shared with the parallel version through particle_system.hpp
 
-ParticleType serialParticles[nParticles];
+// Note: the AoS ParticleType / SerialParticles live in nbody_layout.hpp. The force sum is the templated
+//       kernel of nbody_simd_kernel.inl on the AoS layout, one lane wide (simd_scalar), so the serial
+//       reference and the parallel SIMD kernels share one operation order and cannot drift apart.
 
 
 // Given an index, and a pointer, fills pointer p with particle[i]'s credentials
-void GetParticleSerial(int i, OneParticle *p)
+void GetParticleSerial(const SerialParticles &serialParticles, int i, OneParticle *p)
 {
     p->x = serialParticles[i].x;
     p->y = serialParticles[i].y;
@@ -43,8 +31,9 @@ void GetParticleSerial(int i, OneParticle *p)
 }
 
 // Initializes the serialParticles[] array. Position is given by index.
-void InitParticleSerial()
+void InitParticleSerial(SerialParticles &serialParticles)
 {
+    const unsigned int nParticles = serialParticles.Size();
     for (unsigned int i = 0; i < nParticles; i++)
     {
         serialParticles[i].x = (float)(i % 15);
@@ -58,32 +47,17 @@ void InitParticleSerial()
 
 
 // Calcs serialParticles[] movement by dt time.
-void MoveParticlesSerial()
+void MoveParticlesSerial(SerialParticles &serialParticles)
 {
+    const int nParticles = (int)serialParticles.Size();
+
     // Choose 1 particle to calculate force superpositions
     for (int i = 0; i < nParticles; i++)
     {
-        // Components of the force exerted on particle i
+        // Components of the force exerted on particle i by all serialParticles (itself included, softened)
         float Fx = 0, Fy = 0, Fz = 0;
-
-        // Loop over serialParticles that exert forces
-        for (int j = 0; j < nParticles; j++)
-        {
-            // Avoid singularity and interaction with self
-            const float softening = 1e-20f;
-
-            // Newton's law of universal gravity
-            const float dx = serialParticles[j].x - serialParticles[i].x;
-            const float dy = serialParticles[j].y - serialParticles[i].y;
-            const float dz = serialParticles[j].z - serialParticles[i].z;
-
-            const float dr = 1.0f / sqrt(dx * dx + dy * dy + dz * dz + softening);
-            const float drPower3 = dr * dr * dr;
-            // Calculate the net force
-            Fx += dx * drPower3;
-            Fy += dy * drPower3;
-            Fz += dz * drPower3;
-        }
+        simd_scalar::ComputeForceLayout<AosLayout, true>(serialParticles, serialParticles[i].x, serialParticles[i].y,
+                                                         serialParticles[i].z, &Fx, &Fy, &Fz);
 
         // Accelerate serialParticles in response to the gravitational force
         serialParticles[i].vx += dt * Fx;
@@ -100,3 +74,31 @@ void MoveParticlesSerial()
         serialParticles[i].z += serialParticles[i].vz * dt;
     }
 }
+
+// Same step on AoSoA packets (nbody_layout.hpp): the templated kernel on AosoaLayout, same operation order
+void MoveParticlesSerialPacked(AosoaParticles &packed)
+{
+    ParticlePacket *packets = packed.Data();
+    for (unsigned int i = 0; i < packed.n; i++)
+    {
+        ParticlePacket &p = packets[i / PACKET_LANES];
+        const unsigned int l = i % PACKET_LANES;
+        float Fx = 0, Fy = 0, Fz = 0;
+        simd_scalar::ComputeForceLayout<AosoaLayout, true>(packed, p.x[l], p.y[l], p.z[l], &Fx, &Fy, &Fz);
+        p.vx[l] += dt * Fx;
+        p.vy[l] += dt * Fy;
+        p.vz[l] += dt * Fz;
+    }
+
+    for (unsigned int k = 0; k < packed.Packets(); k++)
+    {
+        for (unsigned int l = 0; l < PACKET_LANES; l++)
+        {
+            packets[k].x[l] += packets[k].vx[l] * dt;
+            packets[k].y[l] += packets[k].vy[l] * dt;
+            packets[k].z[l] += packets[k].vz[l] * dt;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,425 @@
+#ifndef NBODY_SIMD_HPP
+#define NBODY_SIMD_HPP
+
+#include <cmath>
+#include <string>
+#include <immintrin.h>
+#include "nbody_layout.hpp"
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: the direct-sum force kernel is compiled once per instruction set (SSE, AVX, AVX2 + FMA,
+//            AVX-512) from nbody_simd_kernel.inl. The makefile no longer passes -mavx, so the binary
+//            runs on any x86-64 CPU; at startup CPUID picks the widest backend the CPU supports,
+//            and --backend forces a specific one for benchmarking.
+
+//      Note: the kernels are compiled at -O2 whatever the makefile level (-O0): at -O0 every vector
+//            temporary goes through the stack, and the kernel runs ~10x slower.
+
+//      Note: every kernel comes in three accumulation modes (ForceAccumulation): plain float sums, Kahan
+//            compensated float sums, and double sums of the float terms. Float mode is the original code.
+
+//      Note: simd_scalar compiles the same kernel one lane wide for the serial reference. It is not a
+//            --backend choice: every x86-64 CPU has SSE.
+
+//      Note: the "avx" backend is the original AVX kernel, bit for bit. AVX2 and AVX-512 accumulate
+//            with FMA and sum in a different lane order, so their results differ in the last bits.
+
+#define SIMD_INLINE __attribute__((always_inline)) static inline
+
+// Adds the interactions with particles [jStart, n) of src to the force at (xi, yi, zi). Used for the
+// tail that does not fill a whole vector, same operation order as the vector body.
+void AddTailForceAt(const ParticleSystem &src, float xi, float yi, float zi, unsigned int jStart,
+                    float *Fx, float *Fy, float *Fz)
+{
+    for (unsigned int j = jStart; j < src.n; ++j)
+    {
+        const float dx = src.x[j] - xi;
+        const float dy = src.y[j] - yi;
+        const float dz = src.z[j] - zi;
+        const float invDist = 1.0f / sqrtf((dx * dx + softening) + (dy * dy + dz * dz));
+        const float invDist3 = invDist * (invDist * invDist);
+        *Fx += dx * invDist3;
+        *Fy += dy * invDist3;
+        *Fz += dz * invDist3;
+    }
+}
+
+// Same for particle i of ps
+void AddTailForce(const ParticleSystem &ps, unsigned int i, unsigned int jStart, float *Fx, float *Fy, float *Fz)
+{
+    AddTailForceAt(ps, ps.x[i], ps.y[i], ps.z[i], jStart, Fx, Fy, Fz);
+}
+
+// ===== Scalar: 1 lane, no target (the serial reference and the baseline of the layout benchmark) =====
+#pragma GCC push_options
+#pragma GCC optimize("O2")
+namespace simd_scalar
+{
+struct V
+{
+    typedef float vec;
+    static const unsigned int W = 1;
+    SIMD_INLINE vec Set1(float a) { return a; }
+    SIMD_INLINE vec Zero() { return 0.0f; }
+    SIMD_INLINE vec Load(const float *p) { return *p; }
+    SIMD_INLINE vec LoadHalves(const float *lo, const float *) { return *lo; }
+    SIMD_INLINE vec Add(vec a, vec b) { return a + b; }
+    SIMD_INLINE vec Sub(vec a, vec b) { return a - b; }
+    SIMD_INLINE vec Mul(vec a, vec b) { return a * b; }
+    SIMD_INLINE vec Div(vec a, vec b) { return a / b; }
+    SIMD_INLINE vec Sqrt(vec a) { return sqrtf(a); }
+    SIMD_INLINE vec Rsqrt(vec a) { return 1.0f / sqrtf(a); }
+    SIMD_INLINE vec MulAdd(vec a, vec b, vec c) { return c + a * b; }
+    SIMD_INLINE vec NegMulAdd(vec a, vec b, vec c) { return c - a * b; }
+    SIMD_INLINE vec MaskNonZero(vec a, vec b) { return b != 0.0f ? a : 0.0f; }
+    SIMD_INLINE void Store(float *p, vec a) { *p = a; }
+    typedef double dvec;
+    SIMD_INLINE dvec ZeroWide() { return 0.0; }
+    SIMD_INLINE void AddWide(vec a, dvec *lo, dvec *) { *lo += a; }
+    SIMD_INLINE double SumWide(dvec lo, dvec hi) { return lo + hi; }
+    SIMD_INLINE float Sum(vec a) { return a; }
+};
+#include "nbody_simd_kernel.inl"
+}
+#pragma GCC pop_options
+
+// ===== SSE: 4 lanes, no FMA (SSE2 only, the baseline of every x86-64 CPU) =====
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("O2")
+namespace simd_sse
+{
+struct V
+{
+    typedef __m128 vec;
+    static const unsigned int W = 4;
+    SIMD_INLINE vec Set1(float a) { return _mm_set1_ps(a); }
+    SIMD_INLINE vec Zero() { return _mm_setzero_ps(); }
+    SIMD_INLINE vec Load(const float *p) { return _mm_load_ps(p); }
+    SIMD_INLINE vec LoadHalves(const float *lo, const float *hi) { return _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)lo), (const __m64 *)hi); }
+    SIMD_INLINE vec Add(vec a, vec b) { return _mm_add_ps(a, b); }
+    SIMD_INLINE vec Sub(vec a, vec b) { return _mm_sub_ps(a, b); }
+    SIMD_INLINE vec Mul(vec a, vec b) { return _mm_mul_ps(a, b); }
+    SIMD_INLINE vec Div(vec a, vec b) { return _mm_div_ps(a, b); }
+    SIMD_INLINE vec Sqrt(vec a) { return _mm_sqrt_ps(a); }
+    SIMD_INLINE vec Rsqrt(vec a) { return _mm_rsqrt_ps(a); }
+    SIMD_INLINE vec MulAdd(vec a, vec b, vec c) { return _mm_add_ps(c, _mm_mul_ps(a, b)); }
+    SIMD_INLINE vec NegMulAdd(vec a, vec b, vec c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+    SIMD_INLINE vec MaskNonZero(vec a, vec b) { return _mm_and_ps(a, _mm_cmpneq_ps(b, _mm_setzero_ps())); }
+    SIMD_INLINE void Store(float *p, vec a) { _mm_store_ps(p, a); }
+    typedef __m128d dvec;
+    SIMD_INLINE dvec ZeroWide() { return _mm_setzero_pd(); }
+    SIMD_INLINE void AddWide(vec a, dvec *lo, dvec *hi)
+    {
+        *lo = _mm_add_pd(*lo, _mm_cvtps_pd(a));
+        *hi = _mm_add_pd(*hi, _mm_cvtps_pd(_mm_movehl_ps(a, a)));
+    }
+    SIMD_INLINE double SumWide(dvec lo, dvec hi)
+    {
+        alignas(64) double lanes[W];
+        _mm_store_pd(lanes, lo);
+        _mm_store_pd(lanes + 2, hi);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    SIMD_INLINE float Sum(vec a)
+    {
+        alignas(64) float lanes[W];
+        _mm_store_ps(lanes, a);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+};
+#include "nbody_simd_kernel.inl"
+}
+#pragma GCC pop_options
+
+// ===== AVX: 8 lanes, no FMA (the original MoveChunk kernel) =====
+#pragma GCC push_options
+#pragma GCC target("avx")
+#pragma GCC optimize("O2")
+namespace simd_avx
+{
+struct V
+{
+    typedef __m256 vec;
+    static const unsigned int W = 8;
+    SIMD_INLINE vec Set1(float a) { return _mm256_set1_ps(a); }
+    SIMD_INLINE vec Zero() { return _mm256_setzero_ps(); }
+    SIMD_INLINE vec Load(const float *p) { return _mm256_load_ps(p); }
+    SIMD_INLINE vec LoadHalves(const float *lo, const float *hi) { return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(lo)), _mm_load_ps(hi), 1); }
+    SIMD_INLINE vec Add(vec a, vec b) { return _mm256_add_ps(a, b); }
+    SIMD_INLINE vec Sub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+    SIMD_INLINE vec Mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+    SIMD_INLINE vec Div(vec a, vec b) { return _mm256_div_ps(a, b); }
+    SIMD_INLINE vec Sqrt(vec a) { return _mm256_sqrt_ps(a); }
+    SIMD_INLINE vec Rsqrt(vec a) { return _mm256_rsqrt_ps(a); }
+    SIMD_INLINE vec MulAdd(vec a, vec b, vec c) { return _mm256_add_ps(c, _mm256_mul_ps(a, b)); }
+    SIMD_INLINE vec NegMulAdd(vec a, vec b, vec c) { return _mm256_sub_ps(c, _mm256_mul_ps(a, b)); }
+    SIMD_INLINE vec MaskNonZero(vec a, vec b) { return _mm256_and_ps(a, _mm256_cmp_ps(b, _mm256_setzero_ps(), _CMP_NEQ_UQ)); }
+    SIMD_INLINE void Store(float *p, vec a) { _mm256_store_ps(p, a); }
+    typedef __m256d dvec;
+    SIMD_INLINE dvec ZeroWide() { return _mm256_setzero_pd(); }
+    SIMD_INLINE void AddWide(vec a, dvec *lo, dvec *hi)
+    {
+        *lo = _mm256_add_pd(*lo, _mm256_cvtps_pd(_mm256_castps256_ps128(a)));
+        *hi = _mm256_add_pd(*hi, _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)));
+    }
+    SIMD_INLINE double SumWide(dvec lo, dvec hi)
+    {
+        alignas(64) double lanes[W];
+        _mm256_store_pd(lanes, lo);
+        _mm256_store_pd(lanes + 4, hi);
+        double sum = 0;
+        for (unsigned int l = 0; l < W; ++l)
+            sum += lanes[l];
+        return sum;
+    }
+    SIMD_INLINE float Sum(vec a)
+    {
+        alignas(64) float lanes[W];
+        _mm256_store_ps(lanes, a);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+               lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    }
+};
+#include "nbody_simd_kernel.inl"
+}
+#pragma GCC pop_options
+
+// ===== AVX2 + FMA: 8 lanes, fused multiply-add =====
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#pragma GCC optimize("O2")
+namespace simd_avx2
+{
+struct V
+{
+    typedef __m256 vec;
+    static const unsigned int W = 8;
+    SIMD_INLINE vec Set1(float a) { return _mm256_set1_ps(a); }
+    SIMD_INLINE vec Zero() { return _mm256_setzero_ps(); }
+    SIMD_INLINE vec Load(const float *p) { return _mm256_load_ps(p); }
+    SIMD_INLINE vec LoadHalves(const float *lo, const float *hi) { return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(lo)), _mm_load_ps(hi), 1); }
+    SIMD_INLINE vec Add(vec a, vec b) { return _mm256_add_ps(a, b); }
+    SIMD_INLINE vec Sub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+    SIMD_INLINE vec Mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+    SIMD_INLINE vec Div(vec a, vec b) { return _mm256_div_ps(a, b); }
+    SIMD_INLINE vec Sqrt(vec a) { return _mm256_sqrt_ps(a); }
+    SIMD_INLINE vec Rsqrt(vec a) { return _mm256_rsqrt_ps(a); }
+    SIMD_INLINE vec MulAdd(vec a, vec b, vec c) { return _mm256_fmadd_ps(a, b, c); }
+    SIMD_INLINE vec NegMulAdd(vec a, vec b, vec c) { return _mm256_fnmadd_ps(a, b, c); }
+    SIMD_INLINE vec MaskNonZero(vec a, vec b) { return _mm256_and_ps(a, _mm256_cmp_ps(b, _mm256_setzero_ps(), _CMP_NEQ_UQ)); }
+    SIMD_INLINE void Store(float *p, vec a) { _mm256_store_ps(p, a); }
+    typedef __m256d dvec;
+    SIMD_INLINE dvec ZeroWide() { return _mm256_setzero_pd(); }
+    SIMD_INLINE void AddWide(vec a, dvec *lo, dvec *hi)
+    {
+        *lo = _mm256_add_pd(*lo, _mm256_cvtps_pd(_mm256_castps256_ps128(a)));
+        *hi = _mm256_add_pd(*hi, _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)));
+    }
+    SIMD_INLINE double SumWide(dvec lo, dvec hi)
+    {
+        alignas(64) double lanes[W];
+        _mm256_store_pd(lanes, lo);
+        _mm256_store_pd(lanes + 4, hi);
+        double sum = 0;
+        for (unsigned int l = 0; l < W; ++l)
+            sum += lanes[l];
+        return sum;
+    }
+    SIMD_INLINE float Sum(vec a)
+    {
+        alignas(64) float lanes[W];
+        _mm256_store_ps(lanes, a);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+               lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    }
+};
+#include "nbody_simd_kernel.inl"
+}
+#pragma GCC pop_options
+
+// ===== AVX-512: 16 lanes, fused multiply-add, 14-bit rsqrt estimate =====
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC optimize("O2")
+namespace simd_avx512
+{
+struct V
+{
+    typedef __m512 vec;
+    static const unsigned int W = 16;
+    SIMD_INLINE vec Set1(float a) { return _mm512_set1_ps(a); }
+    SIMD_INLINE vec Zero() { return _mm512_setzero_ps(); }
+    SIMD_INLINE vec Load(const float *p) { return _mm512_load_ps(p); }
+    SIMD_INLINE vec LoadHalves(const float *lo, const float *hi)
+    {
+        return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(_mm256_load_ps(lo))),
+                                                   _mm256_castps_pd(_mm256_load_ps(hi)), 1));
+    }
+    SIMD_INLINE vec Add(vec a, vec b) { return _mm512_add_ps(a, b); }
+    SIMD_INLINE vec Sub(vec a, vec b) { return _mm512_sub_ps(a, b); }
+    SIMD_INLINE vec Mul(vec a, vec b) { return _mm512_mul_ps(a, b); }
+    SIMD_INLINE vec Div(vec a, vec b) { return _mm512_div_ps(a, b); }
+    SIMD_INLINE vec Sqrt(vec a) { return _mm512_sqrt_ps(a); }
+    SIMD_INLINE vec Rsqrt(vec a) { return _mm512_rsqrt14_ps(a); }
+    SIMD_INLINE vec MulAdd(vec a, vec b, vec c) { return _mm512_fmadd_ps(a, b, c); }
+    SIMD_INLINE vec NegMulAdd(vec a, vec b, vec c) { return _mm512_fnmadd_ps(a, b, c); }
+    SIMD_INLINE vec MaskNonZero(vec a, vec b) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(b, _mm512_setzero_ps(), _CMP_NEQ_UQ), a); }
+    SIMD_INLINE void Store(float *p, vec a) { _mm512_store_ps(p, a); }
+    typedef __m512d dvec;
+    SIMD_INLINE dvec ZeroWide() { return _mm512_setzero_pd(); }
+    SIMD_INLINE void AddWide(vec a, dvec *lo, dvec *hi)
+    {
+        *lo = _mm512_add_pd(*lo, _mm512_cvtps_pd(_mm512_castps512_ps256(a)));
+        *hi = _mm512_add_pd(*hi, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1))));
+    }
+    SIMD_INLINE double SumWide(dvec lo, dvec hi)
+    {
+        alignas(64) double lanes[W];
+        _mm512_store_pd(lanes, lo);
+        _mm512_store_pd(lanes + 8, hi);
+        double sum = 0;
+        for (unsigned int l = 0; l < W; ++l)
+            sum += lanes[l];
+        return sum;
+    }
+    SIMD_INLINE float Sum(vec a)
+    {
+        alignas(64) float lanes[W];
+        _mm512_store_ps(lanes, a);
+        float sum = 0;
+        for (unsigned int l = 0; l < W; ++l)
+            sum += lanes[l];
+        return sum;
+    }
+};
+#include "nbody_simd_kernel.inl"
+}
+#pragma GCC pop_options
+
+// ===== Runtime dispatch =====
+
+typedef void (*ForceFunction)(const ParticleSystem &, unsigned int, float *, float *, float *);
+
+// Force exerted by all particles of a source system at a point (xi, yi, zi), e.g. a particle of another
+// system: distributed ranks compute their own particles against position blocks received from others
+typedef void (*PointForceFunction)(const ParticleSystem &, float, float, float, float *, float *, float *);
+
+// Same on the AoSoA packets (nbody_aosoa.hpp)
+typedef void (*PacketForceFunction)(const AosoaParticles &, float, float, float, float *, float *, float *);
+
+// How the kernels sum the N force terms of a particle
+enum ForceAccumulation
+{
+    ACCUM_FLOAT,  // W float partial sums (the original kernels)
+    ACCUM_KAHAN,  // W compensated float partial sums, ~2x the adds
+    ACCUM_DOUBLE, // float terms summed in 2 double vectors, rounded to float once at the end
+    ACCUM_COUNT
+};
+
+const char *const accumulationNames[ACCUM_COUNT] = {"float", "kahan", "double"};
+
+enum SimdBackend
+{
+    SIMD_SSE,
+    SIMD_AVX,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_BACKEND_COUNT
+};
+
+struct ForceBackend
+{
+    const char *name;    // value of --backend
+    unsigned int width;  // floats per vector
+    ForceFunction exact[ACCUM_COUNT]; // sqrt + div, indexed by ForceAccumulation
+    ForceFunction fast[ACCUM_COUNT];  // rsqrt + Newton-Raphson
+    PointForceFunction exactAt[ACCUM_COUNT];
+    PointForceFunction fastAt[ACCUM_COUNT];
+    PacketForceFunction exactPacked[ACCUM_COUNT];
+    PacketForceFunction fastPacked[ACCUM_COUNT];
+};
+
+// Ordered from narrowest to widest, indexed by SimdBackend
+const ForceBackend forceBackends[SIMD_BACKEND_COUNT] = {
+    {"sse", 4,
+     {simd_sse::ComputeForceExact, simd_sse::ComputeForceExactKahan, simd_sse::ComputeForceExactDouble},
+     {simd_sse::ComputeForceFast, simd_sse::ComputeForceFastKahan, simd_sse::ComputeForceFastDouble},
+     {simd_sse::ComputeForceExactAt, simd_sse::ComputeForceExactKahanAt, simd_sse::ComputeForceExactDoubleAt},
+     {simd_sse::ComputeForceFastAt, simd_sse::ComputeForceFastKahanAt, simd_sse::ComputeForceFastDoubleAt},
+     {simd_sse::ComputeForceExactPacked, simd_sse::ComputeForceExactKahanPacked, simd_sse::ComputeForceExactDoublePacked},
+     {simd_sse::ComputeForceFastPacked, simd_sse::ComputeForceFastKahanPacked, simd_sse::ComputeForceFastDoublePacked}},
+    {"avx", 8,
+     {simd_avx::ComputeForceExact, simd_avx::ComputeForceExactKahan, simd_avx::ComputeForceExactDouble},
+     {simd_avx::ComputeForceFast, simd_avx::ComputeForceFastKahan, simd_avx::ComputeForceFastDouble},
+     {simd_avx::ComputeForceExactAt, simd_avx::ComputeForceExactKahanAt, simd_avx::ComputeForceExactDoubleAt},
+     {simd_avx::ComputeForceFastAt, simd_avx::ComputeForceFastKahanAt, simd_avx::ComputeForceFastDoubleAt},
+     {simd_avx::ComputeForceExactPacked, simd_avx::ComputeForceExactKahanPacked, simd_avx::ComputeForceExactDoublePacked},
+     {simd_avx::ComputeForceFastPacked, simd_avx::ComputeForceFastKahanPacked, simd_avx::ComputeForceFastDoublePacked}},
+    {"avx2", 8,
+     {simd_avx2::ComputeForceExact, simd_avx2::ComputeForceExactKahan, simd_avx2::ComputeForceExactDouble},
+     {simd_avx2::ComputeForceFast, simd_avx2::ComputeForceFastKahan, simd_avx2::ComputeForceFastDouble},
+     {simd_avx2::ComputeForceExactAt, simd_avx2::ComputeForceExactKahanAt, simd_avx2::ComputeForceExactDoubleAt},
+     {simd_avx2::ComputeForceFastAt, simd_avx2::ComputeForceFastKahanAt, simd_avx2::ComputeForceFastDoubleAt},
+     {simd_avx2::ComputeForceExactPacked, simd_avx2::ComputeForceExactKahanPacked, simd_avx2::ComputeForceExactDoublePacked},
+     {simd_avx2::ComputeForceFastPacked, simd_avx2::ComputeForceFastKahanPacked, simd_avx2::ComputeForceFastDoublePacked}},
+    {"avx512", 16,
+     {simd_avx512::ComputeForceExact, simd_avx512::ComputeForceExactKahan, simd_avx512::ComputeForceExactDouble},
+     {simd_avx512::ComputeForceFast, simd_avx512::ComputeForceFastKahan, simd_avx512::ComputeForceFastDouble},
+     {simd_avx512::ComputeForceExactAt, simd_avx512::ComputeForceExactKahanAt, simd_avx512::ComputeForceExactDoubleAt},
+     {simd_avx512::ComputeForceFastAt, simd_avx512::ComputeForceFastKahanAt, simd_avx512::ComputeForceFastDoubleAt},
+     {simd_avx512::ComputeForceExactPacked, simd_avx512::ComputeForceExactKahanPacked, simd_avx512::ComputeForceExactDoublePacked},
+     {simd_avx512::ComputeForceFastPacked, simd_avx512::ComputeForceFastKahanPacked, simd_avx512::ComputeForceFastDoublePacked}},
+};
+
+// CPUID check for one backend
+bool BackendSupported(SimdBackend backend)
+{
+    __builtin_cpu_init();
+    switch (backend)
+    {
+    case SIMD_SSE: return __builtin_cpu_supports("sse2");
+    case SIMD_AVX: return __builtin_cpu_supports("avx");
+    case SIMD_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case SIMD_AVX512: return __builtin_cpu_supports("avx512f");
+    default: return false;
+    }
+}
+
+// Widest backend supported by the running CPU
+SimdBackend DetectBestBackend()
+{
+    for (int b = SIMD_BACKEND_COUNT - 1; b >= SIMD_SSE; --b)
+    {
+        if (BackendSupported((SimdBackend)b))
+            return (SimdBackend)b;
+    }
+    return SIMD_SSE; // unreachable on x86-64, where SSE2 is part of the architecture
+}
+
+// Backend used by ComputeForceDirect, picked once at startup (overridden by --backend)
+SimdBackend activeBackend = DetectBestBackend();
+
+// Parses "auto" or a backend name. Returns false for unknown names and for backends the CPU lacks.
+bool ParseSimdBackend(const string &text, SimdBackend *backend)
+{
+    if (text == "auto")
+    {
+        *backend = DetectBestBackend();
+        return true;
+    }
+    for (int b = 0; b < SIMD_BACKEND_COUNT; ++b)
+    {
+        if (text == forceBackends[b].name)
+        {
+            *backend = (SimdBackend)b;
+            return BackendSupported(*backend);
+        }
+    }
+    return false;
+}
+
+#endif
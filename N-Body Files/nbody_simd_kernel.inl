@@ -0,0 +1,248 @@
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: ISA-independent direct-sum force kernel. nbody_simd.hpp includes this file once per backend,
+//            inside a namespace that defines the vector traits struct V and inside a
+//            "#pragma GCC target" region, so each copy is compiled for its own instruction set.
+
+//      Note: V provides W (lanes), vec, and always-inline Set1 / Zero / Load / Add / Sub / Mul / Div /
+//            Sqrt / Rsqrt / MulAdd (a * b + c, fused where the ISA has FMA) / NegMulAdd (c - a * b) /
+//            MaskNonZero (a where b != 0, else 0) / LoadHalves (W / 2 lanes from each of two pointers) / Sum / Store,
+//            and the double accumulation helpers dvec / ZeroWide / AddWide (a into two dvec halves) / SumWide.
+
+//      Note: the accumulators have explicit constructors: an implicit one would be defined outside the
+//            "#pragma GCC target" region and could not inline V::Zero().
+
+//      Note: the kernels are templates over the accumulator (FloatSum, KahanSum, DoubleSum) and instantiated
+//            once per mode below. FloatSum keeps the original MulAdd accumulation, so float mode is unchanged.
+//            Kahan and double modes add the float products dx * invDist3; the < W tail terms are added in float.
+
+//      Note: they are also templates over the particle layout (nbody_layout.hpp) and over softening, so the
+//            one loop body below serves every (width, layout, softening) specialization: the width is this
+//            backend's V::W, the layout decides between vector loads and unrolled gathers at compile time,
+//            and Softened = false drops the softening add and masks out the self-interaction.
+//            The dispatch table uses SoaLayout with softening, which compiles to the original kernels.
+
+// Plain float accumulation: one partial sum per lane
+struct FloatSum
+{
+    V::vec sum;
+    inline FloatSum() : sum(V::Zero()) {}
+    inline void Add(V::vec a, V::vec b) { sum = V::MulAdd(a, b, sum); }
+    inline float Total() const { return V::Sum(sum); }
+};
+
+// Kahan compensated float accumulation: carry holds the low-order bits lost by each lane's last add
+struct KahanSum
+{
+    V::vec sum, carry;
+    inline KahanSum() : sum(V::Zero()), carry(V::Zero()) {}
+    inline void Add(V::vec a, V::vec b)
+    {
+        V::vec term = V::Sub(V::Mul(a, b), carry);
+        V::vec next = V::Add(sum, term);
+        carry = V::Sub(V::Sub(next, sum), term);
+        sum = next;
+    }
+    // Compensated horizontal sum of the lanes (sum[l] - carry[l])
+    inline float Total() const
+    {
+        alignas(64) float sums[V::W], carries[V::W];
+        V::Store(sums, sum);
+        V::Store(carries, carry);
+        float total = 0, c = 0;
+        for (unsigned int l = 0; l < V::W; ++l)
+        {
+            const float terms[2] = {sums[l], -carries[l]};
+            for (float value : terms)
+            {
+                float y = value - c;
+                float t = total + y;
+                c = (t - total) - y;
+                total = t;
+            }
+        }
+        return total;
+    }
+};
+
+// Double accumulation of the float terms, W doubles split over two vectors
+struct DoubleSum
+{
+    V::dvec lo, hi;
+    inline DoubleSum() : lo(V::ZeroWide()), hi(V::ZeroWide()) {}
+    inline void Add(V::vec a, V::vec b) { V::AddWide(V::Mul(a, b), &lo, &hi); }
+    inline float Total() const { return (float)V::SumWide(lo, hi); }
+};
+
+// W consecutive coordinates starting at base[Offset(j)], j a multiple of W: one aligned load when the layout
+// keeps W particles contiguous, two half-width loads when it keeps W / 2 (AoSoA packets on AVX-512), a
+// lane-by-lane gather otherwise (fully unrolled, W and RUN are constants)
+template <class Layout>
+SIMD_INLINE V::vec LoadLanes(const float *base, unsigned int j)
+{
+    if constexpr (V::W <= Layout::RUN)
+        return V::Load(base + Layout::Offset(j));
+    else if constexpr (V::W == 2 * Layout::RUN)
+        return V::LoadHalves(base + Layout::Offset(j), base + Layout::Offset(j + Layout::RUN));
+    else
+    {
+        alignas(64) float lanes[V::W];
+        for (unsigned int l = 0; l < V::W; ++l)
+            lanes[l] = base[Layout::Offset(j + l)];
+        return V::Load(lanes);
+    }
+}
+
+// Scalar interactions with particles [jStart, n) for the tail that does not fill a whole vector, same
+// operation order as AddTailForceAt (and as the exact vector body)
+template <class Layout, bool Softened>
+inline void AddTailLayout(const LayoutView &view, float xi, float yi, float zi, unsigned int jStart,
+                          float *Fx, float *Fy, float *Fz)
+{
+    for (unsigned int j = jStart; j < view.n; ++j)
+    {
+        const unsigned int o = Layout::Offset(j);
+        const float dx = view.x[o] - xi;
+        const float dy = view.y[o] - yi;
+        const float dz = view.z[o] - zi;
+        const float distSqr = Softened ? (dx * dx + softening) + (dy * dy + dz * dz) : dx * dx + (dy * dy + dz * dz);
+        if (!Softened && distSqr == 0.0f)
+            continue;
+        const float invDist = 1.0f / sqrtf(distSqr);
+        const float invDist3 = invDist * (invDist * invDist);
+        *Fx += dx * invDist3;
+        *Fy += dy * invDist3;
+        *Fz += dz * invDist3;
+    }
+}
+
+// Direct-sum force of all particles of src at (xi, yi, zi): sqrt + div, W particles per iteration.
+// Without softening, pairs at distance 0 (the particle itself) are masked out instead of regularized.
+template <class Layout, bool Softened, class Sum>
+inline void ForceExact(const typename Layout::Source &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz)
+{
+    const LayoutView view = Layout::Open(src);
+    const V::vec oneVector = V::Set1(1.0f);
+    const V::vec softVector = V::Set1(softening);
+
+    Sum FxSum, FySum, FzSum;
+
+    // Load current particle position as SIMD vector
+    const V::vec PixVector = V::Set1(xi);
+    const V::vec PiyVector = V::Set1(yi);
+    const V::vec PizVector = V::Set1(zi);
+
+    // Iterate over all particles in vectorized blocks of W (arrays are 64-byte aligned)
+    unsigned int j = 0;
+    for (; j + V::W <= view.n; j += V::W)
+    {
+        // Compute displacement vectors
+        V::vec dx = V::Sub(LoadLanes<Layout>(view.x, j), PixVector);
+        V::vec dy = V::Sub(LoadLanes<Layout>(view.y, j), PiyVector);
+        V::vec dz = V::Sub(LoadLanes<Layout>(view.z, j), PizVector);
+
+        // Squared distance + softening, same operation order as the original AVX kernel
+        V::vec temp1 = Softened ? V::Add(V::Mul(dx, dx), softVector) : V::Mul(dx, dx);
+        V::vec temp2 = V::Add(V::Mul(dy, dy), V::Mul(dz, dz));
+        V::vec distSqr = V::Sqrt(V::Add(temp1, temp2));
+
+        // Compute 1 / distance and its cube
+        V::vec invDist = V::Div(oneVector, distSqr);
+        V::vec invDist3 = V::Mul(invDist, V::Mul(invDist, invDist));
+        if (!Softened)
+            invDist3 = V::MaskNonZero(invDist3, distSqr);
+
+        // Accumulate forces
+        FxSum.Add(dx, invDist3);
+        FySum.Add(dy, invDist3);
+        FzSum.Add(dz, invDist3);
+    }
+
+    *Fx = FxSum.Total();
+    *Fy = FySum.Total();
+    *Fz = FzSum.Total();
+    AddTailLayout<Layout, Softened>(view, xi, yi, zi, j, Fx, Fy, Fz);
+}
+
+// Same as ForceExact, but replaces sqrt and div (the two highest-latency instructions of the loop)
+// with a hardware reciprocal square root estimate refined by one Newton-Raphson step
+template <class Layout, bool Softened, class Sum>
+inline void ForceFast(const typename Layout::Source &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz)
+{
+    const LayoutView view = Layout::Open(src);
+    const V::vec halfVector = V::Set1(0.5f);
+    const V::vec threeHalvesVector = V::Set1(1.5f);
+    const V::vec softVector = V::Set1(Softened ? softening : 0.0f);
+
+    Sum FxSum, FySum, FzSum;
+
+    const V::vec PixVector = V::Set1(xi);
+    const V::vec PiyVector = V::Set1(yi);
+    const V::vec PizVector = V::Set1(zi);
+
+    unsigned int j = 0;
+    for (; j + V::W <= view.n; j += V::W)
+    {
+        V::vec dx = V::Sub(LoadLanes<Layout>(view.x, j), PixVector);
+        V::vec dy = V::Sub(LoadLanes<Layout>(view.y, j), PiyVector);
+        V::vec dz = V::Sub(LoadLanes<Layout>(view.z, j), PizVector);
+
+        // r^2 + softening
+        V::vec distSqr = V::MulAdd(dx, dx, softVector);
+        distSqr = V::MulAdd(dy, dy, distSqr);
+        distSqr = V::MulAdd(dz, dz, distSqr);
+
+        // y = rsqrt(r^2), then y = y * (1.5 - 0.5 * r^2 * y * y)
+        V::vec invDist = V::Rsqrt(distSqr);
+        V::vec halfRY = V::Mul(V::Mul(halfVector, distSqr), invDist);
+        invDist = V::Mul(invDist, V::NegMulAdd(halfRY, invDist, threeHalvesVector));
+        V::vec invDist3 = V::Mul(invDist, V::Mul(invDist, invDist));
+        if (!Softened)
+            invDist3 = V::MaskNonZero(invDist3, distSqr);
+
+        FxSum.Add(dx, invDist3);
+        FySum.Add(dy, invDist3);
+        FzSum.Add(dz, invDist3);
+    }
+
+    *Fx = FxSum.Total();
+    *Fy = FySum.Total();
+    *Fz = FzSum.Total();
+    AddTailLayout<Layout, Softened>(view, xi, yi, zi, j, Fx, Fy, Fz);
+}
+
+// One entry point per (precision, accumulation), referenced by forceBackends[]: on particle i of ps,
+// and at a point (the "At" variants)
+void ComputeForceExact(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz) { ForceExact<SoaLayout, true, FloatSum>(ps, ps.x[i], ps.y[i], ps.z[i], Fx, Fy, Fz); }
+void ComputeForceExactKahan(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz) { ForceExact<SoaLayout, true, KahanSum>(ps, ps.x[i], ps.y[i], ps.z[i], Fx, Fy, Fz); }
+void ComputeForceExactDouble(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz) { ForceExact<SoaLayout, true, DoubleSum>(ps, ps.x[i], ps.y[i], ps.z[i], Fx, Fy, Fz); }
+void ComputeForceFast(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz) { ForceFast<SoaLayout, true, FloatSum>(ps, ps.x[i], ps.y[i], ps.z[i], Fx, Fy, Fz); }
+void ComputeForceFastKahan(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz) { ForceFast<SoaLayout, true, KahanSum>(ps, ps.x[i], ps.y[i], ps.z[i], Fx, Fy, Fz); }
+void ComputeForceFastDouble(const ParticleSystem &ps, unsigned int i, float *Fx, float *Fy, float *Fz) { ForceFast<SoaLayout, true, DoubleSum>(ps, ps.x[i], ps.y[i], ps.z[i], Fx, Fy, Fz); }
+void ComputeForceExactAt(const ParticleSystem &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceExact<SoaLayout, true, FloatSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceExactKahanAt(const ParticleSystem &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceExact<SoaLayout, true, KahanSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceExactDoubleAt(const ParticleSystem &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceExact<SoaLayout, true, DoubleSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceFastAt(const ParticleSystem &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceFast<SoaLayout, true, FloatSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceFastKahanAt(const ParticleSystem &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceFast<SoaLayout, true, KahanSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceFastDoubleAt(const ParticleSystem &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceFast<SoaLayout, true, DoubleSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+
+// Exact kernel with float accumulation on any layout, with or without softening: the serial reference
+// (AosLayout on simd_scalar) and the layout benchmark. Explicit instantiations below compile every
+// (layout, softening) specialization inside this backend's target region.
+template <class Layout, bool Softened>
+void ComputeForceLayout(const typename Layout::Source &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceExact<Layout, Softened, FloatSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+template void ComputeForceLayout<SoaLayout, true>(const SoaLayout::Source &, float, float, float, float *, float *, float *);
+template void ComputeForceLayout<SoaLayout, false>(const SoaLayout::Source &, float, float, float, float *, float *, float *);
+template void ComputeForceLayout<AosLayout, true>(const AosLayout::Source &, float, float, float, float *, float *, float *);
+template void ComputeForceLayout<AosLayout, false>(const AosLayout::Source &, float, float, float, float *, float *, float *);
+template void ComputeForceLayout<AosoaLayout, true>(const AosoaLayout::Source &, float, float, float, float *, float *, float *);
+template void ComputeForceLayout<AosoaLayout, false>(const AosoaLayout::Source &, float, float, float, float *, float *, float *);
+
+// Entry points on the AoSoA packets, referenced by forceBackends[] (exactPacked / fastPacked)
+void ComputeForceExactPacked(const AosoaParticles &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceExact<AosoaLayout, true, FloatSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceExactKahanPacked(const AosoaParticles &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceExact<AosoaLayout, true, KahanSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceExactDoublePacked(const AosoaParticles &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceExact<AosoaLayout, true, DoubleSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceFastPacked(const AosoaParticles &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceFast<AosoaLayout, true, FloatSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceFastKahanPacked(const AosoaParticles &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceFast<AosoaLayout, true, KahanSum>(src, xi, yi, zi, Fx, Fy, Fz); }
+void ComputeForceFastDoublePacked(const AosoaParticles &src, float xi, float yi, float zi, float *Fx, float *Fy, float *Fz) { ForceFast<AosoaLayout, true, DoubleSum>(src, xi, yi, zi, Fx, Fy, Fz); }
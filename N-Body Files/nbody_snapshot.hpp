@@ -0,0 +1,180 @@
+#ifndef NBODY_SNAPSHOT_HPP
+#define NBODY_SNAPSHOT_HPP
+
+#include "particle_system.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: binary snapshot format (.nbs), native byte order (little endian on x86-64):
+//              [ 64-byte SnapshotHeader ][ x | y | z | vx | vy | vz ], each array `stride` floats
+//            The body is the ParticleSystem block byte for byte, padding included, so it is written with
+//            one large write() and read back bit-exact (the text output keeps ~6 significant digits).
+
+//      Note: the header is one cache line, so the body of a file mapped at a page boundary is 64-byte
+//            aligned and the SIMD kernels can run on the mapping directly. Restart maps the file
+//            MAP_PRIVATE: pages are loaded on first touch, and the simulation's writes go to private
+//            copy-on-write pages, so the checkpoint on disk is never modified.
+
+//      Note: checkpoints are written to "<path>.tmp" and renamed over <path>, so a crash mid-write
+//            leaves the previous checkpoint intact.
+
+const char SNAPSHOT_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'S', 'N', 'P'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader
+{
+    char magic[8];      // SNAPSHOT_MAGIC
+    uint32_t version;   // SNAPSHOT_VERSION
+    uint32_t n;         // number of particles
+    uint32_t stride;    // floats per array, PaddedCount(n)
+    uint32_t reserved;
+    uint64_t step;      // steps completed when the snapshot was taken
+    float dt;
+    float softening;
+    uint8_t padding[24];
+};
+
+static_assert(sizeof(SnapshotHeader) == CACHE_LINE, "snapshot header must be one cache line");
+
+// Writes all `bytes` bytes, retrying partial writes. Returns false on error.
+bool WriteFully(int fd, const void *data, size_t bytes)
+{
+    const char *p = (const char *)data;
+    while (bytes > 0)
+    {
+        ssize_t written = write(fd, p, bytes);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += written;
+        bytes -= (size_t)written;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes ps as a binary snapshot taken after `step` steps.
+ *
+ * @return false (with *error set) if the file cannot be written.
+ */
+bool SaveSnapshot(const ParticleSystem &ps, uint64_t step, const string &path, string *error)
+{
+    SnapshotHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.n = ps.n;
+    header.stride = ps.stride;
+    header.step = step;
+    header.dt = dt;
+    header.softening = softening;
+
+    string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        *error = "cannot create " + tmpPath + ": " + strerror(errno);
+        return false;
+    }
+    // ps.x is the start of the contiguous six-array block
+    bool ok = WriteFully(fd, &header, sizeof(header)) && WriteFully(fd, ps.x, ps.BlockBytes());
+    if (!ok)
+        *error = "cannot write " + tmpPath + ": " + strerror(errno);
+    if (close(fd) != 0 && ok)
+    {
+        *error = "cannot close " + tmpPath + ": " + strerror(errno);
+        ok = false;
+    }
+    if (ok && rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        *error = "cannot rename " + tmpPath + " to " + path + ": " + strerror(errno);
+        ok = false;
+    }
+    if (!ok)
+        unlink(tmpPath.c_str());
+    return ok;
+}
+
+// Checks a header against the file size and the compiled simulation parameters
+bool CheckSnapshotHeader(const SnapshotHeader &header, size_t fileBytes, string *error)
+{
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0)
+    {
+        *error = "not an N-body snapshot (bad magic)";
+        return false;
+    }
+    if (header.version != SNAPSHOT_VERSION)
+    {
+        *error = "unsupported snapshot version " + to_string(header.version);
+        return false;
+    }
+    if (header.stride != PaddedCount(header.n) ||
+        fileBytes != sizeof(SnapshotHeader) + 6 * (size_t)header.stride * sizeof(float))
+    {
+        *error = "snapshot size does not match its header (truncated file?)";
+        return false;
+    }
+    if (header.dt != dt || header.softening != softening)
+    {
+        *error = "snapshot was taken with dt = " + to_string(header.dt) + ", softening = " +
+                 to_string(header.softening) + ", this build uses different values";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Maps a snapshot copy-on-write and returns a ParticleSystem backed by the mapping.
+ *
+ * @param header Receives the snapshot header (step to resume from).
+ * @return nullptr (with *error set) if the file is missing, malformed or from another configuration.
+ */
+unique_ptr<ParticleSystem> MapSnapshot(const string &path, SnapshotHeader *header, string *error)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        *error = "cannot open " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SnapshotHeader))
+    {
+        *error = path + " is too small to be a snapshot";
+        close(fd);
+        return nullptr;
+    }
+    size_t fileBytes = (size_t)info.st_size;
+
+    // PROT_WRITE + MAP_PRIVATE: the simulation updates private copies of the pages, never the file
+    void *mapping = mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        *error = "cannot map " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+
+    memcpy(header, mapping, sizeof(SnapshotHeader));
+    if (!CheckSnapshotHeader(*header, fileBytes, error))
+    {
+        munmap(mapping, fileBytes);
+        return nullptr;
+    }
+    return unique_ptr<ParticleSystem>(new ParticleSystem(header->n, mapping, fileBytes, sizeof(SnapshotHeader)));
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef NBODY_SYMMETRIC_HPP
+#define NBODY_SYMMETRIC_HPP
+
+#include "nbody_parallel.hpp"
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: MoveChunk computes every (i, j) pair twice, once from each side. The symmetric kernel uses
+//            Newton's third law: each pair i < j is computed once, f is added to i and subtracted
+//            from j, which nearly halves the flop count.
+
+//      Note: the "subtract from j" writes conflict between threads. Instead of a lock, every thread
+//            accumulates into its own force buffer, and a second parallel phase sums the buffers
+//            per particle and updates the velocities (the reduction is O(T * N), the pair phase O(N^2 / 2)).
+
+//      Note: row i has n - 1 - i pairs, so rows are handed out in folded pairs (i, n - 1 - i) which all
+//            cost n - 1 interactions, and contiguous chunks of folded pairs are balanced.
+
+//      Note: AVX, compiled with the same target / optimize pragmas as nbody_tiled.hpp.
+//            Results differ from MoveChunk in the last bits (different summation order). On the lattice
+//            initial state this splits coincident particles by ~1e-9 after one step, and with the tiny
+//            softening their next-step forces blow up, so compare single steps (validate.exe --symmetric).
+
+// Per-thread force buffers: thread t owns [fx | fy | fz] at data + 3 * stride * t
+struct SymmetricBuffers
+{
+    float *data = nullptr;
+    unsigned int nThreads = 0;
+    unsigned int stride = 0;
+};
+
+SymmetricBuffers symmetricBuffers;
+
+bool SymmetricKernelSupported()
+{
+    return BackendSupported(SIMD_AVX);
+}
+
+// (Re)allocates zeroed buffers for nThreads threads and a system of ps.stride particles
+void PrepareSymmetricBuffers(const ParticleSystem &ps, unsigned int nThreads)
+{
+    if (symmetricBuffers.data != nullptr && symmetricBuffers.nThreads == nThreads && symmetricBuffers.stride == ps.stride)
+        return;
+    free(symmetricBuffers.data);
+    symmetricBuffers.data = (float *)AllocateAligned(3 * (size_t)ps.stride * nThreads * sizeof(float));
+    symmetricBuffers.nThreads = nThreads;
+    symmetricBuffers.stride = ps.stride;
+}
+
+#pragma GCC push_options
+#pragma GCC target("avx")
+#pragma GCC optimize("O2")
+
+// Computes pairs (i, j > i), adding +f to particle i and -f to particle j in the thread's buffer
+void SymmetricRow(const ParticleSystem &ps, unsigned int i, float *bx, float *by, float *bz)
+{
+    const __m256 oneVector = _mm256_set1_ps(1.0f);
+    const __m256 softVector = _mm256_set1_ps(softening);
+    const __m256 PixVector = _mm256_set1_ps(ps.x[i]);
+    const __m256 PiyVector = _mm256_set1_ps(ps.y[i]);
+    const __m256 PizVector = _mm256_set1_ps(ps.z[i]);
+
+    __m256 FxVector = _mm256_setzero_ps();
+    __m256 FyVector = _mm256_setzero_ps();
+    __m256 FzVector = _mm256_setzero_ps();
+
+    // j starts right after i, so loads are unaligned
+    unsigned int j = i + 1;
+    for (; j + 8 <= ps.n; j += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&ps.x[j]), PixVector);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&ps.y[j]), PiyVector);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&ps.z[j]), PizVector);
+
+        __m256 temp1 = _mm256_add_ps(_mm256_mul_ps(dx, dx), softVector);
+        __m256 temp2 = _mm256_add_ps(_mm256_mul_ps(dy, dy), _mm256_mul_ps(dz, dz));
+        __m256 invDist = _mm256_div_ps(oneVector, _mm256_sqrt_ps(_mm256_add_ps(temp1, temp2)));
+        __m256 invDist3 = _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist));
+
+        __m256 fx = _mm256_mul_ps(dx, invDist3);
+        __m256 fy = _mm256_mul_ps(dy, invDist3);
+        __m256 fz = _mm256_mul_ps(dz, invDist3);
+
+        // Action on i, reaction on the 8 j's
+        FxVector = _mm256_add_ps(FxVector, fx);
+        FyVector = _mm256_add_ps(FyVector, fy);
+        FzVector = _mm256_add_ps(FzVector, fz);
+        _mm256_storeu_ps(&bx[j], _mm256_sub_ps(_mm256_loadu_ps(&bx[j]), fx));
+        _mm256_storeu_ps(&by[j], _mm256_sub_ps(_mm256_loadu_ps(&by[j]), fy));
+        _mm256_storeu_ps(&bz[j], _mm256_sub_ps(_mm256_loadu_ps(&bz[j]), fz));
+    }
+
+    alignas(32) float lanes[8];
+    float Fx = 0, Fy = 0, Fz = 0;
+    _mm256_store_ps(lanes, FxVector);
+    for (int l = 0; l < 8; ++l)
+        Fx += lanes[l];
+    _mm256_store_ps(lanes, FyVector);
+    for (int l = 0; l < 8; ++l)
+        Fy += lanes[l];
+    _mm256_store_ps(lanes, FzVector);
+    for (int l = 0; l < 8; ++l)
+        Fz += lanes[l];
+
+    // Scalar tail
+    for (; j < ps.n; ++j)
+    {
+        const float dx = ps.x[j] - ps.x[i];
+        const float dy = ps.y[j] - ps.y[i];
+        const float dz = ps.z[j] - ps.z[i];
+        const float invDist = 1.0f / sqrtf((dx * dx + softening) + (dy * dy + dz * dz));
+        const float invDist3 = invDist * (invDist * invDist);
+        Fx += dx * invDist3;
+        Fy += dy * invDist3;
+        Fz += dz * invDist3;
+        bx[j] -= dx * invDist3;
+        by[j] -= dy * invDist3;
+        bz[j] -= dz * invDist3;
+    }
+
+    bx[i] += Fx;
+    by[i] += Fy;
+    bz[i] += Fz;
+}
+
+#pragma GCC pop_options
+
+// Pair phase of thread t: folded row pairs (r, n - 1 - r) for r in the thread's chunk of [0, ceil(n / 2))
+void SymmetricPairChunk(const ParticleSystem &ps, unsigned int t, unsigned int nThreads)
+{
+    float *bx = symmetricBuffers.data + 3 * (size_t)symmetricBuffers.stride * t;
+    float *by = bx + symmetricBuffers.stride;
+    float *bz = by + symmetricBuffers.stride;
+
+    unsigned int start, end;
+    ChunkBounds(t, nThreads, (ps.n + 1) / 2, &start, &end);
+    for (unsigned int r = start; r < end; ++r)
+    {
+        SymmetricRow(ps, r, bx, by, bz);
+        unsigned int mirror = ps.n - 1 - r;
+        if (mirror != r)
+            SymmetricRow(ps, mirror, bx, by, bz);
+    }
+}
+
+// Reduction phase: sums the per-thread buffers of [start, end), clears them and updates velocities
+void SymmetricReduceChunk(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    const size_t stride = symmetricBuffers.stride;
+    for (unsigned int i = start; i < end; ++i)
+    {
+        float Fx = 0, Fy = 0, Fz = 0;
+        for (unsigned int t = 0; t < symmetricBuffers.nThreads; ++t)
+        {
+            float *b = symmetricBuffers.data + 3 * stride * t;
+            Fx += b[i];
+            Fy += b[stride + i];
+            Fz += b[2 * stride + i];
+            b[i] = b[stride + i] = b[2 * stride + i] = 0.0f;
+        }
+        ps.vx[i] += dt * Fx;
+        ps.vy[i] += dt * Fy;
+        ps.vz[i] += dt * Fz;
+    }
+}
+
+// Symmetric counterpart of StartThreads(ps, MoveChunk): pair phase, then reduction phase
+void MoveSymmetric(ParticleSystem &ps, ThreadPool &pool = WorkerPool())
+{
+    PrepareSymmetricBuffers(ps, pool.Size());
+    pool.Run([&ps, &pool](unsigned int t)
+    {
+        SymmetricPairChunk(ps, t, pool.Size());
+    });
+    StartThreads(ps, SymmetricReduceChunk, pool);
+}
+
+#endif
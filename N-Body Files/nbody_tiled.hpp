@@ -0,0 +1,178 @@
+#ifndef NBODY_TILED_HPP
+#define NBODY_TILED_HPP
+
+#include "nbody_parallel.hpp"
+#include <string>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: MoveChunk streams all of x/y/z once per i-particle, so at large N each thread re-reads
+//            3*N floats per particle from L2/L3. The tiled kernel walks j in tiles of jTile particles
+//            (3 * 4 * jTile bytes, 12 KB for 1024, fits L1) and, inside a tile, updates iBlock
+//            i-particles per loaded j-vector, so every load feeds iBlock interactions.
+
+//      Note: force accumulators of the chunk's i-particles persist across tiles in a per-thread
+//            scratch buffer. Each lane still sums j in increasing order, so the result is bit-identical
+//            to MoveChunk on the avx backend (--backend avx).
+
+//      Note: this kernel is AVX only, compiled with the same target / optimize pragmas as the AVX backend
+//            in nbody_simd.hpp. Check TiledKernelSupported() before selecting it.
+
+struct TileConfig
+{
+    unsigned int jTile;  // j-particles per L1 tile (multiple of 8)
+    unsigned int iBlock; // i-particles kept in registers per j-vector (1, 2, 4 or 8)
+};
+
+// Default tile, overridden by --tile <jTile>x<iBlock>
+TileConfig tileConfig = {1024, 4};
+
+// Parses "<jTile>x<iBlock>", returns false on malformed or unsupported values
+bool ParseTileConfig(const string &text, TileConfig *config)
+{
+    size_t sep = text.find('x');
+    if (sep == string::npos)
+        return false;
+    unsigned int jTile = (unsigned int)stoul(text.substr(0, sep));
+    unsigned int iBlock = (unsigned int)stoul(text.substr(sep + 1));
+    if (jTile == 0 || jTile % 8 != 0)
+        return false;
+    if (iBlock != 1 && iBlock != 2 && iBlock != 4 && iBlock != 8)
+        return false;
+    config->jTile = jTile;
+    config->iBlock = iBlock;
+    return true;
+}
+
+bool TiledKernelSupported()
+{
+    return BackendSupported(SIMD_AVX);
+}
+
+// Vector force accumulators of one i-particle (plain floats so the buffer needs no AVX to manage)
+struct alignas(32) ForceAccumulator
+{
+    float Fx[8], Fy[8], Fz[8];
+};
+
+// Per-thread accumulators for the i-particles of the current chunk
+thread_local vector<ForceAccumulator> tileAccumulators;
+
+#pragma GCC push_options
+#pragma GCC target("avx")
+#pragma GCC optimize("O2")
+
+// Sums the 8 lanes in the same order as the avx backend
+inline float HorizontalSum8(const float *lanes)
+{
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+// Interacts IB i-particles [i, i + IB) with the j-range [jBegin, jEnd) of one tile
+template <int IB>
+void InteractBlockTile(const ParticleSystem &ps, unsigned int i, ForceAccumulator *acc, unsigned int jBegin, unsigned int jEnd)
+{
+    const __m256 oneVector = _mm256_set1_ps(1.0f);
+    const __m256 softVector = _mm256_set1_ps(softening);
+
+    __m256 Fx[IB], Fy[IB], Fz[IB];
+    __m256 Pix[IB], Piy[IB], Piz[IB];
+    for (int b = 0; b < IB; ++b)
+    {
+        Fx[b] = _mm256_load_ps(acc[b].Fx);
+        Fy[b] = _mm256_load_ps(acc[b].Fy);
+        Fz[b] = _mm256_load_ps(acc[b].Fz);
+        Pix[b] = _mm256_set1_ps(ps.x[i + b]);
+        Piy[b] = _mm256_set1_ps(ps.y[i + b]);
+        Piz[b] = _mm256_set1_ps(ps.z[i + b]);
+    }
+
+    for (unsigned int j = jBegin; j < jEnd; j += 8)
+    {
+        // One load of 8 j-positions serves all IB i-particles
+        __m256 PjxVector = _mm256_load_ps(&ps.x[j]);
+        __m256 PjyVector = _mm256_load_ps(&ps.y[j]);
+        __m256 PjzVector = _mm256_load_ps(&ps.z[j]);
+
+        for (int b = 0; b < IB; ++b)
+        {
+            __m256 dx = _mm256_sub_ps(PjxVector, Pix[b]);
+            __m256 dy = _mm256_sub_ps(PjyVector, Piy[b]);
+            __m256 dz = _mm256_sub_ps(PjzVector, Piz[b]);
+
+            __m256 temp1 = _mm256_add_ps(_mm256_mul_ps(dx, dx), softVector);
+            __m256 temp2 = _mm256_add_ps(_mm256_mul_ps(dy, dy), _mm256_mul_ps(dz, dz));
+            __m256 distSqr = _mm256_sqrt_ps(_mm256_add_ps(temp1, temp2));
+
+            __m256 invDist = _mm256_div_ps(oneVector, distSqr);
+            __m256 invDist3 = _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist));
+
+            Fx[b] = _mm256_add_ps(Fx[b], _mm256_mul_ps(dx, invDist3));
+            Fy[b] = _mm256_add_ps(Fy[b], _mm256_mul_ps(dy, invDist3));
+            Fz[b] = _mm256_add_ps(Fz[b], _mm256_mul_ps(dz, invDist3));
+        }
+    }
+
+    for (int b = 0; b < IB; ++b)
+    {
+        _mm256_store_ps(acc[b].Fx, Fx[b]);
+        _mm256_store_ps(acc[b].Fy, Fy[b]);
+        _mm256_store_ps(acc[b].Fz, Fz[b]);
+    }
+}
+
+// Tiled counterpart of MoveChunk for a fixed iBlock
+template <int IB>
+void MoveChunkTiledBlock(ParticleSystem &ps, unsigned int start, unsigned int end, unsigned int jTile)
+{
+    const unsigned int count = end - start;
+    const unsigned int nVector = ps.n / 8 * 8; // j-range covered by full vectors
+    tileAccumulators.assign(count, ForceAccumulator());
+
+    for (unsigned int jBegin = 0; jBegin < nVector; jBegin += jTile)
+    {
+        unsigned int jEnd = (jBegin + jTile < nVector) ? jBegin + jTile : nVector;
+
+        unsigned int i = start;
+        for (; i + IB <= end; i += IB)
+            InteractBlockTile<IB>(ps, i, &tileAccumulators[i - start], jBegin, jEnd);
+        // i-particles that do not fill a whole block
+        for (; i < end; ++i)
+            InteractBlockTile<1>(ps, i, &tileAccumulators[i - start], jBegin, jEnd);
+    }
+
+    for (unsigned int i = start; i < end; ++i)
+    {
+        const ForceAccumulator &acc = tileAccumulators[i - start];
+        float Fx = HorizontalSum8(acc.Fx);
+        float Fy = HorizontalSum8(acc.Fy);
+        float Fz = HorizontalSum8(acc.Fz);
+
+        // Scalar tail when n is not a multiple of 8
+        AddTailForce(ps, i, nVector, &Fx, &Fy, &Fz);
+
+        ps.vx[i] += dt * Fx;
+        ps.vy[i] += dt * Fy;
+        ps.vz[i] += dt * Fz;
+    }
+}
+
+// Cache-blocked MoveChunk using the global tileConfig
+void MoveChunkTiled(ParticleSystem &ps, unsigned int start, unsigned int end)
+{
+    switch (tileConfig.iBlock)
+    {
+    case 1: MoveChunkTiledBlock<1>(ps, start, end, tileConfig.jTile); break;
+    case 2: MoveChunkTiledBlock<2>(ps, start, end, tileConfig.jTile); break;
+    case 4: MoveChunkTiledBlock<4>(ps, start, end, tileConfig.jTile); break;
+    default: MoveChunkTiledBlock<8>(ps, start, end, tileConfig.jTile); break;
+    }
+}
+
+#pragma GCC pop_options
+
+#endif
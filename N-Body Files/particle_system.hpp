@@ -0,0 +1,304 @@
+#ifndef PARTICLE_SYSTEM_HPP
+#define PARTICLE_SYSTEM_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: particle storage is sized at runtime (--n), so one binary can sweep N without a recompile.
+
+//      Note: a ParticleSystem either owns a heap block, adopts a memory mapping of the same layout
+//            (a snapshot file mapped by nbody_snapshot.hpp) which it unmaps on destruction, or is a
+//            non-owning view over arrays owned elsewhere (position replicas, double buffers, ring blocks).
+
+//      Note: every buffer is 64-byte (cache line) aligned, and SoA arrays are padded to a multiple of
+//            PARTICLE_PADDING floats so that each array starts on its own cache line.
+
+//      Note: the inner j loop walks all six arrays for every i, so at millions of particles each array spans
+//            thousands of 4 KB pages and the force phase misses the dTLB. With pageConfig.requested set
+//            (--huge-pages), blocks of at least one huge page are mapped with 2 MB pages instead: hugetlbfs
+//            pages (MAP_HUGETLB, needs pages reserved in /proc/sys/vm/nr_hugepages) or transparent huge
+//            pages (a 2 MB aligned anonymous mapping with madvise(MADV_HUGEPAGE)). hugetlb falls back to THP,
+//            THP to ordinary pages when the kernel has it disabled; each block records what it got and why.
+//            The mapped pages are untouched zero pages, so NUMA first touch still applies.
+
+// Simulation parameters (shared by the serial and parallel implementations)
+const float dt = 0.01f;
+const float softening = 1e-20f;
+
+// Problem size used when --n is not given
+const unsigned int DEFAULT_PARTICLES = 16384 * 2;
+
+// Single particle view, used to exchange particles between layouts
+typedef struct
+{
+    float x, y, z, vx, vy, vz;
+} OneParticle;
+
+const size_t CACHE_LINE = 64;
+const size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+const unsigned int PARTICLE_PADDING = CACHE_LINE / sizeof(float); // 16 floats
+
+// Rounds n up to a multiple of PARTICLE_PADDING
+inline unsigned int PaddedCount(unsigned int n)
+{
+    return (n + PARTICLE_PADDING - 1) / PARTICLE_PADDING * PARTICLE_PADDING;
+}
+
+// Allocates a cache-line aligned block of `bytes` bytes (rounded up as aligned_alloc requires), zeroed
+// unless zero is false. An unzeroed large block is fresh untouched pages, placed by the first thread to
+// write them (NUMA first touch).
+inline void *AllocateAligned(size_t bytes, bool zero = true)
+{
+    size_t rounded = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    void *block = aligned_alloc(CACHE_LINE, rounded == 0 ? CACHE_LINE : rounded);
+    if (block == nullptr)
+        throw bad_alloc();
+    if (zero)
+        memset(block, 0, rounded);
+    return block;
+}
+
+// Page size backing a particle block
+enum PageBacking
+{
+    PAGES_SMALL,   // ordinary 4 KB pages (aligned_alloc)
+    PAGES_THP,     // transparent huge pages, madvise(MADV_HUGEPAGE)
+    PAGES_HUGETLB, // explicit hugetlbfs pages, MAP_HUGETLB
+    PAGES_COUNT
+};
+
+const char *const pageBackingNames[PAGES_COUNT] = {"off", "thp", "hugetlb"};
+
+struct PageConfig
+{
+    PageBacking requested = PAGES_SMALL; // --huge-pages, applies to every ParticleSystem block of >= 2 MB
+};
+
+PageConfig pageConfig;
+
+bool ParsePageBacking(const string &text, PageBacking *backing)
+{
+    for (int b = 0; b < PAGES_COUNT; ++b)
+    {
+        if (text == pageBackingNames[b])
+        {
+            *backing = (PageBacking)b;
+            return true;
+        }
+    }
+    return false;
+}
+
+// True unless /sys/kernel/mm/transparent_hugepage/enabled says [never] (madvise alone does not tell)
+inline bool TransparentHugePagesEnabled()
+{
+    FILE *file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (file == nullptr)
+        return false;
+    char line[128] = {};
+    bool enabled = fgets(line, sizeof(line), file) != nullptr && strstr(line, "[never]") == nullptr;
+    fclose(file);
+    return enabled;
+}
+
+/**
+ * @brief Maps `bytes` (rounded up to whole huge pages) of fresh zero pages backed as close to `requested` as
+ *        the system allows. *used is the backing obtained, *fallback why it is less than requested (empty if
+ *        it is not). Returns nullptr only if mmap itself fails; otherwise release with munmap(block, *mappedBytes).
+ */
+inline void *MapHugePages(size_t bytes, PageBacking requested, size_t *mappedBytes, PageBacking *used, string *fallback)
+{
+    const size_t rounded = (bytes + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+    fallback->clear();
+    if (requested == PAGES_HUGETLB)
+    {
+        void *block = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block != MAP_FAILED)
+        {
+            *mappedBytes = rounded;
+            *used = PAGES_HUGETLB;
+            return block;
+        }
+        *fallback = string("MAP_HUGETLB: ") + strerror(errno) + ", using THP";
+    }
+
+    // One extra huge page of address space, trimmed so that the block starts on a 2 MB boundary
+    const size_t span = rounded + HUGE_PAGE_BYTES;
+    char *raw = (char *)mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == (char *)MAP_FAILED)
+        return nullptr;
+    char *block = (char *)(((uintptr_t)raw + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES);
+    if (block > raw)
+        munmap(raw, block - raw);
+    if (raw + span > block + rounded)
+        munmap(block + rounded, (raw + span) - (block + rounded));
+    *mappedBytes = rounded;
+
+    if (!TransparentHugePagesEnabled())
+    {
+        *used = PAGES_SMALL;
+        *fallback += (fallback->empty() ? "" : "; ") + string("transparent huge pages disabled");
+    }
+    else if (madvise(block, rounded, MADV_HUGEPAGE) != 0)
+    {
+        *used = PAGES_SMALL;
+        *fallback += (fallback->empty() ? "" : "; ") + string("MADV_HUGEPAGE: ") + strerror(errno);
+    }
+    else
+    {
+        *used = PAGES_THP;
+    }
+    return block;
+}
+
+// Owning, fixed-size, cache-line aligned array of T (used for the serial AoS buffer)
+template <typename T>
+class AlignedBuffer
+{
+public:
+    explicit AlignedBuffer(unsigned int count) : count(count), data((T *)AllocateAligned(count * sizeof(T))) {}
+    ~AlignedBuffer() { free(data); }
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    T &operator[](unsigned int i) { return data[i]; }
+    const T &operator[](unsigned int i) const { return data[i]; }
+    T *Data() { return data; }
+    const T *Data() const { return data; }
+    unsigned int Size() const { return count; }
+
+private:
+    unsigned int count;
+    T *data;
+};
+
+// This is a SoA - Struct of Arrays, which allows us to better utilize cache locality during vectorization.
+// The six arrays share one allocation: [x | y | z | vx | vy | vz], each `stride` floats long.
+// Padding entries past n are zero and never read as particles.
+class ParticleSystem
+{
+public:
+    enum Backing
+    {
+        BACKING_HEAP,   // owned aligned_alloc block
+        BACKING_MAPPED, // owned mmap()ed snapshot
+        BACKING_HUGE,   // owned anonymous mapping with huge pages (MapHugePages)
+        BACKING_VIEW    // arrays owned by someone else
+    };
+
+    // zero = false leaves the block untouched, the caller must write every array (padding included).
+    // Blocks of at least one huge page follow pageConfig.requested (fresh mapped pages are zero anyway).
+    explicit ParticleSystem(unsigned int n, bool zero = true)
+        : n(n), stride(PaddedCount(n)), backing(BACKING_HEAP), mapping(nullptr), mappingBytes(0), pages(PAGES_SMALL)
+    {
+        const size_t bytes = 6 * (size_t)stride * sizeof(float);
+        if (pageConfig.requested != PAGES_SMALL && bytes >= HUGE_PAGE_BYTES)
+            mapping = MapHugePages(bytes, pageConfig.requested, &mappingBytes, &pages, &pageFallback);
+        if (mapping != nullptr)
+        {
+            backing = BACKING_HUGE;
+            block = (float *)mapping;
+        }
+        else
+        {
+            block = (float *)AllocateAligned(bytes, zero);
+        }
+        SetArrays();
+    }
+
+    // Adopts an mmap()ed region of mappingBytes bytes whose particle block (same layout as above,
+    // stride = PaddedCount(n)) starts dataOffset bytes in. The region is munmap()ed by the destructor.
+    ParticleSystem(unsigned int n, void *mapping, size_t mappingBytes, size_t dataOffset)
+        : n(n), stride(PaddedCount(n)), backing(BACKING_MAPPED), mapping(mapping), mappingBytes(mappingBytes), pages(PAGES_SMALL)
+    {
+        block = (float *)((char *)mapping + dataOffset);
+        SetArrays();
+    }
+
+    // Non-owning view: positions and velocities may live in different allocations. A view has no
+    // contiguous block, so it cannot be saved with SaveSnapshot.
+    ParticleSystem(const ParticleSystem &owner, float *x, float *y, float *z)
+        : n(owner.n), stride(owner.stride), x(x), y(y), z(z), vx(owner.vx), vy(owner.vy), vz(owner.vz),
+          backing(BACKING_VIEW), block(nullptr), mapping(nullptr), mappingBytes(0), pages(PAGES_SMALL)
+    {
+    }
+
+    // Non-owning view of particles [first, first + n) of owner (first + n <= owner.stride), e.g. a partly
+    // filled buffer or one cell of a sorted copy. Aligned kernels need first to be a multiple of PARTICLE_PADDING.
+    ParticleSystem(const ParticleSystem &owner, unsigned int first, unsigned int n)
+        : n(n), stride(owner.stride), x(owner.x + first), y(owner.y + first), z(owner.z + first),
+          vx(owner.vx + first), vy(owner.vy + first), vz(owner.vz + first),
+          backing(BACKING_VIEW), block(nullptr), mapping(nullptr), mappingBytes(0), pages(PAGES_SMALL)
+    {
+    }
+
+    ~ParticleSystem()
+    {
+        if (backing == BACKING_MAPPED || backing == BACKING_HUGE)
+            munmap(mapping, mappingBytes);
+        else if (backing == BACKING_HEAP)
+            free(block);
+    }
+
+    ParticleSystem(const ParticleSystem &) = delete;
+    ParticleSystem &operator=(const ParticleSystem &) = delete;
+
+    // Size in bytes of the particle block (all six arrays, padding included)
+    size_t BlockBytes() const { return 6 * (size_t)stride * sizeof(float); }
+
+    // True when the particles live in an adopted memory mapping
+    bool IsMapped() const { return backing == BACKING_MAPPED; }
+
+    // Pages the block was mapped with (PAGES_SMALL for heap blocks, snapshots and views)
+    PageBacking Pages() const { return pages; }
+
+    // Why the block got less than --huge-pages asked for, empty if it did not
+    const string &PageFallback() const { return pageFallback; }
+
+    // Given an index, and a pointer, fills pointer p with particle[i]'s credentials
+    void Get(unsigned int i, OneParticle *p) const
+    {
+        p->x = x[i];
+        p->y = y[i];
+        p->z = z[i];
+        p->vx = vx[i];
+        p->vy = vy[i];
+        p->vz = vz[i];
+    }
+
+    const unsigned int n;      // number of particles
+    const unsigned int stride; // padded length of each array
+    float *x, *y, *z;
+    float *vx, *vy, *vz;
+
+private:
+    void SetArrays()
+    {
+        x = block;
+        y = block + stride;
+        z = block + 2 * (size_t)stride;
+        vx = block + 3 * (size_t)stride;
+        vy = block + 4 * (size_t)stride;
+        vz = block + 5 * (size_t)stride;
+    }
+
+    Backing backing;
+    float *block;        // start of the six arrays, nullptr for views
+    void *mapping;       // BACKING_MAPPED and BACKING_HUGE only
+    size_t mappingBytes;
+    PageBacking pages;
+    string pageFallback;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Written by: Amir Zuabi - 212606222
+//             Nir Schif  - 212980395
+
+//      Note: spawning and joining NUM_THREADS std::threads twice per step costs tens of microseconds,
+//            which dominates the step time at small N. Here the threads are created once and parked
+//            on a barrier between phases.
+
+//      Note: the calling (main) thread takes part in every phase as thread 0, so a pool of size T
+//            only owns T - 1 worker threads.
+
+// Reusable barrier for a fixed number of threads (std::barrier is C++20, we build with C++17).
+// Threads spin briefly before sleeping, since phases usually end close together.
+class Barrier
+{
+public:
+    explicit Barrier(unsigned int count) : threshold(count), waiting(0), generation(0) {}
+
+    void Wait()
+    {
+        unique_lock<mutex> lock(m);
+        unsigned int gen = generation.load(memory_order_relaxed);
+        if (++waiting == threshold)
+        {
+            waiting = 0;
+            generation.store(gen + 1, memory_order_release);
+            lock.unlock();
+            cv.notify_all();
+            return;
+        }
+        lock.unlock();
+
+        // Short spin: cheap when the other threads are about to arrive
+        for (int spin = 0; spin < SPIN_LIMIT; ++spin)
+        {
+            if (generation.load(memory_order_acquire) != gen)
+                return;
+            this_thread::yield();
+        }
+
+        lock.lock();
+        cv.wait(lock, [&] { return generation.load(memory_order_acquire) != gen; });
+    }
+
+private:
+    static const int SPIN_LIMIT = 256;
+
+    mutex m;
+    condition_variable cv;
+    const unsigned int threshold;
+    unsigned int waiting;
+    atomic<unsigned int> generation;
+};
+
+// Fixed-size pool of long-lived threads. Run() hands the same job to every thread
+// (job receives the thread index) and returns once all of them finished.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int nThreads)
+        : nThreads(nThreads == 0 ? 1 : nThreads),
+          startBarrier(this->nThreads),
+          endBarrier(this->nThreads),
+          job(nullptr),
+          stopping(false)
+    {
+        for (unsigned int t = 1; t < this->nThreads; ++t)
+        {
+            workers.emplace_back(&ThreadPool::WorkerLoop, this, t);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        stopping = true;
+        startBarrier.Wait();
+        for (auto &th : workers)
+        {
+            th.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned int Size() const { return nThreads; }
+
+    // Executes job(t) on every thread t in [0, Size()), thread 0 being the caller
+    void Run(const function<void(unsigned int)> &work)
+    {
+        job = &work;
+        startBarrier.Wait();
+        work(0);
+        endBarrier.Wait();
+        job = nullptr;
+    }
+
+private:
+    void WorkerLoop(unsigned int id)
+    {
+        while (true)
+        {
+            startBarrier.Wait();
+            if (stopping)
+                return;
+            (*job)(id);
+            endBarrier.Wait();
+        }
+    }
+
+    const unsigned int nThreads;
+    vector<thread> workers;
+    Barrier startBarrier;
+    Barrier endBarrier;
+    const function<void(unsigned int)> *job; // published before startBarrier, read after it
+    bool stopping;
+};
+
+#endif